@@ -0,0 +1,350 @@
+#include "asset_database.h"
+#include "assimp_model_loading.h"
+#include "texture_cooker.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+#include "job_system.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME_3 0x165667B19E3779F9ull
+
+struct AssetCook
+{
+    AssetType type;
+    u64       settings;
+    u64       key; // Of the last cooked output
+};
+
+struct AssetRecord
+{
+    u64                      timestamp;   // Last write time contentHash was computed at
+    u64                      contentHash;
+    std::vector<std::string> inputs;      // Baked into this asset's cooked output
+    std::vector<AssetCook>   cooks;
+};
+
+struct AssetDatabase
+{
+    std::unordered_map<std::string, AssetRecord> records;
+    std::mutex                                   mutex;
+    bool                                         isDirty;
+};
+
+static AssetDatabase GlobalAssetDatabase;
+
+static u64 RotateLeft(u64 value, u32 bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static u64 MixHash(u64 hash)
+{
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Eight bytes per step, the files are hashed at disk speed rather than byte by byte
+static u64 HashBytes(const void* data, u64 size, u64 seed)
+{
+    const u8* bytes = (const u8*)data;
+    u64 hash = seed + HASH_PRIME_3 + size * HASH_PRIME_1;
+
+    u64 offset = 0;
+    for (; offset + 8 <= size; offset += 8)
+    {
+        u64 word;
+        memcpy(&word, bytes + offset, sizeof(word));
+        hash ^= RotateLeft(word * HASH_PRIME_2, 31) * HASH_PRIME_1;
+        hash = RotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_3;
+    }
+    for (; offset < size; ++offset)
+    {
+        hash ^= bytes[offset] * HASH_PRIME_3;
+        hash = RotateLeft(hash, 11) * HASH_PRIME_1;
+    }
+
+    return MixHash(hash);
+}
+
+static u64 CombineHash(u64 hash, u64 value)
+{
+    return MixHash(hash ^ (value + HASH_PRIME_1 + (hash << 6) + (hash >> 2)));
+}
+
+static const char* GetCookedExtension(AssetType type)
+{
+    return type == AssetType_Model ? MESH_CACHE_EXTENSION : TEXTURE_CACHE_EXTENSION;
+}
+
+void LoadAssetDatabase()
+{
+    MakeDirectory(COOKED_ASSET_DIRECTORY);
+
+    MappedFile file = MapFile(ASSET_DATABASE_PATH);
+    if (!file.data)
+        return;
+
+    std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+    std::string text((const char*)file.data, file.size);
+    UnmapFile(file);
+
+    AssetRecord* record = nullptr;
+    u32 version = 0;
+
+    // One entry per line, the paths come last since they may contain spaces
+    size_t lineStart = 0;
+    while (lineStart < text.size())
+    {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = text.size();
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        unsigned long long a, b, c;
+        int pathOffset = 0;
+
+        if (sscanf(line.c_str(), "assetdb %u", &version) == 1)
+        {
+            if (version != ASSET_DATABASE_VERSION)
+                break;
+        }
+        else if (sscanf(line.c_str(), "source %llu %llx %n", &a, &b, &pathOffset) == 2 && pathOffset > 0)
+        {
+            record = &GlobalAssetDatabase.records[line.substr(pathOffset)];
+            record->timestamp = a;
+            record->contentHash = b;
+        }
+        else if (record && line.compare(0, 6, "input ") == 0)
+        {
+            record->inputs.push_back(line.substr(6));
+        }
+        else if (record && sscanf(line.c_str(), "cook %llu %llx %llx", &a, &b, &c) == 3 && a < AssetType_Count)
+        {
+            record->cooks.push_back(AssetCook{ (AssetType)a, b, c });
+        }
+    }
+
+    if (version != ASSET_DATABASE_VERSION)
+        GlobalAssetDatabase.records.clear();
+
+    ILOG("Asset database: %u sources", (u32)GlobalAssetDatabase.records.size());
+}
+
+void SaveAssetDatabase()
+{
+    std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+    if (!GlobalAssetDatabase.isDirty)
+        return;
+
+    std::string text;
+    char line[1024];
+
+    snprintf(line, sizeof(line), "assetdb %u\n", ASSET_DATABASE_VERSION);
+    text += line;
+
+    for (const auto& entry : GlobalAssetDatabase.records)
+    {
+        const AssetRecord& record = entry.second;
+        snprintf(line, sizeof(line), "source %llu %016llx %s\n", (unsigned long long)record.timestamp,
+                 (unsigned long long)record.contentHash, entry.first.c_str());
+        text += line;
+
+        for (const std::string& input : record.inputs)
+            text += "input " + input + "\n";
+        for (const AssetCook& cook : record.cooks)
+        {
+            snprintf(line, sizeof(line), "cook %u %llx %016llx\n", (u32)cook.type, (unsigned long long)cook.settings, (unsigned long long)cook.key);
+            text += line;
+        }
+    }
+
+    if (WriteBinaryFile(ASSET_DATABASE_PATH, text.data(), text.size()))
+        GlobalAssetDatabase.isDirty = false;
+}
+
+u64 GetAssetContentHash(const char* path)
+{
+    const u64 timestamp = GetFileLastWriteTimestamp(path);
+    if (timestamp == 0)
+        return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+        auto it = GlobalAssetDatabase.records.find(path);
+        if (it != GlobalAssetDatabase.records.end() && it->second.timestamp == timestamp && it->second.contentHash != 0)
+            return it->second.contentHash;
+    }
+
+    // Hashed outside the lock, several workers may be reading big files at once
+    MappedFile file = MapFile(path);
+    u64 contentHash = HashBytes(file.data, file.size, 0);
+    UnmapFile(file);
+    if (contentHash == 0)
+        contentHash = 1;
+
+    std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+    AssetRecord& record = GlobalAssetDatabase.records[path];
+    record.timestamp = timestamp;
+    record.contentHash = contentHash;
+    GlobalAssetDatabase.isDirty = true;
+
+    return contentHash;
+}
+
+u64 GetAssetSourceTimestamp(const char* path)
+{
+    u64 timestamp = GetFileLastWriteTimestamp(path);
+    if (timestamp == 0)
+        return 0;
+
+    std::vector<std::string> inputs;
+    {
+        std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+        auto it = GlobalAssetDatabase.records.find(path);
+        if (it != GlobalAssetDatabase.records.end())
+            inputs = it->second.inputs;
+    }
+
+    for (const std::string& input : inputs)
+        timestamp = glm::max(timestamp, GetAssetSourceTimestamp(input.c_str()));
+
+    return timestamp;
+}
+
+void SetAssetInputs(const char* path, const std::vector<std::string>& inputs)
+{
+    std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+    AssetRecord& record = GlobalAssetDatabase.records[path];
+    if (record.inputs != inputs)
+    {
+        record.inputs = inputs;
+        GlobalAssetDatabase.isDirty = true;
+    }
+}
+
+u64 GetAssetCookKey(const char* path, AssetType type, u64 settings)
+{
+    const u64 contentHash = GetAssetContentHash(path);
+    if (contentHash == 0)
+        return 0;
+
+    u64 key = CombineHash(contentHash, type);
+    key = CombineHash(key, settings);
+    if (type == AssetType_Model)
+        key = CombineHash(key, HashBytes(path, strlen(path), 0));
+
+    std::vector<std::string> inputs;
+    {
+        std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+        inputs = GlobalAssetDatabase.records[path].inputs;
+    }
+
+    for (const std::string& input : inputs)
+        key = CombineHash(key, GetAssetContentHash(input.c_str()));
+
+    return key != 0 ? key : 1;
+}
+
+// Identical sources share their cooked file, so it is only garbage once no cook names it
+static bool IsCookKeyUsed(AssetType type, u64 key)
+{
+    for (const auto& entry : GlobalAssetDatabase.records)
+        for (const AssetCook& cook : entry.second.cooks)
+            if (cook.type == type && cook.key == key)
+                return true;
+    return false;
+}
+
+void RecordAssetCook(const char* path, AssetType type, u64 settings, u64 key)
+{
+    std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+    AssetRecord& record = GlobalAssetDatabase.records[path];
+
+    for (AssetCook& cook : record.cooks)
+    {
+        if (cook.type == type && cook.settings == settings)
+        {
+            if (cook.key != key)
+            {
+                const u64 oldKey = cook.key;
+                cook.key = key;
+                GlobalAssetDatabase.isDirty = true;
+
+                // May fail while a load still has it mapped; it is then left for good
+                if (!IsCookKeyUsed(type, oldKey))
+                    RemoveFile(GetCookedAssetPath(oldKey, GetCookedExtension(type)).c_str());
+            }
+            return;
+        }
+    }
+
+    record.cooks.push_back(AssetCook{ type, settings, key });
+    GlobalAssetDatabase.isDirty = true;
+}
+
+std::string GetCookedAssetPath(u64 key, const char* extension)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%016llx%s", COOKED_ASSET_DIRECTORY, (unsigned long long)key, extension);
+    return path;
+}
+
+u32 RebuildStaleAssets()
+{
+    struct StaleCook
+    {
+        std::string path;
+        AssetCook   cook;
+    };
+
+    std::vector<StaleCook> cooks;
+    {
+        std::lock_guard<std::mutex> lock(GlobalAssetDatabase.mutex);
+        for (const auto& entry : GlobalAssetDatabase.records)
+            for (const AssetCook& cook : entry.second.cooks)
+                cooks.push_back(StaleCook{ entry.first, cook });
+    }
+
+    // Checking keys only reads the files whose write time changed
+    std::vector<StaleCook> staleCooks;
+    for (const StaleCook& stale : cooks)
+    {
+        const u64 key = GetAssetCookKey(stale.path.c_str(), stale.cook.type, stale.cook.settings);
+        if (key == 0)
+            continue;
+
+        std::string cookedPath = GetCookedAssetPath(key, GetCookedExtension(stale.cook.type));
+        if (key != stale.cook.key || GetFileLastWriteTimestamp(cookedPath.c_str()) == 0)
+            staleCooks.push_back(stale);
+    }
+
+    ParallelFor(staleCooks.size(), [&](u32 i)
+    {
+        const StaleCook& stale = staleCooks[i];
+        if (stale.cook.type == AssetType_Model)
+        {
+            ImportedModel model;
+            ImportModel(stale.path.c_str(), (u32)stale.cook.settings, model);
+            ReleaseImportedModel(model);
+        }
+        else
+        {
+            CookedTexture texture;
+            CookTexture(stale.path.c_str(), (TextureUsage)stale.cook.settings, texture);
+        }
+    });
+
+    if (!staleCooks.empty())
+        ILOG("Rebuilt %u stale cooked assets", (u32)staleCooks.size());
+
+    return staleCooks.size();
+}
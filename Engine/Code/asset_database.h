@@ -0,0 +1,75 @@
+//
+// asset_database.h: Change tracking for the source assets and their cooked outputs. Every
+// source gets a content hash and the files it pulls into its cooked output (inputs, such
+// as the MTL of an OBJ). Textures named by a model are sources of their own, tracked apart
+// from it. Cooked files are named after a key hashed from their sources' contents and
+// import settings, so identical assets are cooked and stored once, and only outputs whose
+// key changed get rebuilt.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define ASSET_DATABASE_PATH    "assets.db"
+#define ASSET_DATABASE_VERSION 1
+#define COOKED_ASSET_DIRECTORY "Cooked"
+
+enum AssetType
+{
+    AssetType_Model,   // Settings are the import flags (high half) and load flags (low half)
+    AssetType_Texture, // Settings are the TextureUsage
+    AssetType_Count
+};
+
+/**
+ * Reads the database saved by a previous run, and creates the cooked asset directory.
+ */
+void LoadAssetDatabase();
+
+/**
+ * Writes the database if anything changed since it was last saved. Called once at exit,
+ * after the workers are done; a database lost to a crash only costs hashing the sources
+ * again, the cooked files are found by key.
+ */
+void SaveAssetDatabase();
+
+/**
+ * Hash of the contents of a source file, or 0 if it doesn't exist. Files are only read
+ * again when their last write time changes. Safe to call from any thread.
+ */
+u64 GetAssetContentHash(const char* path);
+
+/**
+ * Newest last write time among a source and its inputs, or 0 if the source doesn't exist.
+ * Only stats the files, for cheap change polling. Safe to call from any thread.
+ */
+u64 GetAssetSourceTimestamp(const char* path);
+
+/**
+ * Replaces the inputs recorded for a source, usually right after it was imported. Safe to
+ * call from any thread.
+ */
+void SetAssetInputs(const char* path, const std::vector<std::string>& inputs);
+
+/**
+ * Key of the cooked output of a source: its contents, the contents of its inputs and the
+ * settings. Models hash their path too, as their texture paths are relative to it. Returns
+ * 0 if the source doesn't exist. Safe to call from any thread.
+ */
+u64 GetAssetCookKey(const char* path, AssetType type, u64 settings);
+
+/**
+ * Remembers that a source was cooked with some settings into the output named by key, so
+ * RebuildStaleAssets can redo it when the key changes. The output it replaces is deleted
+ * unless another source shares it. Safe to call from any thread.
+ */
+void RecordAssetCook(const char* path, AssetType type, u64 settings, u64 key);
+
+std::string GetCookedAssetPath(u64 key, const char* extension);
+
+/**
+ * Cooks again, in parallel, every recorded output whose key changed or whose cooked file
+ * is missing. GL-free, so it can run in a worker. Returns the number of outputs rebuilt.
+ */
+u32 RebuildStaleAssets();
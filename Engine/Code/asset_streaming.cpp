@@ -0,0 +1,319 @@
+#include "asset_streaming.h"
+#include "job_system.h"
+#include "texture_cooker.h"
+#include "texture_streaming.h"
+#include "geometry_heap.h"
+#include "asset_database.h"
+#include "model_upload.h"
+#include "mesh_residency.h"
+#include "staging_ring.h"
+
+#include <atomic>
+#include <memory>
+
+enum StreamingAssetType
+{
+    StreamingAsset_Texture,
+    StreamingAsset_Model,
+};
+
+struct StreamingRequest
+{
+    StreamingAssetType type;
+    u32                assetIdx;  // Into app->textures or app->models
+    std::string        filepath;
+    u32                loadFlags;
+    TextureUsage       usage;
+    bool               isReload;  // Replacing an asset that is already loaded
+
+    // Written by the worker, read by the main thread once isLoaded is set
+    std::atomic<bool>  isLoaded;
+    bool               failed;
+    CookedTexture      texture;
+    ImportedModel      model;
+
+    // Upload progress, main thread only
+    bool               uploadStarted;
+    u32                uploadedSubmeshes;
+    u32                uploadedBytes;     // Of the submesh being uploaded, vertices first
+};
+
+struct AssetStreaming
+{
+    std::vector<std::shared_ptr<StreamingRequest>> requests; // Main thread only, in request order
+};
+
+static AssetStreaming GlobalAssetStreaming;
+
+static std::shared_ptr<StreamingRequest> CreateRequest(StreamingAssetType type, u32 assetIdx, const char* filepath)
+{
+    std::shared_ptr<StreamingRequest> request = std::make_shared<StreamingRequest>();
+    request->type = type;
+    request->assetIdx = assetIdx;
+    request->filepath = filepath;
+    request->loadFlags = 0;
+    request->usage = TextureUsage_Color;
+    request->isReload = false;
+    request->isLoaded = false;
+    request->failed = false;
+    request->uploadStarted = false;
+    request->uploadedSubmeshes = 0;
+    request->uploadedBytes = 0;
+    return request;
+}
+
+static void StartTextureCook(const std::shared_ptr<StreamingRequest>& request)
+{
+    GlobalAssetStreaming.requests.push_back(request);
+
+    RunJobAsync([request]
+    {
+        request->failed = !CookTexture(request->filepath.c_str(), request->usage, request->texture);
+        request->isLoaded.store(true, std::memory_order_release);
+    });
+}
+
+static void StartModelImport(const std::shared_ptr<StreamingRequest>& request)
+{
+    GlobalAssetStreaming.requests.push_back(request);
+
+    RunJobAsync([request]
+    {
+        request->failed = !ImportModel(request->filepath.c_str(), request->loadFlags, request->model);
+        request->isLoaded.store(true, std::memory_order_release);
+    });
+}
+
+u32 LoadTexture2DAsync(App* app, const char* filepath, TextureUsage usage, u32 placeholderTexIdx)
+{
+    // Pending textures are in the list too, so they are only requested once
+    for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+        if (app->textures[texIdx].filepath == filepath)
+            return texIdx;
+
+    Texture tex = {};
+    tex.handle = app->textures[placeholderTexIdx].handle;
+    tex.filepath = filepath;
+    tex.isPlaceholder = true;
+    tex.usage = usage;
+    tex.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath);
+
+    u32 texIdx = app->textures.size();
+    app->textures.push_back(tex);
+
+    std::shared_ptr<StreamingRequest> request = CreateRequest(StreamingAsset_Texture, texIdx, filepath);
+    request->usage = usage;
+    StartTextureCook(request);
+
+    return texIdx;
+}
+
+u32 LoadModelAsync(App* app, const char* filename, u32 loadFlags)
+{
+    app->meshes.push_back(Mesh{});
+    u32 meshIdx = (u32)app->meshes.size() - 1u;
+
+    app->models.push_back(Model{});
+    Model& model = app->models.back();
+    model.name = filename;
+    model.loadFlags = loadFlags;
+    model.meshIdx = meshIdx;
+    u32 modelIdx = (u32)app->models.size() - 1u;
+
+    std::shared_ptr<StreamingRequest> request = CreateRequest(StreamingAsset_Model, modelIdx, filename);
+    request->loadFlags = loadFlags;
+    StartModelImport(request);
+
+    return modelIdx;
+}
+
+static bool IsAssetPending(StreamingAssetType type, u32 assetIdx)
+{
+    for (const std::shared_ptr<StreamingRequest>& request : GlobalAssetStreaming.requests)
+        if (request->type == type && request->assetIdx == assetIdx)
+            return true;
+    return false;
+}
+
+bool ReloadTexture2DAsync(App* app, u32 texIdx)
+{
+    if (IsAssetPending(StreamingAsset_Texture, texIdx))
+        return false;
+
+    const Texture& texture = app->textures[texIdx];
+    std::shared_ptr<StreamingRequest> request = CreateRequest(StreamingAsset_Texture, texIdx, texture.filepath.c_str());
+    request->usage = texture.usage;
+    request->isReload = true;
+    StartTextureCook(request);
+
+    return true;
+}
+
+bool ReloadModelAsync(App* app, u32 modelIdx)
+{
+    if (IsAssetPending(StreamingAsset_Model, modelIdx))
+        return false;
+
+    const Model& model = app->models[modelIdx];
+    std::shared_ptr<StreamingRequest> request = CreateRequest(StreamingAsset_Model, modelIdx, model.name.c_str());
+    request->loadFlags = model.loadFlags;
+    request->isReload = true;
+    StartModelImport(request);
+
+    return true;
+}
+
+// Hands a cooked texture to the mip streaming, which uploads its coarse levels right
+// away (a few KB) and the finer ones as they get seen
+static bool UploadTextureStep(App* app, StreamingRequest& request)
+{
+    Texture& texture = app->textures[request.assetIdx];
+
+    // A reload that fails keeps what was there, the file may be half written
+    if (request.failed)
+    {
+        if (request.isReload)
+        {
+            ELOG("Could not reload texture %s", request.filepath.c_str());
+        }
+        else
+        {
+            texture.handle = app->textures[app->magentaTexIdx].handle;
+        }
+        return true;
+    }
+
+    const GLuint oldHandle = texture.handle;
+    const bool ownedOldHandle = !texture.isPlaceholder;
+    if (request.isReload)
+        RemoveStreamedTexture(request.assetIdx);
+
+    AddStreamedTexture(app, request.assetIdx, request.texture);
+
+    // Same index, new GL texture: the materials pick it up as they are, and textures still
+    // borrowing the old handle as a placeholder are moved over to the new one
+    if (request.isReload)
+    {
+        if (ownedOldHandle)
+        {
+            for (Texture& other : app->textures)
+                if (other.isPlaceholder && other.handle == oldHandle)
+                    other.handle = texture.handle;
+
+            glDeleteTextures(1, &oldHandle);
+        }
+
+        ILOG("Reloaded texture %s", request.filepath.c_str());
+    }
+
+    request.texture = CookedTexture{};
+    return true;
+}
+
+// Uploads the vertex, index and position data of each submesh until the budget runs out,
+// and fills the model once all of them are complete
+static bool UploadModelStep(App* app, StreamingRequest& request)
+{
+    if (request.failed)
+    {
+        if (request.isReload)
+            ELOG("Could not reload model %s", request.filepath.c_str());
+        app->models[request.assetIdx].lastWriteTimestamp = GetAssetSourceTimestamp(request.filepath.c_str());
+        return true;
+    }
+
+    ImportedModel& imported = request.model;
+    Mesh& mesh = app->meshes[app->models[request.assetIdx].meshIdx];
+
+    if (!request.uploadStarted)
+    {
+        UploadMeshBuffers(imported.submeshes, nullptr, nullptr, nullptr);
+        request.uploadStarted = true;
+    }
+
+    while (request.uploadedSubmeshes < imported.submeshes.size())
+    {
+        const Submesh& submesh = imported.submeshes[request.uploadedSubmeshes];
+        const u32 indexStart = submesh.vertexDataSize;
+        const u32 positionStart = indexStart + submesh.indexDataSize;
+        const bool isVertexData = request.uploadedBytes < indexStart;
+        const bool isIndexData = !isVertexData && request.uploadedBytes < positionStart;
+        const u32 offset = isVertexData ? request.uploadedBytes :
+                           isIndexData  ? request.uploadedBytes - indexStart : request.uploadedBytes - positionStart;
+        const u32 size = isVertexData ? submesh.vertexDataSize :
+                         isIndexData  ? submesh.indexDataSize : submesh.positionDataSize;
+
+        // Whatever doesn't fit the staging ring or its frame budget goes in the next frames
+        const u32 stagingSpace = GetStagingSpace();
+        if (stagingSpace == 0)
+            break;
+
+        const u32 chunk = glm::min(size - offset, stagingSpace);
+        if (isVertexData)
+            UploadSubmeshVertices(submesh, offset, chunk, imported.vertexData + submesh.vertexOffset + offset);
+        else if (isIndexData)
+            UploadSubmeshIndices(submesh, offset, chunk, imported.indexData + submesh.indexOffset + offset);
+        else
+            UploadSubmeshPositions(submesh, offset, chunk, imported.positionData + submesh.positionOffset + offset);
+
+        request.uploadedBytes += chunk;
+
+        if (request.uploadedBytes == positionStart + submesh.positionDataSize)
+        {
+            request.uploadedSubmeshes++;
+            request.uploadedBytes = 0;
+        }
+    }
+
+    if (request.uploadedSubmeshes < imported.submeshes.size())
+        return false;
+
+    // Swapped in whole once every submesh is uploaded, the previous geometry and materials
+    // are drawn until then. A reload overwrites the material slots of the model in place.
+    Model& model = app->models[request.assetIdx];
+    CreateImportedMaterials(app, imported, true, model.materialSlots);
+    model.materialIdx.clear();
+    for (u32 materialIdx : imported.submeshMaterials)
+        model.materialIdx.push_back(model.materialSlots[materialIdx]);
+    model.nodes.swap(imported.nodes);
+    mesh.submeshes.swap(imported.submeshes);
+    ApplyMeshResidency(mesh, GetModelMeshResidency(request.loadFlags), imported.vertexData, imported.indexData);
+    model.lastWriteTimestamp = GetAssetSourceTimestamp(request.filepath.c_str());
+
+    for (Submesh& submesh : imported.submeshes)
+        FreeSubmeshGeometry(submesh);
+    ReleaseImportedModel(imported);
+
+    ILOG("%s model %s", request.isReload ? "Reloaded" : "Streamed", request.filepath.c_str());
+    return true;
+}
+
+void UpdateAssetStreaming(App* app)
+{
+    std::vector<std::shared_ptr<StreamingRequest>>& requests = GlobalAssetStreaming.requests;
+
+    // Uploading a model may request more textures, so the list can grow while iterating
+    for (u32 i = 0; i < requests.size() && GetStagingSpace() > 0;)
+    {
+        std::shared_ptr<StreamingRequest> request = requests[i];
+        if (!request->isLoaded.load(std::memory_order_acquire))
+        {
+            i++;
+            continue;
+        }
+
+        bool isDone = request->type == StreamingAsset_Texture
+                    ? UploadTextureStep(app, *request)
+                    : UploadModelStep(app, *request);
+
+        if (isDone)
+            requests.erase(requests.begin() + i);
+        else
+            i++;
+    }
+}
+
+u32 GetPendingAssetCount()
+{
+    return GlobalAssetStreaming.requests.size();
+}
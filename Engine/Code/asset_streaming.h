@@ -0,0 +1,40 @@
+//
+// asset_streaming.h: Background loading of models and textures. The load calls return an
+// index right away that points at a placeholder (an existing texture, or a model with an
+// empty mesh). Files are read, imported and decoded in the job system workers, and the
+// results are uploaded from the main thread a few bytes at a time, within a per-frame
+// budget, before replacing the placeholders.
+//
+
+#pragma once
+
+#include "engine.h"
+#include "assimp_model_loading.h"
+
+/**
+ * Returns the index of a texture showing placeholderTexIdx until it is cooked and its
+ * coarse levels are uploaded, or magentaTexIdx if it fails to load. The placeholder's
+ * handle is borrowed, so it has to be one of the small textures that never stream.
+ */
+u32 LoadTexture2DAsync(App* app, const char* filepath, TextureUsage usage, u32 placeholderTexIdx);
+
+/**
+ * Returns the index of a model that has no submeshes until it is imported and uploaded.
+ */
+u32 LoadModelAsync(App* app, const char* filename, u32 loadFlags = DEFAULT_MODEL_LOAD_FLAGS);
+
+/**
+ * Cooks or imports a loaded asset again in the background, and replaces its GL objects
+ * behind the same index once the new ones are uploaded. The old ones are drawn until
+ * then. Returns false if the asset is already being loaded.
+ */
+bool ReloadTexture2DAsync(App* app, u32 texIdx);
+bool ReloadModelAsync(App* app, u32 modelIdx);
+
+/**
+ * Swaps in the assets whose background work is done, uploading what fits the staging
+ * ring frame budget (app->uploadBudgetKB). Called once per frame from the main thread.
+ */
+void UpdateAssetStreaming(App* app);
+
+u32 GetPendingAssetCount();
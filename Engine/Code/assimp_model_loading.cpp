@@ -5,95 +5,98 @@
 #include <assimp/postprocess.h>
 
 #include "assimp_model_loading.h"
+#include "mesh_cache.h"
+#include "texture_cooker.h"
+#include "job_system.h"
+#include "vertex_interleave.h"
+#include "mesh_processing.h"
+#include "meshlet.h"
+#include "mesh_lod.h"
+#include "mesh_optimizer.h"
+#include "asset_database.h"
+#include "obj_loader.h"
+#include "gltf_loader.h"
 #include "engine.h"
 
-void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices)
+#define MODEL_IMPORT_FLAGS (aiProcess_Triangulate           | \
+                            aiProcess_GenSmoothNormals      | \
+                            aiProcess_CalcTangentSpace      | \
+                            aiProcess_JoinIdenticalVertices | \
+                            aiProcess_PreTransformVertices  | \
+                            aiProcess_OptimizeMeshes        | \
+                            aiProcess_SortByPType)
+
+// Models keeping their hierarchy leave the node transforms out of the vertices
+u32 GetModelImportFlags(u32 loadFlags)
 {
-    std::vector<float> vertices;
-    std::vector<u32> indices;
+    return (loadFlags & ModelLoad_KeepHierarchy) ? (MODEL_IMPORT_FLAGS & ~aiProcess_PreTransformVertices) : MODEL_IMPORT_FLAGS;
+}
 
-    bool hasTexCoords = false;
-    bool hasTangentSpace = false;
+// Runs in the job system workers: it must only touch its own submesh
+void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Submesh& submesh)
+{
+    bool hasTexCoords = mesh->mTextureCoords[0] != nullptr; // does the mesh contain texture coordinates?
+    bool hasTangentSpace = mesh->mTangents != nullptr && mesh->mBitangents != nullptr;
 
     // process vertices
-    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    VertexStreams streams = {};
+    streams.vertexCount = mesh->mNumVertices;
+    streams.positions = (const vec3*)mesh->mVertices;
+    streams.normals = (const vec3*)mesh->mNormals;
+    streams.texCoords = hasTexCoords ? (const vec3*)mesh->mTextureCoords[0] : nullptr;
+    streams.tangents = hasTangentSpace ? (const vec3*)mesh->mTangents : nullptr;
+    streams.bitangents = hasTangentSpace ? (const vec3*)mesh->mBitangents : nullptr;
+
+    // For some reason ASSIMP gives me the bitangents flipped.
+    // Maybe it's my fault, but when I generate my own geometry
+    // in other files (see the generation of standard assets)
+    // and all the bitangents have the orientation I expect,
+    // everything works ok.
+    // I think that (even if the documentation says the opposite)
+    // it returns a left-handed tangent space matrix.
+    // SOLUTION: I invert the components of the bitangent here.
+    streams.flipBitangents = true;
+
+    // pick the packed vertex format for this submesh and fill its vertices
+    BuildSubmeshVertices(streams, submesh);
+
+    // process indices (faces are triangles after aiProcess_Triangulate/SortByPType)
+    u32 indexCount = 0;
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        vertices.push_back(mesh->mVertices[i].x);
-        vertices.push_back(mesh->mVertices[i].y);
-        vertices.push_back(mesh->mVertices[i].z);
-        vertices.push_back(mesh->mNormals[i].x);
-        vertices.push_back(mesh->mNormals[i].y);
-        vertices.push_back(mesh->mNormals[i].z);
-
-        if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-        {
-            hasTexCoords = true;
-            vertices.push_back(mesh->mTextureCoords[0][i].x);
-            vertices.push_back(mesh->mTextureCoords[0][i].y);
-        }
-
-        if(mesh->mTangents != nullptr && mesh->mBitangents)
-        {
-            hasTangentSpace = true;
-            vertices.push_back(mesh->mTangents[i].x);
-            vertices.push_back(mesh->mTangents[i].y);
-            vertices.push_back(mesh->mTangents[i].z);
-
-            // For some reason ASSIMP gives me the bitangents flipped.
-            // Maybe it's my fault, but when I generate my own geometry
-            // in other files (see the generation of standard assets)
-            // and all the bitangents have the orientation I expect,
-            // everything works ok.
-            // I think that (even if the documentation says the opposite)
-            // it returns a left-handed tangent space matrix.
-            // SOLUTION: I invert the components of the bitangent here.
-            vertices.push_back(-mesh->mBitangents[i].x);
-            vertices.push_back(-mesh->mBitangents[i].y);
-            vertices.push_back(-mesh->mBitangents[i].z);
-        }
+        indexCount += mesh->mFaces[i].mNumIndices;
     }
 
-    // process indices
+    std::vector<u32> indices(indexCount);
+    u32* dstIndex = indices.data();
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for(unsigned int j = 0; j < face.mNumIndices; j++)
         {
-            indices.push_back(face.mIndices[j]);
+            *dstIndex++ = face.mIndices[j];
         }
     }
 
-    // store the proper (previously proceessed) material for this mesh
-    submeshMaterialIndices.push_back(baseMeshMaterialIndex + mesh->mMaterialIndex);
-
-    // create the vertex format
-    VertexBufferLayout vertexBufferLayout = {};
-    vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 0, 3, 0 } );
-    vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 1, 3, 3*sizeof(float) } );
-    vertexBufferLayout.stride = 6 * sizeof(float);
-    if (hasTexCoords)
-    {
-        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride } );
-        vertexBufferLayout.stride += 2 * sizeof(float);
-    }
-    if (hasTangentSpace)
-    {
-        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 3, 3, vertexBufferLayout.stride } );
-        vertexBufferLayout.stride += 3 * sizeof(float);
+    // fill the submesh
+    submesh.indices.swap(indices);
+    submesh.indexCount = submesh.indices.size();
+    submesh.indexType = ChooseIndexType(mesh->mNumVertices);
+}
 
-        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 4, 3, vertexBufferLayout.stride } );
-        vertexBufferLayout.stride += 3 * sizeof(float);
-    }
+static std::string GetMaterialTexturePath(aiMaterial* material, aiTextureType type, const std::string& directory)
+{
+    if (material->GetTextureCount(type) == 0)
+        return std::string();
 
-    // add the submesh into the mesh
-    Submesh submesh = {};
-    submesh.vertexBufferLayout = vertexBufferLayout;
-    submesh.vertices.swap(vertices);
-    submesh.indices.swap(indices);
-    myMesh->submeshes.push_back( submesh );
+    aiString aiFilename;
+    material->GetTexture(type, 0, &aiFilename);
+    return directory + "/" + aiFilename.C_Str();
 }
 
-void ProcessAssimpMaterial(App* app, aiMaterial *material, Material& myMaterial, String directory)
+// Runs in the job system workers: paths are built with std::string and not the frame
+// arena, and textures are only loaded later on the main thread
+void ProcessAssimpMaterial(aiMaterial *material, ImportedMaterial& myMaterial, const std::string& directory)
 {
     aiString name;
     aiColor3D diffuseColor;
@@ -111,141 +114,320 @@ void ProcessAssimpMaterial(App* app, aiMaterial *material, Material& myMaterial,
     myMaterial.emissive = vec3(emissiveColor.r, emissiveColor.g, emissiveColor.b);
     myMaterial.smoothness = shininess / 256.0f;
 
-    aiString aiFilename;
-    if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
-    {
-        material->GetTexture(aiTextureType_DIFFUSE, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.albedoTextureIdx = LoadTexture2D(app, filepath.str);
-    }
-    if (material->GetTextureCount(aiTextureType_EMISSIVE) > 0)
-    {
-        material->GetTexture(aiTextureType_EMISSIVE, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.emissiveTextureIdx = LoadTexture2D(app, filepath.str);
-    }
-    if (material->GetTextureCount(aiTextureType_SPECULAR) > 0)
-    {
-        material->GetTexture(aiTextureType_SPECULAR, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.specularTextureIdx = LoadTexture2D(app, filepath.str);
-    }
-    if (material->GetTextureCount(aiTextureType_NORMALS) > 0)
-    {
-        material->GetTexture(aiTextureType_NORMALS, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.normalsTextureIdx = LoadTexture2D(app, filepath.str);
-    }
-    if (material->GetTextureCount(aiTextureType_HEIGHT) > 0)
-    {
-        material->GetTexture(aiTextureType_HEIGHT, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.normalsTextureIdx = LoadTexture2D(app, filepath.str);
-    }
+    myMaterial.albedoTexture = GetMaterialTexturePath(material, aiTextureType_DIFFUSE, directory);
+    myMaterial.emissiveTexture = GetMaterialTexturePath(material, aiTextureType_EMISSIVE, directory);
+    myMaterial.specularTexture = GetMaterialTexturePath(material, aiTextureType_SPECULAR, directory);
+    myMaterial.normalsTexture = GetMaterialTexturePath(material, aiTextureType_NORMALS, directory);
+
+    // Height maps are used as normal maps
+    std::string heightTexture = GetMaterialTexturePath(material, aiTextureType_HEIGHT, directory);
+    if (!heightTexture.empty())
+        myMaterial.normalsTexture = heightTexture;
 
     //myMaterial.createNormalFromBump();
 }
 
-void ProcessAssimpNode(const aiScene* scene, aiNode *node, Mesh *myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices)
+void ProcessAssimpNode(const aiScene* scene, aiNode *node, std::vector<aiMesh*>& meshes)
 {
-    // process all the node's meshes (if any)
+    // gather all the node's meshes (if any)
     for(unsigned int i = 0; i < node->mNumMeshes; i++)
     {
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        ProcessAssimpMesh(scene, mesh, myMesh, baseMeshMaterialIndex, submeshMaterialIndices);
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
     // then do the same for each of its children
     for(unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        ProcessAssimpNode(scene, node->mChildren[i], myMesh, baseMeshMaterialIndex, submeshMaterialIndices);
+        ProcessAssimpNode(scene, node->mChildren[i], meshes);
     }
 }
 
-u32 LoadModel(App* app, const char* filename)
+// Depth first, so parents come before their children. The submeshes are the indices of the
+// aiMeshes, which are imported one to one in this mode.
+static void ProcessAssimpNodeHierarchy(aiNode* node, u32 parent, std::vector<ModelNode>& nodes)
 {
-    const aiScene* scene = aiImportFile(filename,
-                                        aiProcess_Triangulate           |
-                                        aiProcess_GenSmoothNormals      |
-                                        aiProcess_CalcTangentSpace      |
-                                        aiProcess_JoinIdenticalVertices |
-                                        aiProcess_PreTransformVertices  |
-                                        aiProcess_ImproveCacheLocality  |
-                                        aiProcess_OptimizeMeshes        |
-                                        aiProcess_SortByPType);
+    ModelNode modelNode;
+    modelNode.localTransform = glm::transpose(glm::make_mat4(&node->mTransformation.a1)); // aiMatrix4x4 is row major
+    modelNode.modelTransform = parent == UINT32_MAX ? modelNode.localTransform : nodes[parent].modelTransform * modelNode.localTransform;
+    modelNode.parent = parent;
+    modelNode.submeshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+    nodes.push_back(modelNode);
+
+    const u32 nodeIdx = (u32)nodes.size() - 1u;
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+        ProcessAssimpNodeHierarchy(node->mChildren[i], nodeIdx, nodes);
+}
 
-    if (!scene)
+// Triangle weighted averages of the vertex cache stats of all the submeshes of a model
+void LogMeshOptimizationStats(const char* filename, const std::vector<std::vector<MeshOptimizationStats>>& stats)
+{
+    MeshOptimizationStats total = {};
+    for (const std::vector<MeshOptimizationStats>& meshStats : stats)
     {
-        ELOG("Error loading mesh %s: %s", filename, aiGetErrorString());
-        return UINT32_MAX;
+        for (const MeshOptimizationStats& submeshStats : meshStats)
+        {
+            const f32 weight = (f32)submeshStats.triangleCount;
+            total.before.acmr += submeshStats.before.acmr * weight;
+            total.before.atvr += submeshStats.before.atvr * weight;
+            total.after.acmr += submeshStats.after.acmr * weight;
+            total.after.atvr += submeshStats.after.atvr * weight;
+            total.triangleCount += submeshStats.triangleCount;
+        }
     }
 
-    app->meshes.push_back(Mesh{});
-    Mesh& mesh = app->meshes.back();
-    u32 meshIdx = (u32)app->meshes.size() - 1u;
+    if (total.triangleCount == 0)
+        return;
+
+    const f32 invTriangleCount = 1.0f / (f32)total.triangleCount;
+    ILOG("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%u triangles)", filename,
+         total.before.acmr * invTriangleCount, total.after.acmr * invTriangleCount,
+         total.before.atvr * invTriangleCount, total.after.atvr * invTriangleCount,
+         total.triangleCount);
+}
+
+static bool HasFileExtension(const std::string& path, const char* extension)
+{
+    const size_t length = strlen(extension);
+    return path.size() > length && path.compare(path.size() - length, length, extension) == 0;
+}
 
-    app->models.push_back(Model{});
-    Model& model = app->models.back();
-    model.meshIdx = meshIdx;
-    u32 modelIdx = (u32)app->models.size() - 1u;
+// Assimp fallback for everything the native importers don't handle. Submeshes get their
+// vertices and full detail indices only, like ImportObjSubmeshes.
+static bool ImportAssimpSubmeshes(const char* filename, u32 loadFlags, const std::string& directory, std::vector<Submesh>& submeshes,
+                                  std::vector<u32>& submeshMaterials, std::vector<ImportedMaterial>& materials, std::vector<ModelNode>& nodes)
+{
+    const aiScene* scene = aiImportFile(filename, GetModelImportFlags(loadFlags));
 
-    String directory = GetDirectoryPart(MakeString(filename));
+    if (!scene)
+    {
+        ELOG("Error loading mesh %s: %s", filename, aiGetErrorString());
+        return false;
+    }
 
     // Create a list of materials
-    u32 baseMeshMaterialIndex = (u32)app->materials.size();
+    materials.resize(scene->mNumMaterials);
     for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
     {
-        app->materials.push_back(Material{});
-        Material& material = app->materials.back();
-        ProcessAssimpMaterial(app, scene->mMaterials[i], material, directory);
+        ProcessAssimpMaterial(scene->mMaterials[i], materials[i], directory);
     }
 
-    ProcessAssimpNode(scene, scene->mRootNode, &mesh, baseMeshMaterialIndex, model.materialIdx);
+    // The node tree is flattened first so the submesh order doesn't depend on
+    // which worker finishes first, then every aiMesh is converted in parallel.
+    // When the tree is kept, each aiMesh is converted once however many nodes use it.
+    std::vector<aiMesh*> assimpMeshes;
+    if (loadFlags & ModelLoad_KeepHierarchy)
+    {
+        assimpMeshes.assign(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+        ProcessAssimpNodeHierarchy(scene->mRootNode, UINT32_MAX, nodes);
+    }
+    else
+    {
+        ProcessAssimpNode(scene, scene->mRootNode, assimpMeshes);
+    }
+
+    submeshes.resize(assimpMeshes.size());
+    ParallelFor(assimpMeshes.size(), [&](u32 i)
+    {
+        ProcessAssimpMesh(scene, assimpMeshes[i], submeshes[i]);
+    });
+
+    // store the proper (previously proceessed) material for each submesh
+    for (aiMesh* assimpMesh : assimpMeshes)
+        submeshMaterials.push_back(assimpMesh->mMaterialIndex);
 
     aiReleaseImport(scene);
+    return true;
+}
+
+void GetMaterialTexturePaths(const ImportedMaterial& material, const std::string* paths[MATERIAL_TEXTURE_SLOTS])
+{
+    paths[0] = &material.albedoTexture;
+    paths[1] = &material.emissiveTexture;
+    paths[2] = &material.specularTexture;
+    paths[3] = &material.normalsTexture;
+    paths[4] = &material.bumpTexture;
+}
+
+TextureUsage GetMaterialTextureUsage(u32 slot)
+{
+    const TextureUsage slotUsages[MATERIAL_TEXTURE_SLOTS] = { TextureUsage_Color, TextureUsage_Color, TextureUsage_Mask, TextureUsage_Normals, TextureUsage_Mask };
+    ASSERT(slot < MATERIAL_TEXTURE_SLOTS, "Material texture slot out of range");
+    return slotUsages[slot];
+}
+
+// Each file once, with the usage of the first slot naming it, like LoadTextures2D
+static void CookImportedTextures(ImportedModel& model)
+{
+    model.textures.clear();
+    for (const ImportedMaterial& material : model.materials)
+    {
+        const std::string* paths[MATERIAL_TEXTURE_SLOTS];
+        GetMaterialTexturePaths(material, paths);
+
+        for (u32 slot = 0; slot < MATERIAL_TEXTURE_SLOTS; ++slot)
+        {
+            bool isListed = paths[slot]->empty();
+            for (const ImportedTexture& texture : model.textures)
+                isListed = isListed || texture.filepath == *paths[slot];
+
+            if (!isListed)
+            {
+                model.textures.push_back(ImportedTexture{});
+                model.textures.back().filepath = *paths[slot];
+                model.textures.back().usage = GetMaterialTextureUsage(slot);
+            }
+        }
+    }
+
+    std::vector<u8> isCooked(model.textures.size(), 0);
+    ParallelFor(model.textures.size(), [&](u32 i)
+    {
+        isCooked[i] = CookTexture(model.textures[i].filepath.c_str(), model.textures[i].usage, model.textures[i].cooked);
+    });
+
+    // The upload loads the failed ones again on its own, and shows them magenta
+    u32 cookedCount = 0;
+    for (u32 i = 0; i < model.textures.size(); ++i)
+        if (isCooked[i])
+            model.textures[cookedCount++] = std::move(model.textures[i]);
+    model.textures.resize(cookedCount);
+}
+
+static bool ImportModelMeshes(const char* filename, u32 loadFlags, ImportedModel& model)
+{
+    const u32 importFlags = GetModelImportFlags(loadFlags);
+    const u32 cacheFlags = loadFlags & ~(MODEL_LOAD_RESIDENCY_FLAGS | ModelLoad_CookTextures);
+    const bool useMeshCache = (loadFlags & ModelLoad_SkipMeshCache) == 0;
+    if (useMeshCache && ReadMeshCache(filename, importFlags, cacheFlags, model))
+        return true;
+
+    std::string path = filename;
+    size_t separator = path.find_last_of("/\\");
+    std::string directory = separator != std::string::npos ? path.substr(0, separator) : std::string(".");
+
+    // OBJ and GLB files skip Assimp, which stays as the fallback if the native parsers fail
+    std::vector<Submesh> importedSubmeshes;
+    std::vector<u32> importedMaterials;
+    std::vector<std::string> materialLibraries;
+    const bool useNativeImporters = (loadFlags & ModelLoad_AssimpOnly) == 0;
+    bool imported = false;
+    if (useNativeImporters && HasFileExtension(path, ".obj"))
+        imported = ImportObjSubmeshes(filename, directory, importedSubmeshes, importedMaterials, model.materials, materialLibraries);
+    else if (useNativeImporters && HasFileExtension(path, ".glb"))
+        imported = ImportGlbSubmeshes(filename, directory, (loadFlags & ModelLoad_KeepHierarchy) != 0, importedSubmeshes, importedMaterials, model.materials, model.nodes);
+
+    if (!imported)
+    {
+        importedSubmeshes.clear();
+        importedMaterials.clear();
+        model.materials.clear();
+        model.nodes.clear();
+        if (!ImportAssimpSubmeshes(filename, loadFlags, directory, importedSubmeshes, importedMaterials, model.materials, model.nodes))
+            return false;
+    }
+
+    // Fewer draws and texture binds for the files that spread a material over many groups.
+    // Node instances draw submeshes with their own transform, so those are left apart.
+    if ((loadFlags & ModelLoad_MergeSubmeshes) && model.nodes.empty())
+    {
+        const u32 importedCount = importedSubmeshes.size();
+        if (MergeSubmeshesByMaterial(importedSubmeshes, importedMaterials) < importedCount)
+            ILOG("%s: merged %u submeshes into %u by material", filename, importedCount, (u32)importedSubmeshes.size());
+    }
+
+    // Each submesh may end up as several if it is split for 16-bit indices
+    std::vector<std::vector<Submesh>> submeshParts(importedSubmeshes.size());
+    std::vector<std::vector<MeshOptimizationStats>> optimizationStats(importedSubmeshes.size());
+    ParallelFor(importedSubmeshes.size(), [&](u32 i)
+    {
+        // The source positions were only kept for the merge
+        std::vector<vec3>().swap(importedSubmeshes[i].positions);
+
+        if (loadFlags & ModelLoad_Split16BitIndices)
+            SplitSubmesh(std::move(importedSubmeshes[i]), MAX_16BIT_INDEX_VERTEX_COUNT, submeshParts[i]);
+        else
+            submeshParts[i].push_back(std::move(importedSubmeshes[i]));
+
+        // Meshlets reorder the full detail indices, the LODs are appended after them, and
+        // the optimizer keeps both ranges in place
+        for (Submesh& part : submeshParts[i])
+        {
+            VertexCacheStats imported = AnalyzeVertexCache(part.indices.data(), part.indexCount);
+
+            BuildSubmeshMeshlets(part);
+            BuildSubmeshLods(part);
+            MeshOptimizationStats stats = OptimizeSubmesh(part);
 
-    u32 vertexBufferSize = 0;
-    u32 indexBufferSize = 0;
+            // Report against the order the importer gave us, not the meshlet one
+            stats.before = imported;
+            optimizationStats[i].push_back(stats);
+        }
+    });
 
-    for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+    std::vector<u32> firstPart(importedSubmeshes.size());
+    for (u32 i = 0; i < importedSubmeshes.size(); ++i)
     {
-        vertexBufferSize += mesh.submeshes[i].vertices.size() * sizeof(float);
-        indexBufferSize  += mesh.submeshes[i].indices.size()  * sizeof(u32);
+        firstPart[i] = (u32)model.submeshes.size();
+        for (Submesh& submesh : submeshParts[i])
+        {
+            model.submeshes.push_back(std::move(submesh));
+            model.submeshMaterials.push_back(importedMaterials[i]);
+        }
     }
 
-    glGenBuffers(1, &mesh.vertexBufferHandle);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
+    // Nodes drawing a split submesh draw all its parts
+    for (ModelNode& node : model.nodes)
+    {
+        std::vector<u32> parts;
+        for (u32 submeshIdx : node.submeshes)
+            for (u32 part = 0; part < submeshParts[submeshIdx].size(); ++part)
+                parts.push_back(firstPart[submeshIdx] + part);
+        node.submeshes.swap(parts);
+    }
 
-    glGenBuffers(1, &mesh.indexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
+    LogMeshOptimizationStats(filename, optimizationStats);
 
-    u32 indicesOffset = 0;
-    u32 verticesOffset = 0;
+    BuildMeshBuffers(model.submeshes, model.vertexStorage, model.indexStorage, model.positionStorage);
+    model.vertexData = model.vertexStorage.data();
+    model.indexData = model.indexStorage.data();
+    model.positionData = model.positionStorage.data();
+    model.vertexDataSize = model.vertexStorage.size();
+    model.indexDataSize = model.indexStorage.size();
+    model.positionDataSize = model.positionStorage.size();
 
-    for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+    if (useMeshCache)
     {
-        const void* verticesData = mesh.submeshes[i].vertices.data();
-        const u32   verticesSize = mesh.submeshes[i].vertices.size() * sizeof(float);
-        glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
-        mesh.submeshes[i].vertexOffset = verticesOffset;
-        verticesOffset += verticesSize;
+        // The MTL files of an OBJ are baked into its cooked file, so they are its inputs. Set
+        // before writing, so the cooked file's key covers them too.
+        SetAssetInputs(filename, materialLibraries);
 
-        const void* indicesData = mesh.submeshes[i].indices.data();
-        const u32   indicesSize = mesh.submeshes[i].indices.size() * sizeof(u32);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
-        mesh.submeshes[i].indexOffset = indicesOffset;
-        indicesOffset += indicesSize;
+        WriteMeshCache(filename, importFlags, cacheFlags, model);
     }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+bool ImportModel(const char* filename, u32 loadFlags, ImportedModel& model)
+{
+    if (!ImportModelMeshes(filename, loadFlags, model))
+        return false;
+
+    if (loadFlags & ModelLoad_CookTextures)
+        CookImportedTextures(model);
 
-    return modelIdx;
+    return true;
+}
+
+void ReleaseImportedModel(ImportedModel& model)
+{
+    if (model.cacheFile.data)
+        UnmapFile(model.cacheFile);
+    model.cacheFile = {};
+
+    model.vertexData = model.indexData = model.positionData = nullptr;
+    model.vertexDataSize = model.indexDataSize = model.positionDataSize = 0;
+    std::vector<u8>().swap(model.vertexStorage);
+    std::vector<u8>().swap(model.indexStorage);
+    std::vector<u8>().swap(model.positionStorage);
+    std::vector<ImportedTexture>().swap(model.textures);
 }
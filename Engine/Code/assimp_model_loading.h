@@ -2,4 +2,96 @@
 
 #include "engine.h"
 
-u32 LoadModel(App* app, const char* filename);
\ No newline at end of file
+enum ModelLoadFlags
+{
+    ModelLoad_Split16BitIndices = 1 << 0, // Split submeshes too big for GL_UNSIGNED_SHORT indices
+    ModelLoad_KeepHierarchy     = 1 << 1, // Keep the node tree instead of baking it into the vertices
+    ModelLoad_SkipMeshCache     = 1 << 2, // Always parse the source and leave the mesh cache alone (benchmarks)
+    ModelLoad_KeepCpuPositions  = 1 << 3, // MeshResidency_PositionsOnly after upload
+    ModelLoad_KeepCpuGeometry   = 1 << 4, // MeshResidency_Full after upload, wins over KeepCpuPositions
+    ModelLoad_MergeSubmeshes    = 1 << 5, // One submesh per material and vertex layout (ignored with KeepHierarchy)
+    ModelLoad_CookTextures      = 1 << 6, // Cook the material textures into ImportedModel::textures too
+    ModelLoad_AssimpOnly        = 1 << 7, // Skip the native OBJ and GLB importers (benchmarks)
+};
+
+// Flags that only change what happens after the upload, so they don't key the mesh cache
+#define MODEL_LOAD_RESIDENCY_FLAGS (ModelLoad_KeepCpuPositions | ModelLoad_KeepCpuGeometry)
+
+#define MATERIAL_TEXTURE_SLOTS 5 // Albedo, emissive, specular, normals and bump
+
+#define DEFAULT_MODEL_LOAD_FLAGS (ModelLoad_Split16BitIndices | ModelLoad_MergeSubmeshes)
+
+struct ImportedMaterial
+{
+    std::string name;
+    vec3        albedo;
+    vec3        emissive;
+    f32         smoothness;
+    std::string albedoTexture;   // Paths, empty if the material has no such texture
+    std::string emissiveTexture;
+    std::string specularTexture;
+    std::string normalsTexture;
+    std::string bumpTexture;
+};
+
+struct ImportedTexture
+{
+    std::string   filepath;
+    TextureUsage  usage;
+    CookedTexture cooked;
+};
+
+// Everything a model needs before touching OpenGL, ready to be uploaded as it is. The
+// blobs point into the mapped mesh cache on warm starts, so they are uploaded straight
+// from its pages, and into the storage vectors after a fresh import.
+struct ImportedModel
+{
+    std::vector<Submesh>          submeshes;        // Offsets already point into the blobs
+    std::vector<u32>              submeshMaterials; // Index into materials for each submesh
+    std::vector<ImportedMaterial> materials;
+    std::vector<ImportedTexture>  textures;         // Only with ModelLoad_CookTextures, one per file that cooked
+    std::vector<ModelNode>        nodes;            // Only with ModelLoad_KeepHierarchy
+    const u8*                     vertexData = nullptr;
+    const u8*                     indexData = nullptr;
+    const u8*                     positionData = nullptr; // Position-only copy of vertexData
+    u32                           vertexDataSize = 0;
+    u32                           indexDataSize = 0;
+    u32                           positionDataSize = 0;
+    MappedFile                    cacheFile = {};   // Kept mapped until ReleaseImportedModel
+    std::vector<u8>               vertexStorage;
+    std::vector<u8>               indexStorage;
+    std::vector<u8>               positionStorage;
+};
+
+/**
+ * aiPostProcessSteps the Assimp path imports with, for a combination of ModelLoadFlags.
+ */
+u32 GetModelImportFlags(u32 loadFlags);
+
+/**
+ * Fills the texture paths of a material in slot order. Slots without a texture get an
+ * empty path.
+ */
+void GetMaterialTexturePaths(const ImportedMaterial& material, const std::string* paths[MATERIAL_TEXTURE_SLOTS]);
+
+/**
+ * What the texture in a material slot is cooked for.
+ */
+TextureUsage GetMaterialTextureUsage(u32 slot);
+
+/**
+ * Imports a model from its cooked mesh cache, or else parses it (and then cooks it), with
+ * the native importers for .obj and .glb files and Assimp for the rest or if those fail.
+ * With ModelLoad_CookTextures, its textures are cooked in parallel as well; a texture that
+ * fails is left out and doesn't fail the import. Only does CPU work, so it may run in any
+ * thread, and the result holds everything the upload needs (see model_upload.h), so it
+ * can also be timed on its own without a GL context.
+ */
+bool ImportModel(const char* filename, u32 loadFlags, ImportedModel& model);
+
+/**
+ * Unmaps the mesh cache an imported model may be reading from and drops its blobs and
+ * textures. Call
+ * it once they are uploaded (or the model is thrown away), before the model goes away.
+ */
+void ReleaseImportedModel(ImportedModel& model);
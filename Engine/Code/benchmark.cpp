@@ -0,0 +1,254 @@
+//
+// benchmark.cpp: Headless model import benchmark. It runs ImportModel, the CPU half of
+// model loading, on the sample models without a window or a GL context, and reports its
+// throughput and the peak memory of the process. Each model is imported with the native
+// parser, with Assimp and from the mesh cache. The imports cook the textures too, as
+// LoadModel's do, and those come from the texture cache after the first run. It also
+// times the vertex interleaving on its own against the push_back loop it replaced. Run it
+// from WorkingDir like the engine:
+//
+//     Benchmark [iterations]
+//
+
+#include "assimp_model_loading.h"
+#include "asset_database.h"
+#include "job_system.h"
+#include "vertex_interleave.h"
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+
+#include <chrono>
+#include <stdlib.h>
+
+#define BENCHMARK_DEFAULT_ITERATIONS 10
+#define BENCHMARK_LOAD_FLAGS         (DEFAULT_MODEL_LOAD_FLAGS | ModelLoad_CookTextures)
+
+static const char* BenchmarkModels[] = { "Patrick/Patrick.obj", "Cyborg/cyborg.obj" };
+static const char* InterleaveBenchmarkModel = "Cyborg/cyborg.obj";
+
+struct ImportRunStats
+{
+    u64 sourceBytes;  // Of the model file and its texture files, not its materials
+    u64 payloadBytes; // Vertex, index and position blobs and cooked textures of the imported model
+    u64 vertexCount;
+    f64 totalMilliseconds;
+    f64 minMilliseconds;
+    u32 iterations;
+};
+
+static u64 GetFileSize(const char* filepath)
+{
+    MappedFile file = MapFile(filepath);
+    u64 size = file.size;
+    UnmapFile(file);
+    return size;
+}
+
+static bool RunImports(const char* filename, u32 loadFlags, u32 iterations, ImportRunStats& stats)
+{
+    stats = {};
+    stats.minMilliseconds = 1e30;
+    stats.iterations = iterations;
+
+    for (u32 i = 0; i < iterations; ++i)
+    {
+        ImportedModel model;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool imported = ImportModel(filename, loadFlags, model);
+        f64 milliseconds = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!imported)
+            return false;
+
+        stats.totalMilliseconds += milliseconds;
+        stats.minMilliseconds = glm::min(stats.minMilliseconds, milliseconds);
+
+        stats.sourceBytes = GetFileSize(filename);
+        stats.payloadBytes = (u64)model.vertexDataSize + model.indexDataSize + model.positionDataSize;
+        for (const ImportedTexture& texture : model.textures)
+        {
+            stats.sourceBytes += GetFileSize(texture.filepath.c_str());
+            stats.payloadBytes += texture.cooked.data.size();
+        }
+
+        stats.vertexCount = 0;
+        for (const Submesh& submesh : model.submeshes)
+            stats.vertexCount += submesh.vertexDataSize / submesh.vertexBufferLayout.stride;
+
+        ReleaseImportedModel(model);
+    }
+
+    return true;
+}
+
+// Untimed import that leaves the cooked mesh cache up to date
+static bool WarmUpMeshCache(const char* filename)
+{
+    ImportedModel model;
+    const bool imported = ImportModel(filename, BENCHMARK_LOAD_FLAGS, model);
+    ReleaseImportedModel(model);
+    return imported;
+}
+
+static void PrintRunStats(const char* filename, const char* mode, const ImportRunStats& stats)
+{
+    const f64 seconds = stats.totalMilliseconds / 1000.0;
+    const f64 sourceMBs = (f64)stats.sourceBytes * stats.iterations / MB(1) / seconds;
+    const f64 payloadMBs = (f64)stats.payloadBytes * stats.iterations / MB(1) / seconds;
+    const f64 verticesPerSecond = (f64)stats.vertexCount * stats.iterations / seconds;
+
+    printf("%-22s %-6s %8.2f ms avg %8.2f ms min %9.1f MB/s source %9.1f MB/s payload %12.0f vertices/s\n",
+           filename, mode, stats.totalMilliseconds / stats.iterations, stats.minMilliseconds, sourceMBs, payloadMBs, verticesPerSecond);
+}
+
+// How ProcessAssimpMesh interleaved vertices before InterleaveVertices: a float vector grown
+// one push_back at a time, testing the optional streams for every vertex
+static void InterleaveWithPushBack(const VertexStreams& streams, std::vector<float>& vertices)
+{
+    for (u32 i = 0; i < streams.vertexCount; ++i)
+    {
+        vertices.push_back(streams.positions[i].x);
+        vertices.push_back(streams.positions[i].y);
+        vertices.push_back(streams.positions[i].z);
+        vertices.push_back(streams.normals[i].x);
+        vertices.push_back(streams.normals[i].y);
+        vertices.push_back(streams.normals[i].z);
+
+        if (streams.texCoords)
+        {
+            vertices.push_back(streams.texCoords[i].x);
+            vertices.push_back(streams.texCoords[i].y);
+        }
+
+        if (streams.tangents && streams.bitangents)
+        {
+            vertices.push_back(streams.tangents[i].x);
+            vertices.push_back(streams.tangents[i].y);
+            vertices.push_back(streams.tangents[i].z);
+            vertices.push_back(-streams.bitangents[i].x);
+            vertices.push_back(-streams.bitangents[i].y);
+            vertices.push_back(-streams.bitangents[i].z);
+        }
+    }
+}
+
+// Interleaving alone, on the post-processed streams Assimp gives for the model. The formats
+// are chosen outside the timed loop, as only the packing replaced the push_back loop.
+static bool RunInterleaveBenchmark(const char* filename, u32 iterations)
+{
+    const aiScene* scene = aiImportFile(filename, GetModelImportFlags(DEFAULT_MODEL_LOAD_FLAGS));
+    if (!scene)
+        return false;
+
+    std::vector<VertexStreams> streams(scene->mNumMeshes);
+    std::vector<VertexFormat> formats(scene->mNumMeshes);
+    std::vector<std::vector<u8>> outputs(scene->mNumMeshes);
+    u64 vertexCount = 0;
+    for (u32 i = 0; i < scene->mNumMeshes; ++i)
+    {
+        const aiMesh* mesh = scene->mMeshes[i];
+        const bool hasTangentSpace = mesh->mTangents != nullptr && mesh->mBitangents != nullptr;
+
+        streams[i] = {};
+        streams[i].vertexCount = mesh->mNumVertices;
+        streams[i].positions = (const vec3*)mesh->mVertices;
+        streams[i].normals = (const vec3*)mesh->mNormals;
+        streams[i].texCoords = (const vec3*)mesh->mTextureCoords[0];
+        streams[i].tangents = hasTangentSpace ? (const vec3*)mesh->mTangents : nullptr;
+        streams[i].bitangents = hasTangentSpace ? (const vec3*)mesh->mBitangents : nullptr;
+        streams[i].flipBitangents = true;
+
+        formats[i] = ChooseVertexFormat(streams[i]);
+        outputs[i].resize((u64)mesh->mNumVertices * MakeVertexBufferLayout(formats[i]).stride);
+        vertexCount += mesh->mNumVertices;
+    }
+
+    f64 pushBackMilliseconds = 0.0;
+    f64 interleaveMilliseconds = 0.0;
+    for (u32 iteration = 0; iteration < iterations; ++iteration)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (const VertexStreams& meshStreams : streams)
+        {
+            std::vector<float> vertices;
+            InterleaveWithPushBack(meshStreams, vertices);
+        }
+        pushBackMilliseconds += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < streams.size(); ++i)
+            InterleaveVertices(streams[i], formats[i], outputs[i].data());
+        interleaveMilliseconds += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    aiReleaseImport(scene);
+
+    printf("%-22s %-6s %8.3f ms push_back %8.3f ms packed %6.1fx (%llu vertices)\n", filename, "interl",
+           pushBackMilliseconds / iterations, interleaveMilliseconds / iterations,
+           pushBackMilliseconds / glm::max(interleaveMilliseconds, 1e-9), (unsigned long long)vertexCount);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    u32 iterations = argc > 1 ? (u32)atoi(argv[1]) : BENCHMARK_DEFAULT_ITERATIONS;
+    if (iterations == 0)
+    {
+        fprintf(stderr, "Usage: Benchmark [iterations]\n");
+        return 1;
+    }
+
+    InitJobSystem();
+    LoadAssetDatabase();
+
+    printf("Importing %u times each with %u workers\n", iterations, GetJobWorkerCount());
+
+    int result = 0;
+    for (const char* filename : BenchmarkModels)
+    {
+        ImportRunStats stats;
+
+        // Full import from the source file, as on the first run or after an edit
+        if (!RunImports(filename, BENCHMARK_LOAD_FLAGS | ModelLoad_SkipMeshCache, iterations, stats))
+        {
+            fprintf(stderr, "Could not import %s\n", filename);
+            result = 1;
+            continue;
+        }
+        PrintRunStats(filename, "parse", stats);
+
+        // The same with Assimp, which the native OBJ and GLB importers replaced
+        if (!RunImports(filename, BENCHMARK_LOAD_FLAGS | ModelLoad_SkipMeshCache | ModelLoad_AssimpOnly, iterations, stats))
+        {
+            fprintf(stderr, "Could not import %s with Assimp\n", filename);
+            result = 1;
+            continue;
+        }
+        PrintRunStats(filename, "assimp", stats);
+
+        // Cooked mesh cache, as on every later run
+        if (!WarmUpMeshCache(filename) ||
+            !RunImports(filename, BENCHMARK_LOAD_FLAGS, iterations, stats))
+        {
+            fprintf(stderr, "Could not import %s\n", filename);
+            result = 1;
+            continue;
+        }
+        PrintRunStats(filename, "cache", stats);
+    }
+
+    if (!RunInterleaveBenchmark(InterleaveBenchmarkModel, iterations))
+    {
+        fprintf(stderr, "Could not import %s\n", InterleaveBenchmarkModel);
+        result = 1;
+    }
+
+    printf("Peak memory: %.1f MB\n", (f64)GetPeakMemoryUsage() / MB(1));
+
+    ShutdownJobSystem();
+    SaveAssetDatabase();
+
+    return result;
+}
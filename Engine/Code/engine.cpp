@@ -6,10 +6,25 @@
 //
 
 #include "engine.h"
-#include "assimp_model_loading.h"
+#include "model_upload.h"
 #include "buffer_management.h"
+#include "vertex_interleave.h"
+#include "mesh_processing.h"
+#include "meshlet.h"
+#include "mesh_lod.h"
+#include "mesh_optimizer.h"
+#include "asset_streaming.h"
+#include "asset_database.h"
+#include "geometry_heap.h"
+#include "mesh_residency.h"
+#include "staging_ring.h"
+#include "scene.h"
+#include "hot_reload.h"
+#include "job_system.h"
+#include "texture_compression.h"
+#include "texture_cooker.h"
+#include "texture_streaming.h"
 #include <imgui.h>
-#include <stb_image.h>
 #include <stb_image_write.h>
 
 GLuint CreateProgramFromSource(String programSource, const char* shaderName)
@@ -148,27 +163,6 @@ u32 LoadProgram(App* app, const char* filepath, const char* programName)
     return app->programs.size() - 1;
 }
 
-Image LoadImage(const char* filename)
-{
-    Image img = {};
-    stbi_set_flip_vertically_on_load(true);
-    img.pixels = stbi_load(filename, &img.size.x, &img.size.y, &img.nchannels, 0);
-    if (img.pixels)
-    {
-        img.stride = img.size.x * img.nchannels;
-    }
-    else
-    {
-        ELOG("Could not open file %s", filename);
-    }
-    return img;
-}
-
-void FreeImage(Image image)
-{
-    stbi_image_free(image.pixels);
-}
-
 GLuint CreateTexture2DFromImage(Image image)
 {
     GLenum internalFormat = GL_RGB8;
@@ -197,25 +191,91 @@ GLuint CreateTexture2DFromImage(Image image)
     return texHandle;
 }
 
-u32 LoadTexture2D(App* app, const char* filepath)
+u32 GetTextureLevelBlockRows(const CookedTexture& texture, u32 level)
+{
+    return (texture.levels[level].size.y + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+}
+
+void UploadCompressedTextureRows(const CookedTexture& texture, u32 level, u32 firstLevel, u32 firstBlockRow, u32 blockRowCount)
+{
+    const TextureLevel& entry = texture.levels[level];
+    const u32 rowBytes = entry.dataSize / GetTextureLevelBlockRows(texture, level);
+    const i32 y = firstBlockRow * TEXTURE_BLOCK_SIZE;
+    const i32 height = glm::min((i32)(blockRowCount * TEXTURE_BLOCK_SIZE), entry.size.y - y);
+    const u8* rows = texture.data.data() + entry.offset + firstBlockRow * rowBytes;
+
+    // With a pixel unpack buffer bound, the data pointer is an offset into it
+    const u32 stagingOffset = WriteStagingData(rows, blockRowCount * rowBytes);
+    if (stagingOffset != UINT32_MAX)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GetStagingBuffer());
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, y, entry.size.x, height, texture.internalFormat,
+                                  blockRowCount * rowBytes, (const void*)(uintptr_t)stagingOffset);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, y, entry.size.x, height, texture.internalFormat,
+                                  blockRowCount * rowBytes, rows);
+    }
+}
+
+GLuint CreateCompressedTexture2D(const CookedTexture& texture, u32 firstLevel, bool uploadLevels)
+{
+    const ivec2 size = texture.levels[firstLevel].size;
+
+    GLuint texHandle;
+    glGenTextures(1, &texHandle);
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glTexStorage2D(GL_TEXTURE_2D, texture.levels.size() - firstLevel, texture.internalFormat, size.x, size.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Single channel textures read as grey, like they did uncompressed
+    if (texture.internalFormat == GL_COMPRESSED_RED_RGTC1)
+    {
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    if (uploadLevels)
+        for (u32 level = firstLevel; level < texture.levels.size(); ++level)
+            UploadCompressedTextureRows(texture, level, firstLevel, 0, GetTextureLevelBlockRows(texture, level));
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texHandle;
+}
+
+u32 AddTexture2D(App* app, const std::string& filepath, TextureUsage usage, CookedTexture& cooked)
+{
+    Texture tex = {};
+    tex.filepath = filepath;
+    tex.usage = usage;
+    tex.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath.c_str());
+
+    u32 texIdx = app->textures.size();
+    app->textures.push_back(tex);
+
+    // Starts with the coarse levels only, the finer ones stream in once they are seen
+    AddStreamedTexture(app, texIdx, cooked);
+    return texIdx;
+}
+
+u32 LoadTexture2D(App* app, const char* filepath, TextureUsage usage)
 {
     for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
         if (app->textures[texIdx].filepath == filepath)
             return texIdx;
 
-    Image image = LoadImage(filepath);
+    CookedTexture cooked;
 
-    if (image.pixels)
+    if (CookTexture(filepath, usage, cooked))
     {
-        Texture tex = {};
-        tex.handle = CreateTexture2DFromImage(image);
-        tex.filepath = filepath;
-
-        u32 texIdx = app->textures.size();
-        app->textures.push_back(tex);
-
-        FreeImage(image);
-        return texIdx;
+        return AddTexture2D(app, filepath, usage, cooked);
     }
     else
     {
@@ -223,6 +283,49 @@ u32 LoadTexture2D(App* app, const char* filepath)
     }
 }
 
+void LoadTextures2D(App* app, const std::vector<std::string>& filepaths, const std::vector<TextureUsage>& usages, std::vector<u32>& texIndices)
+{
+    texIndices.assign(filepaths.size(), UINT32_MAX);
+
+    // Only cook the files that aren't loaded yet, once each
+    std::vector<u32> cookList;
+    for (u32 i = 0; i < filepaths.size(); ++i)
+    {
+        if (filepaths[i].empty())
+            continue;
+
+        for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
+            if (app->textures[texIdx].filepath == filepaths[i])
+                texIndices[i] = texIdx;
+
+        bool isListed = false;
+        for (u32 cookIdx : cookList)
+            isListed = isListed || filepaths[cookIdx] == filepaths[i];
+
+        if (texIndices[i] == UINT32_MAX && !isListed)
+            cookList.push_back(i);
+    }
+
+    std::vector<CookedTexture> cooked(cookList.size());
+    std::vector<u8> isCooked(cookList.size(), 0);
+    ParallelFor(cookList.size(), [&](u32 i)
+    {
+        isCooked[i] = CookTexture(filepaths[cookList[i]].c_str(), usages[cookList[i]], cooked[i]);
+    });
+
+    // Uploads stay on this thread and in request order
+    for (u32 i = 0; i < cookList.size(); ++i)
+    {
+        if (isCooked[i])
+            texIndices[cookList[i]] = AddTexture2D(app, filepaths[cookList[i]], usages[cookList[i]], cooked[i]);
+    }
+
+    for (u32 i = 0; i < filepaths.size(); ++i)
+        for (u32 j = 0; j < i && texIndices[i] == UINT32_MAX; ++j)
+            if (filepaths[j] == filepaths[i])
+                texIndices[i] = texIndices[j];
+}
+
 constexpr vec3 GetAttenuation(u32 range)
 {
     float constant = 1.0;
@@ -301,11 +404,14 @@ void InitializeTextureQuad(App* app, const char* shaderName)
     Program& textureQuadProgram = app->programs[app->texturedQuadProgramIdx];
     app->textureQuadProgram_uTexture = glGetUniformLocation(textureQuadProgram.handle, "uTexture");
 
-    app->whiteTexIdx = LoadTexture2D(app, "color_white.png");
-    app->diceTexIdx = LoadTexture2D(app, "dice.png");
-    app->blackTexIdx = LoadTexture2D(app, "color_black.png");
-    app->normalTexIdx = LoadTexture2D(app, "color_normal.png");
-    app->magentaTexIdx = LoadTexture2D(app, "color_magenta.png");
+    std::vector<u32> texIndices;
+    LoadTextures2D(app, { "color_white.png", "dice.png", "color_black.png", "color_normal.png", "color_magenta.png" },
+                   { TextureUsage_Color, TextureUsage_Color, TextureUsage_Color, TextureUsage_Normals, TextureUsage_Color }, texIndices);
+    app->whiteTexIdx = texIndices[0];
+    app->diceTexIdx = texIndices[1];
+    app->blackTexIdx = texIndices[2];
+    app->normalTexIdx = texIndices[3];
+    app->magentaTexIdx = texIndices[4];
 
     app->mode = Mode_TexturedQuad;
 }
@@ -415,88 +521,47 @@ u32 CreatePlane(App* app)
 
     app->models.push_back(Model{});
     Model& model = app->models.back();
+    model.name = "Plane";
     model.meshIdx = meshIdx;
     u32 modelIdx = (u32)app->models.size() - 1u;
 
     mesh.submeshes.push_back(Submesh{});
     Submesh& subMesh = mesh.submeshes.back();
 
-    subMesh.vertexOffset = 0;
-    subMesh.indexOffset = 0;
-
-    f32 vertices[] = {  
-        /*Position*/ -1.0, 1.0, 0.0, /*Normal*/ 0, 0, 1.0, /*TextCoords*/ 0.0, 1.0, /*Tangent*/ 1,0,0, /*Bitangent*/ 0,1,0,
-        /*Position*/ -1.0, -1.0, 0.0, /*Normal*/ 0, 0, 1.0, /*TextCoords*/ 0.0, 0.0, /*Tangent*/ 1,0,0, /*Bitangent*/ 0,1,0,
-        /*Position*/  1.0, -1.0, 0.0, /*Normal*/ 0, 0, 1.0, /*TextCoords*/ 1.0, 0.0, /*Tangent*/ 1,0,0, /*Bitangent*/ 0,1,0,
-        /*Position*/  1.0, 1.0, 0.0, /*Normal*/ 0, 0, 1.0, /*TextCoords*/ 1.0, 1.0, /*Tangent*/ 1,0,0, /*Bitangent*/ 0,1,0, };
+    const vec3 positions[]  = { vec3(-1.0, 1.0, 0.0), vec3(-1.0, -1.0, 0.0), vec3(1.0, -1.0, 0.0), vec3(1.0, 1.0, 0.0) };
+    const vec3 normals[]    = { vec3(0, 0, 1.0), vec3(0, 0, 1.0), vec3(0, 0, 1.0), vec3(0, 0, 1.0) };
+    const vec3 texCoords[]  = { vec3(0.0, 1.0, 0), vec3(0.0, 0.0, 0), vec3(1.0, 0.0, 0), vec3(1.0, 1.0, 0) };
+    const vec3 tangents[]   = { vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0) };
+    const vec3 bitangents[] = { vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 1, 0) };
 
     u16 indices[] = { 0, 1, 2,
                       0, 2, 3};
 
-    for (int i = 0; i < 56; ++i)
-    {
-        subMesh.vertices.push_back(vertices[i]);
-    }
+    VertexStreams streams = {};
+    streams.vertexCount = ARRAY_COUNT(positions);
+    streams.positions = positions;
+    streams.normals = normals;
+    streams.texCoords = texCoords;
+    streams.tangents = tangents;
+    streams.bitangents = bitangents;
+    BuildSubmeshVertices(streams, subMesh);
 
     for (int i = 0; i < 6; ++i)
     {
         subMesh.indices.push_back(indices[i]);
     }
+    subMesh.indexCount = subMesh.indices.size();
+    subMesh.indexType = ChooseIndexType(streams.vertexCount);
+    OptimizeSubmesh(subMesh);
 
-    VertexBufferLayout vertexLayout;
-    vertexLayout.attributes.push_back({ 0, 3, 0 });
-    vertexLayout.attributes.push_back({ 1, 3, 3 * sizeof(float) });
-    vertexLayout.stride = 6 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, vertexLayout.stride });
-    vertexLayout.stride += 2 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, vertexLayout.stride });
-    vertexLayout.stride += 3 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, vertexLayout.stride });
-    vertexLayout.stride += 3 * sizeof(float);
-
-    subMesh.vertexBufferLayout = vertexLayout;
-
-    u32 vertexBufferSize = 0;
-    u32 indexBufferSize = 0;
-
-    vertexBufferSize += subMesh.vertices.size() * sizeof(float);
-    indexBufferSize += subMesh.indices.size() * sizeof(u32);
-
-    glGenBuffers(1, &mesh.vertexBufferHandle);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &mesh.indexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
-
-    u32 indicesOffset = 0;
-    u32 verticesOffset = 0;
-
-    const void* verticesData = subMesh.vertices.data();
-    const u32   verticesSize = subMesh.vertices.size() * sizeof(float);
-    glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
-    subMesh.vertexOffset = verticesOffset;
-    verticesOffset += verticesSize;
-
-    const void* indicesData = subMesh.indices.data();
-    const u32   indicesSize = subMesh.indices.size() * sizeof(u32);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
-    subMesh.indexOffset = indicesOffset;
-    indicesOffset += indicesSize;
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    UploadMesh(mesh);
 
     app->materials.push_back(Material{});
     Material& material = app->materials.back();
     material.name = "PlaneMat";
     material.albedo = vec3(1);
-    material.albedoTextureIdx = LoadTexture2D(app, "brickwall.jpg");
-    material.normalsTextureIdx = LoadTexture2D(app, "brickwall_normal.jpg");
+    material.albedoTextureIdx = LoadTexture2DAsync(app, "brickwall.jpg", TextureUsage_Color, app->whiteTexIdx);
+    material.normalsTextureIdx = LoadTexture2DAsync(app, "brickwall_normal.jpg", TextureUsage_Normals, app->normalTexIdx);
     u32 materialIdx = app->materials.size() - 1;
     model.materialIdx.push_back(materialIdx);
 
@@ -511,19 +576,17 @@ u32 CreateSphere(App* app)
 
     app->models.push_back(Model{});
     Model& model = app->models.back();
+    model.name = "Sphere";
     model.meshIdx = meshIdx;
     u32 modelIdx = (u32)app->models.size() - 1u;
 
     mesh.submeshes.push_back(Submesh{});
     Submesh& subMesh = mesh.submeshes.back();
 
-    subMesh.vertexOffset = 0;
-    subMesh.indexOffset = 0;
-
     const u32 H = 32;
     const u32 V = 16;
-    struct Vertex { vec3 pos; vec3 norm; };
-    Vertex sphere[H][V + 1];
+    std::vector<vec3> positions;
+    std::vector<vec3> normals;
 
     for (int h = 0; h < H; ++h)
     {
@@ -533,30 +596,28 @@ u32 CreateSphere(App* app)
             float nv = float(v) / V - 0.5f;
             float angleh = 2 * PI * nh;
             float anglev = -PI * nv;
-            sphere[h][v].pos.x = sinf(angleh) * cosf(anglev);
-            sphere[h][v].pos.y = -sinf(anglev);
-            sphere[h][v].pos.z = cosf(angleh) * cosf(anglev);
-            sphere[h][v].norm = sphere[h][v].pos;
-            subMesh.vertices.push_back(sphere[h][v].pos.x);
-            subMesh.vertices.push_back(sphere[h][v].pos.y);
-            subMesh.vertices.push_back(sphere[h][v].pos.z);
-            subMesh.vertices.push_back(sphere[h][v].norm.x);
-            subMesh.vertices.push_back(sphere[h][v].norm.y);
-            subMesh.vertices.push_back(sphere[h][v].norm.z);
-            //TexCoords
-            subMesh.vertices.push_back(0);
-            subMesh.vertices.push_back(0);
-            //Tangents
-            subMesh.vertices.push_back(0);
-            subMesh.vertices.push_back(0);
-            subMesh.vertices.push_back(0);
-            //Bitangets
-            subMesh.vertices.push_back(0);
-            subMesh.vertices.push_back(0);
-            subMesh.vertices.push_back(0);
+            vec3 pos;
+            pos.x = sinf(angleh) * cosf(anglev);
+            pos.y = -sinf(anglev);
+            pos.z = cosf(angleh) * cosf(anglev);
+            positions.push_back(pos);
+            normals.push_back(pos);
         }
     }
 
+    // The light volume has no texture mapping, but keeps the attributes so any mesh
+    // program can draw it
+    std::vector<vec3> zeros(positions.size(), vec3(0.0f));
+
+    VertexStreams streams = {};
+    streams.vertexCount = positions.size();
+    streams.positions = positions.data();
+    streams.normals = normals.data();
+    streams.texCoords = zeros.data();
+    streams.tangents = zeros.data();
+    streams.bitangents = zeros.data();
+    BuildSubmeshVertices(streams, subMesh);
+
     u32 sphereIndices[H][V][6];
 
     for (u32 h = 0; h < H; ++h)
@@ -578,54 +639,11 @@ u32 CreateSphere(App* app)
 
         }
     }
+    subMesh.indexCount = subMesh.indices.size();
+    subMesh.indexType = ChooseIndexType(streams.vertexCount);
+    OptimizeSubmesh(subMesh);
 
-    VertexBufferLayout vertexLayout;
-    vertexLayout.attributes.push_back({ 0, 3, 0 });
-    vertexLayout.attributes.push_back({ 1, 3, 3 * sizeof(float) });
-    vertexLayout.stride = 6 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, vertexLayout.stride });
-    vertexLayout.stride += 2 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, vertexLayout.stride });
-    vertexLayout.stride += 3 * sizeof(float);
-
-    vertexLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, vertexLayout.stride });
-    vertexLayout.stride += 3 * sizeof(float);
-
-    subMesh.vertexBufferLayout = vertexLayout;
-
-    u32 vertexBufferSize = 0;
-    u32 indexBufferSize = 0;
-
-    vertexBufferSize += subMesh.vertices.size() * sizeof(float);
-    indexBufferSize += subMesh.indices.size() * sizeof(u32);
-   
-    glGenBuffers(1, &mesh.vertexBufferHandle);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &mesh.indexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
-
-    u32 indicesOffset = 0;
-    u32 verticesOffset = 0;
-
-    const void* verticesData = subMesh.vertices.data();
-    const u32   verticesSize = subMesh.vertices.size() * sizeof(float);
-    glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
-    subMesh.vertexOffset = verticesOffset;
-    verticesOffset += verticesSize;
-
-    const void* indicesData = subMesh.indices.data();
-    const u32   indicesSize = subMesh.indices.size() * sizeof(u32);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
-    subMesh.indexOffset = indicesOffset;
-    indicesOffset += indicesSize;
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    UploadMesh(mesh);
 
     app->materials.push_back(Material{});
     Material& material = app->materials.back();
@@ -673,6 +691,10 @@ void Init(App* app)
     glBufferData(GL_UNIFORM_BUFFER, app->maxUniformBufferSize, NULL, GL_STREAM_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+    // Cooked files whose sources changed since the last run are redone in the background, so
+    // startup doesn't wait on them. Loads that get to a stale asset first just cook it themselves.
+    LoadAssetDatabase();
+    RunJobAsync([]() { RebuildStaleAssets(); });
 
     InitializeTextureQuad(app, "TEXTURE_FILLQUAD");
     InitializeTextureMesh(app,"TEXTURE_GEOMETRY");
@@ -683,30 +705,24 @@ void Init(App* app)
     InitailizeTextureNormalMap(app, "TEXTURE_NORMALMAPPING");
 
     //Patricks
-    u32 patrick = LoadModel(app, "Patrick/Patrick.obj");
+    u32 patrick = LoadModelAsync(app, "Patrick/Patrick.obj");
     Entity enTity1 = Entity(vec3(0.0, 3.5, 0.0), vec3(0.0f), vec3(1.0f), patrick, 0, 0);
-    enTity1.name = "Patrick" + std::to_string(app->enTities.size());
     app->enTities.push_back(enTity1);
     Entity enTity2 = Entity(vec3(5.0, 3.5, 5.0), vec3(0.0f), vec3(1.0f), patrick, 0, 0);
-    enTity2.name = "Patrick" + std::to_string(app->enTities.size());
     app->enTities.push_back(enTity2);
 
-    u32 cyborg = LoadModel(app, "Cyborg/cyborg.obj");
+    u32 cyborg = LoadModelAsync(app, "Cyborg/cyborg.obj");
     Entity enTity3 = Entity(vec3(-5.0, 3.5, 5.0), vec3(0.0f), vec3(2.0f), cyborg, 0, 0);
-    enTity3.name = "Cyborg" + std::to_string(app->enTities.size());
     app->enTities.push_back(enTity3);
 
     app->sphereId = CreateSphere(app);
     Entity sphere = Entity(vec3(0), vec3(0.0f), vec3(1.0f), app->sphereId, 0, 0);
-    sphere.name = "Sphere" + std::to_string(app->enTities.size());
     app->enTities.push_back(sphere);
 
     u32 planeId = CreatePlane(app);
     Entity plane = Entity(vec3(0), vec3(0.0f), vec3(20.0f), planeId, 0, 0);
-    plane.name = "Plane" + std::to_string(app->enTities.size());
     app->enTities.push_back(plane);
     Entity plane1 = Entity(vec3(0), vec3(-90.0f,0.0f,0.0f), vec3(20.0f), planeId, 0, 0);
-    plane1.name = "Plane" + std::to_string(app->enTities.size());
     app->enTities.push_back(plane1);
 
     app->framebufferHandle = CreateFrameBuffers(app);
@@ -725,6 +741,9 @@ void Init(App* app)
         Light light2 = CreateLight(LightType::Point, vec3(-7.0f+(i*5.0f), 2.0f, 0.0f), vec3(1.0f), vec3(0.0f + i, 1.0f, 1.0f - i), 10.0f);
         app->lights.push_back(light2);
     }
+
+    // The scene saved from the editor, if any, replaces the default one
+    LoadScene(app, SCENE_FILE_PATH);
 }
 
 void Docking()
@@ -755,6 +774,20 @@ void Docking()
     }
 }
 
+// Entities are named after their model and their index, like the lights are
+static void GetEntityLabel(App* app, u32 entityIdx, char* label, u32 labelSize)
+{
+    const std::string& modelName = app->models[app->enTities[entityIdx].modelIdx].name;
+
+    size_t nameStart = modelName.find_last_of("/\\");
+    nameStart = nameStart != std::string::npos ? nameStart + 1 : 0;
+    size_t nameEnd = modelName.find_last_of('.');
+    if (nameEnd == std::string::npos || nameEnd < nameStart)
+        nameEnd = modelName.size();
+
+    snprintf(label, labelSize, "%.*s%u", (int)(nameEnd - nameStart), modelName.c_str() + nameStart, entityIdx);
+}
+
 void Gui(App* app)
 {
     Docking();
@@ -776,34 +809,42 @@ void Gui(App* app)
             ImGui::EndMenu();
         }
 
+        if (ImGui::BeginMenu("Scene")) {
+
+            if (ImGui::MenuItem("Save ##scene")) {
+                SaveScene(app, SCENE_FILE_PATH);
+            }
+
+            if (ImGui::MenuItem("Load ##scene")) {
+                LoadScene(app, SCENE_FILE_PATH);
+            }
+            ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("Create ##primitive")) {
             if (ImGui::BeginMenu("Entities"))
             {
                 if (ImGui::MenuItem("Plane ##primitive")) {
 
                     Entity plane = Entity(vec3(0), vec3(0.0f), vec3(1.0f), 3, 0, 0);
-                    plane.name = "Plane" + std::to_string(app->enTities.size());
                     app->enTities.push_back(plane);
                     app->currentEntity = nullptr;
                 }
                 if (ImGui::MenuItem("Sphere ##primitive")) {
 
                     Entity sphere = Entity(vec3(0), vec3(0.0f), vec3(1.0f), 2, 0, 0);
-                    sphere.name = "Sphere" + std::to_string(app->enTities.size());
                     app->enTities.push_back(sphere);
                     app->currentEntity = nullptr;
                 }
                 if (ImGui::MenuItem("Patrick ##primitive")) {
 
                     Entity patrick = Entity(vec3(0), vec3(0.0f), vec3(1.0f), 0, 0, 0);
-                    patrick.name = "Patrick" + std::to_string(app->enTities.size());
                     app->enTities.push_back(patrick);
                     app->currentEntity = nullptr;
                 }
                 if (ImGui::MenuItem("Cyborg ##primitive")) {
 
                     Entity cyborg = Entity(vec3(0), vec3(0.0f), vec3(1.0f), 1, 0, 0);
-                    cyborg.name = "Cyborg" + std::to_string(app->enTities.size());
                     app->enTities.push_back(cyborg);
                     app->currentEntity = nullptr;
                 }
@@ -964,7 +1005,9 @@ void Gui(App* app)
                     {
                         Entity* entity = &app->enTities[i];
 
-                        if (ImGui::TreeNodeEx(entity->name.c_str(), ImGuiTreeNodeFlags_Leaf))
+                        char entityLabel[64];
+                        GetEntityLabel(app, i, entityLabel, sizeof(entityLabel));
+                        if (ImGui::TreeNodeEx(entityLabel, ImGuiTreeNodeFlags_Leaf))
                         {
                             if (ImGui::IsItemClicked(ImGuiMouseButton_Left))
                                 app->currentEntity = entity;
@@ -980,7 +1023,9 @@ void Gui(App* app)
                     mat4 entityMat = app->currentEntity->worldMatrix;
 
                     ImGui::Separator();
-                    ImGui::TextColored(ImVec4(0.0,1.0,1.0,1.0), app->currentEntity->name.c_str());
+                    char entityLabel[64];
+                    GetEntityLabel(app, app->currentEntity - app->enTities.data(), entityLabel, sizeof(entityLabel));
+                    ImGui::TextColored(ImVec4(0.0,1.0,1.0,1.0), entityLabel);
                     ImGui::Separator();
 
                     static int id = app->currentEntity->modelIdx;
@@ -1069,6 +1114,36 @@ void Gui(App* app)
             }
 
             ImGui::Checkbox("Normal Mapping", &app->isNormalMap);
+            ImGui::Checkbox("Meshlet Culling", &app->meshletCulling);
+            if (app->meshletCulling)
+                ImGui::Text("Meshlets: %u / %u", app->visibleMeshletCount, app->totalMeshletCount);
+            ImGui::SliderFloat("LOD Bias", &app->lodBias, -2.0f, 4.0f);
+            if (GetPendingAssetCount() > 0)
+                ImGui::Text("Streaming: %u assets", GetPendingAssetCount());
+            ImGui::Text("Texture memory: %.1f / %u MB", GetStreamedTextureMemory() / (1024.0f * 1024.0f), app->textureMemoryBudgetMB);
+            ImGui::SliderInt("Texture Budget (MB)", (int*)&app->textureMemoryBudgetMB, 8, 512);
+
+            u64 geometryUsed, geometryCapacity;
+            GetGeometryHeapUsage(geometryUsed, geometryCapacity);
+            ImGui::Text("Geometry memory: %.1f / %.1f MB", geometryUsed / (1024.0f * 1024.0f), geometryCapacity / (1024.0f * 1024.0f));
+            if (ImGui::Button("Compact Geometry"))
+                CompactGeometryHeap(app);
+
+            u64 stagingUsed, stagingCapacity;
+            GetStagingRingUsage(stagingUsed, stagingCapacity);
+            ImGui::Text("Staging: %.1f / %.1f MB in flight", stagingUsed / (1024.0f * 1024.0f), stagingCapacity / (1024.0f * 1024.0f));
+            ImGui::SliderInt("Upload Budget (KB)", (int*)&app->uploadBudgetKB, 256, 8192);
+
+            MeshResidencyStats residencyStats;
+            GetMeshResidencyStats(app, residencyStats);
+            for (u32 residency = 0; residency < MeshResidency_Count; ++residency)
+            {
+                if (residencyStats.meshCount[residency] == 0)
+                    continue;
+                ImGui::Text("CPU geometry (%s): %u meshes, %.2f MB, %.2f MB saved", GetMeshResidencyName((MeshResidency)residency),
+                            residencyStats.meshCount[residency], residencyStats.keptBytes[residency] / (1024.0f * 1024.0f),
+                            (residencyStats.fullBytes[residency] - glm::min(residencyStats.keptBytes[residency], residencyStats.fullBytes[residency])) / (1024.0f * 1024.0f));
+            }
 
             ImGui::End();
         }
@@ -1085,9 +1160,16 @@ void Update(App* app)
 {
     // You can handle app->input keyboard/mouse here
 
-    app->projection = glm::perspective(glm::radians(60.0f), app->camera.aspectRatio, app->camera.zNear, app->camera.zFar);
+    BeginStagingFrame(app->uploadBudgetKB * 1024);
+
+    UpdateHotReload(app);
+    UpdateAssetStreaming(app);
+
+    app->projection = glm::perspective(glm::radians(app->camera.fovY), app->camera.aspectRatio, app->camera.zNear, app->camera.zFar);
     app->view = glm::lookAt(app->camera.pos, app->camera.target, vec3(0.0f, 1.0f, 0.0f));
 
+    UpdateTextureStreaming(app);
+
     //Uniforms
     glBindBuffer(GL_UNIFORM_BUFFER, app->cBuffer.handle);
     app->cBuffer.data = (u8*)glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
@@ -1118,16 +1200,33 @@ void Update(App* app)
     //Local Params
     for (u32 i = 0; i < app->enTities.size(); ++i)
     {
-        AlignHead(app->cBuffer, app->uniformBlockAlignment);
-
         Entity& entity = app->enTities[i];
-        mat4    world = entity.worldMatrix;
-        mat4    worldViewProjection = app->projection * app->view * world;
+        const Model& model = app->models[entity.modelIdx];
 
-        entity.localParamsOffset = app->cBuffer.head;
-        PushMat4(app->cBuffer, world);
-        PushMat4(app->cBuffer, worldViewProjection);
-        entity.localParamsSize = app->cBuffer.head - entity.localParamsOffset;
+        // Models with nodes get one block per node that draws something, see Entity
+        const u32 blockCount = model.nodes.empty() ? 1u : (u32)model.nodes.size();
+        bool firstBlock = true;
+        for (u32 n = 0; n < blockCount; ++n)
+        {
+            if (!model.nodes.empty() && model.nodes[n].submeshes.empty())
+                continue;
+
+            AlignHead(app->cBuffer, app->uniformBlockAlignment);
+
+            mat4    world = model.nodes.empty() ? entity.worldMatrix : entity.worldMatrix * model.nodes[n].modelTransform;
+            mat4    worldViewProjection = app->projection * app->view * world;
+
+            u32 blockOffset = app->cBuffer.head;
+            PushMat4(app->cBuffer, world);
+            PushMat4(app->cBuffer, worldViewProjection);
+
+            if (firstBlock)
+            {
+                entity.localParamsOffset = blockOffset;
+                entity.localParamsSize = app->cBuffer.head - blockOffset;
+                firstBlock = false;
+            }
+        }
     }
 
     //Push light Matrices
@@ -1151,55 +1250,66 @@ void Update(App* app)
 }
 
 
-GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program)
+void UploadMeshBuffers(std::vector<Submesh>& submeshes, const u8* vertexData, const u8* indexData, const u8* positionData)
 {
-    Submesh& submesh = mesh.submeshes[submeshIndex];
-
-    for (u32 i = 0; i < (u32)submesh.vaos.size(); ++i)
+    for (Submesh& submesh : submeshes)
     {
-        if (submesh.vaos[i].programHandle == program.handle)
-            return submesh.vaos[i].handle;
+        AllocateSubmeshGeometry(submesh);
+        if (vertexData)
+            UploadSubmeshVertices(submesh, 0, submesh.vertexDataSize, vertexData + submesh.vertexOffset);
+        if (indexData)
+            UploadSubmeshIndices(submesh, 0, submesh.indexDataSize, indexData + submesh.indexOffset);
+        if (positionData && submesh.positionDataSize > 0)
+            UploadSubmeshPositions(submesh, 0, submesh.positionDataSize, positionData + submesh.positionOffset);
     }
+}
 
-    GLuint vaoHandle = 0;
-
-    //Create a Vao
-    glGenVertexArrays(1, &vaoHandle);
-    glBindVertexArray(vaoHandle);
-
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
+void UploadMesh(Mesh& mesh)
+{
+    std::vector<u8> vertexData;
+    std::vector<u8> indexData;
+    std::vector<u8> positionData;
+    BuildMeshBuffers(mesh.submeshes, vertexData, indexData, positionData);
+    UploadMeshBuffers(mesh.submeshes, vertexData.data(), indexData.data(), positionData.data());
+    ApplyMeshResidency(mesh, mesh.residency, vertexData.data(), indexData.data());
+}
 
-    for (u32 i = 0; i < program.vertexInputLayout.attributes.size(); ++i)
-    {
-        bool attributeWasLinked = false;
+// Whether a program reads nothing but aPosition, and the submesh has a stream for it
+static bool UsesPositionStream(const Submesh& submesh, const Program& program)
+{
+    if (submesh.positionFormat == UINT32_MAX)
+        return false;
 
-        for (u32 j = 0; j < submesh.vertexBufferLayout.attributes.size(); ++j)
-        {
-            if (program.vertexInputLayout.attributes[i].location == submesh.vertexBufferLayout.attributes[j].location)
-            {
-                const u32 index = submesh.vertexBufferLayout.attributes[j].location;
-                const u32 compCount = submesh.vertexBufferLayout.attributes[j].componentCount;
-                const u32 offset = submesh.vertexBufferLayout.attributes[j].offset + submesh.vertexOffset;
-                const u32 stride = submesh.vertexBufferLayout.stride;
+    for (const VertexShaderAttribute& attribute : program.vertexInputLayout.attributes)
+        if (attribute.location != 0)
+            return false;
 
-                glVertexAttribPointer(index, compCount, GL_FLOAT, GL_FALSE, stride, (void*)(u64)offset);
-                glEnableVertexAttribArray(index);
+    return true;
+}
 
-                attributeWasLinked = true;
-                break;
-            }
-        }
+GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program)
+{
+    const Submesh& submesh = mesh.submeshes[submeshIndex];
+    if (UsesPositionStream(submesh, program))
+        return FindGeometryVAO(submesh.positionFormat, program);
 
-        assert(attributeWasLinked);
-    }
+    return FindGeometryVAO(submesh.geometryFormat, program);
+}
 
-    glBindVertexArray(0);
+u32 GetSubmeshBaseVertex(const Submesh& submesh, const Program& program)
+{
+    return UsesPositionStream(submesh, program) ? submesh.positionBaseVertex : submesh.baseVertex;
+}
 
-    Vao vao = { vaoHandle, program.handle };
-    submesh.vaos.push_back(vao);
+// Packed positions are decoded in the vertex shaders as aPosition * scale + bias,
+// with these explicit uniform locations (see shaders.glsl)
+#define POSITION_SCALE_UNIFORM_LOCATION 0
+#define POSITION_BIAS_UNIFORM_LOCATION  1
 
-    return vaoHandle;
+void SetSubmeshUniforms(const Submesh& submesh)
+{
+    glUniform3fv(POSITION_SCALE_UNIFORM_LOCATION, 1, glm::value_ptr(submesh.positionScale));
+    glUniform3fv(POSITION_BIAS_UNIFORM_LOCATION, 1, glm::value_ptr(submesh.positionBias));
 }
 
 void DeferredShadingGeometryPass(App* app)
@@ -1225,6 +1335,14 @@ void DeferredShadingGeometryPass(App* app)
     Program* textureMeshProgram = &app->programs[app->texturedGeometryProgramIdx];
     glUseProgram(textureMeshProgram->handle);
 
+    const mat4 viewProjection = app->projection * app->view;
+    std::vector<GLsizei> meshletCounts;
+    std::vector<const void*> meshletOffsets;
+    std::vector<GLint> meshletBaseVertices;
+    app->visibleMeshletCount = 0;
+    app->totalMeshletCount = 0;
+    GLuint boundVao = 0;
+
     for (int j = 0; j < app->enTities.size(); ++j)
     {
         Model& model = app->models[app->enTities[j].modelIdx];
@@ -1232,36 +1350,92 @@ void DeferredShadingGeometryPass(App* app)
 
         u32 blockOffset = app->enTities[j].localParamsOffset;
         u32 blockSize = app->enTities[j].localParamsSize;
+        const u32 blockStride = Align(blockSize, app->uniformBlockAlignment);
 
-        glBindBufferRange(GL_UNIFORM_BUFFER, 1, app->cBuffer.handle, blockOffset, blockSize);
-
-        for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+        // Models without nodes draw every submesh once with the entity transform, the
+        // others draw the submeshes of each node with the node transform on top
+        const u32 nodeCount = model.nodes.empty() ? 1u : (u32)model.nodes.size();
+        for (u32 n = 0; n < nodeCount; ++n)
         {
-            u32 submeshMaterialIdx = model.materialIdx[i];
-            Material* submeshMaterial = &app->materials[submeshMaterialIdx];
+            const ModelNode* node = model.nodes.empty() ? nullptr : &model.nodes[n];
+            if (node && node->submeshes.empty())
+                continue;
 
-            if (submeshMaterial->normalsTextureIdx != 0 && app->isNormalMap == true)
+            glBindBufferRange(GL_UNIFORM_BUFFER, 1, app->cBuffer.handle, blockOffset, blockSize);
+            blockOffset += blockStride;
+
+            const mat4 world = node ? app->enTities[j].worldMatrix * node->modelTransform : app->enTities[j].worldMatrix;
+            MeshletCullingView cullingView = MakeMeshletCullingView(viewProjection, world, app->camera.pos);
+
+            const u32 submeshCount = node ? (u32)node->submeshes.size() : (u32)mesh.submeshes.size();
+            for (u32 k = 0; k < submeshCount; ++k)
             {
-                textureMeshProgram = &app->programs[app->texturedNormalMapIdx];
-                glUseProgram(textureMeshProgram->handle);
+                const u32 i = node ? node->submeshes[k] : k;
+                Submesh& submesh = mesh.submeshes[i];
 
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, app->textures[submeshMaterial->normalsTextureIdx].handle);
-                glUniform1i(app->textureNormalMapProgram_uTexture, 1);
-            }
+                u32 lod = SelectSubmeshLod(submesh, cullingView.world, cullingView.worldScale, app->camera.pos,
+                                           glm::radians(app->camera.fovY), (f32)app->displaySize.y, app->lodBias);
+
+                // Cull the meshlets first, submeshes with none visible are skipped altogether.
+                // Meshlets only cover the full detail indices.
+                bool drawMeshlets = lod == 0 && app->meshletCulling && !submesh.meshlets.empty();
+                if (drawMeshlets)
+                {
+                    meshletCounts.clear();
+                    meshletOffsets.clear();
+                    app->visibleMeshletCount += CullSubmeshMeshlets(submesh, cullingView, meshletCounts, meshletOffsets);
+                    app->totalMeshletCount += submesh.meshlets.size();
+                    if (meshletCounts.empty())
+                        continue;
+                }
+
+                u32 submeshMaterialIdx = model.materialIdx[i];
+                Material* submeshMaterial = &app->materials[submeshMaterialIdx];
 
-            GLuint vao = FindVAO(mesh, i, *textureMeshProgram);
-            glBindVertexArray(vao);
+                if (submeshMaterial->normalsTextureIdx != 0 && app->isNormalMap == true)
+                {
+                    textureMeshProgram = &app->programs[app->texturedNormalMapIdx];
+                    glUseProgram(textureMeshProgram->handle);
+
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, app->textures[submeshMaterial->normalsTextureIdx].handle);
+                    glUniform1i(app->textureNormalMapProgram_uTexture, 1);
+                }
+
+                // Submeshes sharing a vertex layout share the VAO too
+                GLuint vao = FindVAO(mesh, i, *textureMeshProgram);
+                if (vao != boundVao)
+                {
+                    glBindVertexArray(vao);
+                    boundVao = vao;
+                }
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, app->textures[submeshMaterial->albedoTextureIdx].handle);
-            glUniform1i(app->textureMeshProgram_uTexture, 0);
-            
-            Submesh& submesh = mesh.submeshes[i];
-            glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, app->textures[submeshMaterial->albedoTextureIdx].handle);
+                glUniform1i(app->textureMeshProgram_uTexture, 0);
+                
+                SetSubmeshUniforms(submesh);
+                if (drawMeshlets)
+                {
+                    meshletBaseVertices.assign(meshletCounts.size(), submesh.baseVertex);
+                    glMultiDrawElementsBaseVertex(GL_TRIANGLES, meshletCounts.data(), submesh.indexType, meshletOffsets.data(),
+                                                  meshletCounts.size(), meshletBaseVertices.data());
+                }
+                else if (lod > 0)
+                {
+                    const SubmeshLod& range = submesh.lods[lod];
+                    u32 offset = (submesh.firstIndex + range.indexOffset) * GetIndexSize(submesh.indexType);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, submesh.indexType, (void*)(u64)offset, submesh.baseVertex);
+                }
+                else
+                {
+                    u32 offset = submesh.firstIndex * GetIndexSize(submesh.indexType);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, submesh.indexCount, submesh.indexType, (void*)(u64)offset, submesh.baseVertex);
+                }
 
-            textureMeshProgram = &app->programs[app->texturedGeometryProgramIdx];
-            glUseProgram(textureMeshProgram->handle);
+                textureMeshProgram = &app->programs[app->texturedGeometryProgramIdx];
+                glUseProgram(textureMeshProgram->handle);
+            }
         }
     }
 
@@ -1344,16 +1518,21 @@ void DeferredShadingLightPass(App* app)
             u32 blockOffset = app->lights[j].localParamsOffset;
             u32 blockSize = app->lights[j].localParamsSize;
             glBindBufferRange(GL_UNIFORM_BUFFER, 1, app->cBuffer.handle, blockOffset, blockSize);
+            // The stencil pass only needs positions, it reads the packed position stream
+            const Program& depthStencilProgram = app->programs[app->texturedDepthStencil];
             for (u32 i = 0; i < mesh.submeshes.size(); ++i)
             {
-                GLuint vao = FindVAO(mesh, i, app->programs[app->texturedDepthStencil]);
+                GLuint vao = FindVAO(mesh, i, depthStencilProgram);
                 glBindVertexArray(vao);
 
                 u32 submeshMaterialIdx = model.materialIdx[i];
                 Material& submeshMaterial = app->materials[submeshMaterialIdx];
 
                 Submesh& submesh = mesh.submeshes[i];
-                glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
+                SetSubmeshUniforms(submesh);
+                u32 offset = submesh.firstIndex * GetIndexSize(submesh.indexType);
+                glDrawElementsBaseVertex(GL_TRIANGLES, submesh.indexCount, submesh.indexType, (void*)(u64)offset,
+                                         GetSubmeshBaseVertex(submesh, depthStencilProgram));
             }
 
             glDrawBuffer(GL_COLOR_ATTACHMENT0);
@@ -1376,7 +1555,9 @@ void DeferredShadingLightPass(App* app)
                 Material& submeshMaterial = app->materials[submeshMaterialIdx];
 
                 Submesh& submesh = mesh.submeshes[i];
-                glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
+                SetSubmeshUniforms(submesh);
+                u32 offset = submesh.firstIndex * GetIndexSize(submesh.indexType);
+                glDrawElementsBaseVertex(GL_TRIANGLES, submesh.indexCount, submesh.indexType, (void*)(u64)offset, submesh.baseVertex);
             }
 
             glCullFace(GL_BACK);
@@ -1468,5 +1649,8 @@ void Render(App* app)
 
         default:;
     }
+
+    // After every copy out of the staging ring this frame
+    FenceStagingFrame();
 }
 
@@ -23,18 +23,45 @@ struct Image
     i32   stride;
 };
 
+enum TextureUsage
+{
+    TextureUsage_Color,   // Albedo, emissive... BC1, or BC3 if there is any alpha
+    TextureUsage_Normals, // Tangent space normal maps, BC5 (the shaders rebuild Z)
+    TextureUsage_Mask,    // Single channel data such as specular, BC4
+};
+
+struct TextureLevel
+{
+    ivec2 size;
+    u32   offset;   // Bytes from the start of the texture data
+    u32   dataSize;
+};
+
+// A texture with its whole mip chain block compressed, ready for glCompressedTexSubImage2D
+struct CookedTexture
+{
+    GLenum                    internalFormat;
+    std::vector<TextureLevel> levels;
+    std::vector<u8>           data;
+};
+
 struct Texture
 {
     GLuint      handle;
     std::string filepath;
+    bool        isPlaceholder = false; // Borrowing another texture's handle while it streams in
+    TextureUsage usage = TextureUsage_Color;
+    u64         lastWriteTimestamp = 0; // Of the file it was cooked from, for hot reloads
 };
 
 //VBO
 struct VertexBufferAttribute
 {
-    u8 location;
-    u8 componentCount;
-    u8 offset;
+    u8     location;
+    u8     componentCount;
+    u8     offset;
+    u8     normalized = GL_FALSE; // Integer components are read as [0,1] / [-1,1]
+    GLenum type       = GL_FLOAT;
 };
 
 struct VertexBufferLayout
@@ -91,27 +118,91 @@ struct OpenGLInfo
 };
 
 //Models & Materials
+
+// A node of the imported scene graph, for models that keep it instead of baking the node
+// transforms into their vertices. A submesh referenced by several nodes is stored once and
+// drawn once per node.
+struct ModelNode
+{
+    mat4 localTransform;        // Relative to the parent node
+    mat4 modelTransform;        // Relative to the model, every parent applied
+    u32 parent;                 // UINT32_MAX for the roots, parents come before their children
+    std::vector<u32> submeshes; // Drawn with this node's transform
+};
+
 struct Model
 {
+    std::string name; // Source file, or the name of a generated mesh
+    u32 loadFlags;
+    u64 lastWriteTimestamp; // Newest of the source and its inputs, 0 for generated meshes
     u32 meshIdx;
     std::vector<u32> materialIdx;
+    std::vector<u32> materialSlots; // App material of each imported material, reused on reload
+    std::vector<ModelNode> nodes; // Empty when every submesh is drawn once, untransformed
+};
+
+// A cluster of neighbouring triangles of a submesh, laid out contiguously in its
+// indices so it can be culled and drawn on its own
+struct Meshlet
+{
+    vec3 center;      // Bounding sphere, in model space
+    f32  radius;
+    vec3 coneApex;    // Normal cone: the meshlet is backfacing when seen from inside it
+    vec3 coneAxis;
+    f32  coneCutoff;  // 1 when the normals are too spread to cull on
+    u32  indexOffset; // In indices from the start of the submesh indices
+    u32  indexCount;
+};
+
+// A range of the submesh indices drawing it at a lower level of detail
+struct SubmeshLod
+{
+    u32 indexOffset; // In indices from the start of the submesh indices
+    u32 indexCount;
+    f32 error;       // Largest distance to the full detail surface, in model units
+};
+
+// What a mesh keeps on the CPU once its geometry is uploaded. The counts, ranges,
+// meshlets, LODs and bounds the draws need are always kept.
+enum MeshResidency
+{
+    MeshResidency_Full,          // Interleaved vertices and every index, as imported
+    MeshResidency_PositionsOnly, // Decoded positions and the full detail indices (picking, physics)
+    MeshResidency_CountsOnly,    // Nothing else
+    MeshResidency_Count
 };
 
 struct Submesh
 {
     VertexBufferLayout vertexBufferLayout;
-    std::vector<float> vertices;
-    std::vector<u32> indices;
-    u32 vertexOffset;
+    std::vector<u8> vertices;       // Empty after upload unless the mesh is MeshResidency_Full
+    std::vector<u32> indices;       // Always 32-bit on the CPU, packed to indexType on upload
+    std::vector<vec3> positions;    // Only with MeshResidency_PositionsOnly
+    u32 indexCount;                 // Of the full detail indices, the LODs come after them
+    GLenum indexType = GL_UNSIGNED_INT;
+    vec3 positionScale; // Dequantization of packed positions: pos * scale + bias
+    vec3 positionBias;
+    u32 vertexOffset;               // Bytes into the vertex and index blobs of the model
     u32 indexOffset;
-    std::vector<Vao> vaos;
+    u32 vertexDataSize;             // Bytes of the submesh in the blobs, LOD indices included
+    u32 indexDataSize;
+    u32 positionOffset;             // Bytes into the position blob, the position-only copy of the vertices
+    u32 positionDataSize;
+    u32 geometryFormat = UINT32_MAX; // Vertex layout in the geometry heap, UINT32_MAX until uploaded
+    u32 baseVertex;                 // First vertex and index of the submesh in the geometry heap
+    u32 firstIndex;
+    u32 positionFormat = UINT32_MAX; // Same for the position stream, that position-only programs read
+    u32 positionBaseVertex;
+    std::vector<Meshlet> meshlets;
+    std::vector<SubmeshLod> lods;   // LOD 0 first, empty if the submesh has no LOD chain
+    vec3 boundsCenter;              // Bounding sphere, in model space
+    f32 boundsRadius;
 };
 
 struct Mesh
 {
     std::vector<Submesh> submeshes;
-    GLuint vertexBufferHandle;
-    GLuint indexBufferHandle;
+    MeshResidency residency = MeshResidency_CountsOnly;
 };
 
 struct Material
@@ -129,16 +220,19 @@ struct Material
 
 struct Entity
 {
-    std::string name;
     vec3 pos;
     vec3 rotAngle;
     vec3 scale;
     glm::mat4 worldMatrix = mat4(1.0f);
     u32 modelIdx;
 
+    // One block, or for models with nodes one per node with submeshes, in node order, each
+    // localParamsSize rounded up to the uniform block alignment after the previous one
     u32 localParamsOffset;
     u32 localParamsSize;
-    
+
+    Entity() = default;
+
     Entity(vec3 _pos, vec3 _rotAngle, vec3 _scale, u32 _modelIdx, u32 _localParamsOffset,u32 _localParamsSize)
     {
         pos = _pos;
@@ -186,6 +280,7 @@ struct Camera
     vec3 angles;
     vec3 target;
     f32  aspectRatio;
+    f32  fovY = 60.0f;
     f32  zNear = 0.01f;
     f32  zFar = 10000.0f;
 };
@@ -279,6 +374,20 @@ struct App
 
     bool isNormalMap = true;
 
+    // Meshlet culling in the geometry pass, and last frame's stats
+    bool meshletCulling = true;
+    u32 visibleMeshletCount;
+    u32 totalMeshletCount;
+
+    // Added to log2 of the on-screen error tolerated when picking LODs
+    f32 lodBias = 0.0f;
+
+    // VRAM the streamed texture mips may take, the finest levels are dropped above it
+    u32 textureMemoryBudgetMB = 64;
+
+    // Bytes the streaming may stage for upload per frame, across models and textures
+    u32 uploadBudgetKB = 4096;
+
     /*u32 colorAttachmentHandle;
     u32 normalAttachmentHandle;
     u32 albedoAttachmentHandle;
@@ -296,11 +405,55 @@ void Gui(App* app);
 
 void Update(App* app);
 
+/**
+ * Allocates the submeshes in the geometry heap and copies their part of the vertex, index
+ * and position blobs there. The blobs may be null to only allocate them.
+ */
+void UploadMeshBuffers(std::vector<Submesh>& submeshes, const u8* vertexData, const u8* indexData, const u8* positionData);
+
+/**
+ * Uploads a mesh to the geometry heap out of the CPU data of its submeshes.
+ */
+void UploadMesh(Mesh& mesh);
+
+/**
+ * VAO that feeds a program the geometry of a submesh. Programs that only read aPosition
+ * get the tightly packed position stream, so depth-only passes don't fetch the rest of
+ * the vertex. Draw it with GetSubmeshBaseVertex for the same program.
+ */
 GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program);
 
+u32 GetSubmeshBaseVertex(const Submesh& submesh, const Program& program);
+
 void Render(App* app);
 
-u32 LoadTexture2D(App* app, const char* filepath);
+u32 GetTextureLevelBlockRows(const CookedTexture& texture, u32 level);
+
+/**
+ * Uploads rows of 4x4 blocks of a level to the compressed texture bound to GL_TEXTURE_2D,
+ * whose storage starts at firstLevel of the cooked mip chain.
+ */
+void UploadCompressedTextureRows(const CookedTexture& texture, u32 level, u32 firstLevel, u32 firstBlockRow, u32 blockRowCount);
+
+/**
+ * Creates an immutable texture with the format of a cooked texture and its mip chain from
+ * firstLevel down, and uploads those levels unless uploadLevels is false.
+ */
+GLuint CreateCompressedTexture2D(const CookedTexture& texture, u32 firstLevel, bool uploadLevels);
+
+/**
+ * Adds a texture that is already cooked and uploads its coarse levels, taking the cooked
+ * data for the finer ones to stream in. Returns its index.
+ */
+u32 AddTexture2D(App* app, const std::string& filepath, TextureUsage usage, CookedTexture& cooked);
+
+u32 LoadTexture2D(App* app, const char* filepath, TextureUsage usage = TextureUsage_Color);
+
+/**
+ * Loads several textures at once, cooking them in parallel. Fills the index of each one,
+ * or UINT32_MAX for empty paths and files that fail to load.
+ */
+void LoadTextures2D(App* app, const std::vector<std::string>& filepaths, const std::vector<TextureUsage>& usages, std::vector<u32>& texIndices);
 
 constexpr vec3 GetAttenuation(u32 range);
 
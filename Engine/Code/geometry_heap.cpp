@@ -0,0 +1,441 @@
+#include "geometry_heap.h"
+#include "buffer_management.h"
+#include "mesh_processing.h"
+#include "staging_ring.h"
+#include "vertex_interleave.h"
+
+#include <algorithm>
+
+// The vertex buffer of one layout, allocated in vertices of layout.stride so every
+// range starts on a whole vertex and can be reached with a base vertex
+struct GeometryFormat
+{
+    VertexBufferLayout layout;
+    GLuint             vertexBufferHandle;
+    RangeAllocator     vertices;
+    std::vector<Vao>   vaos;
+};
+
+struct GeometryHeap
+{
+    std::vector<GeometryFormat> formats;
+    GLuint                      indexBufferHandle;
+    RangeAllocator              indices;      // In 4-byte words, 16 and 32-bit submeshes share it
+    u32                         submeshCount; // Holding ranges, streaming ones included
+};
+
+static GeometryHeap GlobalGeometryHeap;
+
+void InitRangeAllocator(RangeAllocator& allocator, u32 capacity)
+{
+    allocator.capacity = capacity;
+    allocator.usedCount = 0;
+    allocator.freeRanges.clear();
+    if (capacity > 0)
+        allocator.freeRanges.push_back(GeometryRange{ 0, capacity });
+}
+
+u32 AllocateRange(RangeAllocator& allocator, u32 count)
+{
+    for (u32 i = 0; i < allocator.freeRanges.size(); ++i)
+    {
+        GeometryRange& range = allocator.freeRanges[i];
+        if (range.count < count)
+            continue;
+
+        const u32 offset = range.offset;
+        range.offset += count;
+        range.count -= count;
+        if (range.count == 0)
+            allocator.freeRanges.erase(allocator.freeRanges.begin() + i);
+
+        allocator.usedCount += count;
+        return offset;
+    }
+
+    return UINT32_MAX;
+}
+
+void FreeRange(RangeAllocator& allocator, u32 offset, u32 count)
+{
+    if (count == 0)
+        return;
+
+    ASSERT(allocator.usedCount >= count, "Freeing more than was allocated");
+    allocator.usedCount -= count;
+
+    std::vector<GeometryRange>& ranges = allocator.freeRanges;
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), offset,
+                                 [](const GeometryRange& range, u32 value) { return range.offset < value; });
+
+    // Merge with the free neighbours so fragmentation doesn't build up
+    const bool mergesPrevious = next != ranges.begin() && (next - 1)->offset + (next - 1)->count == offset;
+    const bool mergesNext = next != ranges.end() && offset + count == next->offset;
+
+    if (mergesPrevious && mergesNext)
+    {
+        (next - 1)->count += count + next->count;
+        ranges.erase(next);
+    }
+    else if (mergesPrevious)
+    {
+        (next - 1)->count += count;
+    }
+    else if (mergesNext)
+    {
+        next->offset = offset;
+        next->count += count;
+    }
+    else
+    {
+        ranges.insert(next, GeometryRange{ offset, count });
+    }
+}
+
+void GrowRangeAllocator(RangeAllocator& allocator, u32 capacity)
+{
+    ASSERT(capacity >= allocator.capacity, "Range allocators only grow");
+
+    const u32 oldCapacity = allocator.capacity;
+    allocator.capacity = capacity;
+
+    // Freeing the new space merges it with a trailing free range, if there is one
+    allocator.usedCount += capacity - oldCapacity;
+    FreeRange(allocator, oldCapacity, capacity - oldCapacity);
+}
+
+static void DeleteFormatVAOs(GeometryFormat& format)
+{
+    for (const Vao& vao : format.vaos)
+        glDeleteVertexArrays(1, &vao.handle);
+    format.vaos.clear();
+}
+
+// New buffer holding the first copySize bytes of the old one, which is deleted
+static GLuint ReallocateGeometryBuffer(GLuint oldHandle, u64 copySize, u64 newSize)
+{
+    GLuint handle = 0;
+    glGenBuffers(1, &handle);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+
+    if (oldHandle != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, oldHandle);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copySize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &oldHandle);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return handle;
+}
+
+static u32 FindGeometryFormat(const VertexBufferLayout& layout)
+{
+    std::vector<GeometryFormat>& formats = GlobalGeometryHeap.formats;
+    for (u32 i = 0; i < formats.size(); ++i)
+        if (AreLayoutsEqual(formats[i].layout, layout))
+            return i;
+
+    formats.push_back(GeometryFormat{});
+    GeometryFormat& format = formats.back();
+    format.layout = layout;
+    InitRangeAllocator(format.vertices, GEOMETRY_HEAP_INITIAL_VERTEX_COUNT);
+    format.vertexBufferHandle = ReallocateGeometryBuffer(0, 0, (u64)GEOMETRY_HEAP_INITIAL_VERTEX_COUNT * layout.stride);
+
+    return formats.size() - 1;
+}
+
+// Doubles the buffer (or more, for a large request) until count units fit
+static u32 GrowAndAllocate(RangeAllocator& allocator, u32 count, u32 unitSize, GLuint& bufferHandle)
+{
+    u32 offset = AllocateRange(allocator, count);
+    if (offset != UINT32_MAX)
+        return offset;
+
+    const u32 oldCapacity = allocator.capacity;
+    const u32 newCapacity = glm::max(oldCapacity * 2, oldCapacity + count);
+    bufferHandle = ReallocateGeometryBuffer(bufferHandle, (u64)oldCapacity * unitSize, (u64)newCapacity * unitSize);
+    GrowRangeAllocator(allocator, newCapacity);
+
+    ILOG("Geometry heap grown to %.1f MB", (u64)newCapacity * unitSize / (1024.0f * 1024.0f));
+
+    offset = AllocateRange(allocator, count);
+    ASSERT(offset != UINT32_MAX, "Geometry heap growth was not enough");
+    return offset;
+}
+
+static u32 GetSubmeshIndexWordCount(const Submesh& submesh)
+{
+    return Align(submesh.indexDataSize, sizeof(u32)) / sizeof(u32);
+}
+
+static u32 GetSubmeshFirstIndexWord(const Submesh& submesh)
+{
+    return submesh.firstIndex * GetIndexSize(submesh.indexType) / sizeof(u32);
+}
+
+void AllocateSubmeshGeometry(Submesh& submesh)
+{
+    GeometryHeap& heap = GlobalGeometryHeap;
+
+    if (heap.indexBufferHandle == 0)
+    {
+        InitRangeAllocator(heap.indices, GEOMETRY_HEAP_INITIAL_INDEX_WORDS);
+        heap.indexBufferHandle = ReallocateGeometryBuffer(0, 0, (u64)GEOMETRY_HEAP_INITIAL_INDEX_WORDS * sizeof(u32));
+    }
+
+    submesh.geometryFormat = FindGeometryFormat(submesh.vertexBufferLayout);
+    GeometryFormat& format = heap.formats[submesh.geometryFormat];
+
+    const GLuint vertexBufferHandle = format.vertexBufferHandle;
+    const u32 vertexCount = submesh.vertexDataSize / submesh.vertexBufferLayout.stride;
+    submesh.baseVertex = GrowAndAllocate(format.vertices, vertexCount, format.layout.stride, format.vertexBufferHandle);
+    if (format.vertexBufferHandle != vertexBufferHandle)
+        DeleteFormatVAOs(format);
+
+    // The position stream is one more format, shared by every layout with the same positions
+    if (submesh.positionDataSize > 0)
+    {
+        submesh.positionFormat = FindGeometryFormat(MakePositionStreamLayout(submesh.vertexBufferLayout));
+        GeometryFormat& positionFormat = heap.formats[submesh.positionFormat];
+
+        const GLuint positionBufferHandle = positionFormat.vertexBufferHandle;
+        submesh.positionBaseVertex = GrowAndAllocate(positionFormat.vertices, vertexCount, positionFormat.layout.stride, positionFormat.vertexBufferHandle);
+        if (positionFormat.vertexBufferHandle != positionBufferHandle)
+            DeleteFormatVAOs(positionFormat);
+    }
+
+    // Every VAO of every format points at the index buffer
+    const GLuint indexBufferHandle = heap.indexBufferHandle;
+    const u32 indexWord = GrowAndAllocate(heap.indices, GetSubmeshIndexWordCount(submesh), sizeof(u32), heap.indexBufferHandle);
+    submesh.firstIndex = indexWord * sizeof(u32) / GetIndexSize(submesh.indexType);
+    if (heap.indexBufferHandle != indexBufferHandle)
+        for (GeometryFormat& anyFormat : heap.formats)
+            DeleteFormatVAOs(anyFormat);
+
+    heap.submeshCount++;
+}
+
+void FreeSubmeshGeometry(Submesh& submesh)
+{
+    if (submesh.geometryFormat == UINT32_MAX)
+        return;
+
+    GeometryHeap& heap = GlobalGeometryHeap;
+    GeometryFormat& format = heap.formats[submesh.geometryFormat];
+
+    FreeRange(format.vertices, submesh.baseVertex, submesh.vertexDataSize / format.layout.stride);
+    FreeRange(heap.indices, GetSubmeshFirstIndexWord(submesh), GetSubmeshIndexWordCount(submesh));
+
+    if (submesh.positionFormat != UINT32_MAX)
+    {
+        GeometryFormat& positionFormat = heap.formats[submesh.positionFormat];
+        FreeRange(positionFormat.vertices, submesh.positionBaseVertex, submesh.positionDataSize / positionFormat.layout.stride);
+    }
+
+    submesh.geometryFormat = UINT32_MAX;
+    submesh.positionFormat = UINT32_MAX;
+    heap.submeshCount--;
+}
+
+static void WriteGeometryBuffer(GLuint handle, u64 offset, u32 size, const void* data)
+{
+    // The copy target leaves the GL_ELEMENT_ARRAY_BUFFER binding of the current VAO alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+
+    // Through the staging ring when it has room, straight from data otherwise
+    const u32 stagingOffset = WriteStagingData(data, size);
+    if (stagingOffset != UINT32_MAX)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, GetStagingBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, stagingOffset, offset, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    else
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void UploadSubmeshVertices(const Submesh& submesh, u32 offset, u32 size, const void* data)
+{
+    ASSERT(offset + size <= submesh.vertexDataSize, "Vertex upload out of the submesh range");
+
+    const GeometryFormat& format = GlobalGeometryHeap.formats[submesh.geometryFormat];
+    WriteGeometryBuffer(format.vertexBufferHandle, (u64)submesh.baseVertex * format.layout.stride + offset, size, data);
+}
+
+void UploadSubmeshPositions(const Submesh& submesh, u32 offset, u32 size, const void* data)
+{
+    ASSERT(offset + size <= submesh.positionDataSize, "Position upload out of the submesh range");
+
+    const GeometryFormat& format = GlobalGeometryHeap.formats[submesh.positionFormat];
+    WriteGeometryBuffer(format.vertexBufferHandle, (u64)submesh.positionBaseVertex * format.layout.stride + offset, size, data);
+}
+
+void UploadSubmeshIndices(const Submesh& submesh, u32 offset, u32 size, const void* data)
+{
+    ASSERT(offset + size <= submesh.indexDataSize, "Index upload out of the submesh range");
+
+    const u64 firstIndexOffset = (u64)submesh.firstIndex * GetIndexSize(submesh.indexType);
+    WriteGeometryBuffer(GlobalGeometryHeap.indexBufferHandle, firstIndexOffset + offset, size, data);
+}
+
+GLuint FindGeometryVAO(u32 geometryFormat, const Program& program)
+{
+    GeometryFormat& format = GlobalGeometryHeap.formats[geometryFormat];
+
+    for (u32 i = 0; i < (u32)format.vaos.size(); ++i)
+    {
+        if (format.vaos[i].programHandle == program.handle)
+            return format.vaos[i].handle;
+    }
+
+    GLuint vaoHandle = 0;
+
+    glGenVertexArrays(1, &vaoHandle);
+    glBindVertexArray(vaoHandle);
+
+    glBindBuffer(GL_ARRAY_BUFFER, format.vertexBufferHandle);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GlobalGeometryHeap.indexBufferHandle);
+
+    // The attributes start at the beginning of the buffer, the base vertex of each draw
+    // picks the submesh
+    for (u32 i = 0; i < program.vertexInputLayout.attributes.size(); ++i)
+    {
+        bool attributeWasLinked = false;
+
+        for (u32 j = 0; j < format.layout.attributes.size(); ++j)
+        {
+            const VertexBufferAttribute& attribute = format.layout.attributes[j];
+            if (program.vertexInputLayout.attributes[i].location == attribute.location)
+            {
+                glVertexAttribPointer(attribute.location, attribute.componentCount, attribute.type, attribute.normalized,
+                                      format.layout.stride, (void*)(u64)attribute.offset);
+                glEnableVertexAttribArray(attribute.location);
+
+                attributeWasLinked = true;
+                break;
+            }
+        }
+
+        assert(attributeWasLinked);
+    }
+
+    glBindVertexArray(0);
+
+    Vao vao = { vaoHandle, program.handle };
+    format.vaos.push_back(vao);
+
+    return vaoHandle;
+}
+
+// A submesh range in the vertex buffer of a format, moved by the compaction
+struct GeometryVertexRange
+{
+    u32* baseVertex;
+    u32  dataSize;
+};
+
+bool CompactGeometryHeap(App* app)
+{
+    GeometryHeap& heap = GlobalGeometryHeap;
+
+    std::vector<Submesh*> submeshes;
+    for (Mesh& mesh : app->meshes)
+        for (Submesh& submesh : mesh.submeshes)
+            if (submesh.geometryFormat != UINT32_MAX)
+                submeshes.push_back(&submesh);
+
+    if (submeshes.size() != heap.submeshCount)
+        return false;
+
+    u64 usedBefore, capacity;
+    GetGeometryHeapUsage(usedBefore, capacity);
+
+    // Ranges are packed in their current order, into fresh buffers of the same size
+    for (u32 formatIdx = 0; formatIdx < heap.formats.size(); ++formatIdx)
+    {
+        GeometryFormat& format = heap.formats[formatIdx];
+        const u32 stride = format.layout.stride;
+
+        // Interleaved vertices and position streams alike, a format may hold either
+        std::vector<GeometryVertexRange> ranges;
+        for (Submesh* submesh : submeshes)
+        {
+            if (submesh->geometryFormat == formatIdx)
+                ranges.push_back(GeometryVertexRange{ &submesh->baseVertex, submesh->vertexDataSize });
+            if (submesh->positionFormat == formatIdx)
+                ranges.push_back(GeometryVertexRange{ &submesh->positionBaseVertex, submesh->positionDataSize });
+        }
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const GeometryVertexRange& a, const GeometryVertexRange& b) { return *a.baseVertex < *b.baseVertex; });
+
+        GLuint handle = ReallocateGeometryBuffer(0, 0, (u64)format.vertices.capacity * stride);
+        glBindBuffer(GL_COPY_READ_BUFFER, format.vertexBufferHandle);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+
+        u32 vertexCount = 0;
+        for (const GeometryVertexRange& range : ranges)
+        {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (u64)*range.baseVertex * stride,
+                                (u64)vertexCount * stride, range.dataSize);
+            *range.baseVertex = vertexCount;
+            vertexCount += range.dataSize / stride;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &format.vertexBufferHandle);
+        format.vertexBufferHandle = handle;
+
+        InitRangeAllocator(format.vertices, format.vertices.capacity);
+        AllocateRange(format.vertices, vertexCount);
+        DeleteFormatVAOs(format);
+    }
+
+    std::sort(submeshes.begin(), submeshes.end(),
+              [](const Submesh* a, const Submesh* b) { return GetSubmeshFirstIndexWord(*a) < GetSubmeshFirstIndexWord(*b); });
+
+    GLuint handle = ReallocateGeometryBuffer(0, 0, (u64)heap.indices.capacity * sizeof(u32));
+    glBindBuffer(GL_COPY_READ_BUFFER, heap.indexBufferHandle);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+
+    u32 indexWordCount = 0;
+    for (Submesh* submesh : submeshes)
+    {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (u64)GetSubmeshFirstIndexWord(*submesh) * sizeof(u32),
+                            (u64)indexWordCount * sizeof(u32), submesh->indexDataSize);
+        submesh->firstIndex = indexWordCount * sizeof(u32) / GetIndexSize(submesh->indexType);
+        indexWordCount += GetSubmeshIndexWordCount(*submesh);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &heap.indexBufferHandle);
+    heap.indexBufferHandle = handle;
+
+    InitRangeAllocator(heap.indices, heap.indices.capacity);
+    AllocateRange(heap.indices, indexWordCount);
+
+    ILOG("Geometry heap compacted, %.1f MB in use", usedBefore / (1024.0f * 1024.0f));
+    return true;
+}
+
+void GetGeometryHeapUsage(u64& usedBytes, u64& capacityBytes)
+{
+    const GeometryHeap& heap = GlobalGeometryHeap;
+
+    usedBytes = (u64)heap.indices.usedCount * sizeof(u32);
+    capacityBytes = (u64)heap.indices.capacity * sizeof(u32);
+
+    for (const GeometryFormat& format : heap.formats)
+    {
+        usedBytes += (u64)format.vertices.usedCount * format.layout.stride;
+        capacityBytes += (u64)format.vertices.capacity * format.layout.stride;
+    }
+}
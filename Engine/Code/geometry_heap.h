@@ -0,0 +1,81 @@
+//
+// geometry_heap.h: Shared GPU buffers for the geometry of every mesh. Each vertex layout
+// gets one large vertex buffer, all of them share one index buffer, and every submesh is a
+// range sub-allocated from them and drawn with glDrawElementsBaseVertex, so all the
+// submeshes of a layout are drawn through the same VAO.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define GEOMETRY_HEAP_INITIAL_VERTEX_COUNT (256 * 1024)  // Per vertex layout
+#define GEOMETRY_HEAP_INITIAL_INDEX_WORDS  (1024 * 1024) // 4 MB, shared by every layout
+
+struct GeometryRange
+{
+    u32 offset;
+    u32 count;
+};
+
+// First fit free list over [0, capacity), in whatever unit its user picks. GL-free.
+struct RangeAllocator
+{
+    u32                        capacity;
+    u32                        usedCount;
+    std::vector<GeometryRange> freeRanges; // Sorted by offset, adjacent ranges are merged
+};
+
+void InitRangeAllocator(RangeAllocator& allocator, u32 capacity);
+
+/**
+ * Takes count units from the first free range large enough. Returns the offset of the
+ * range, or UINT32_MAX if none is.
+ */
+u32 AllocateRange(RangeAllocator& allocator, u32 count);
+
+void FreeRange(RangeAllocator& allocator, u32 offset, u32 count);
+
+/**
+ * Extends the allocator to a larger capacity, the new space joins the last free range.
+ */
+void GrowRangeAllocator(RangeAllocator& allocator, u32 capacity);
+
+/**
+ * Takes the vertex, index and position stream ranges of a submesh from the heap, growing
+ * its buffers if needed, and fills submesh.geometryFormat, baseVertex, firstIndex,
+ * positionFormat and positionBaseVertex. Its data sizes must be set, a positionDataSize
+ * of 0 leaves it without a position stream.
+ */
+void AllocateSubmeshGeometry(Submesh& submesh);
+
+/**
+ * Returns the ranges of a submesh to the heap so later submeshes can reuse them.
+ */
+void FreeSubmeshGeometry(Submesh& submesh);
+
+/**
+ * Writes size bytes of vertex or index data at offset bytes into the range of a submesh.
+ * Partial writes let the streaming spread an upload over several frames.
+ */
+void UploadSubmeshVertices(const Submesh& submesh, u32 offset, u32 size, const void* data);
+void UploadSubmeshIndices(const Submesh& submesh, u32 offset, u32 size, const void* data);
+void UploadSubmeshPositions(const Submesh& submesh, u32 offset, u32 size, const void* data);
+
+/**
+ * VAO that feeds a program from the vertex buffer of a layout and the shared index buffer.
+ * VAOs are dropped whenever the buffers they point at are reallocated.
+ */
+GLuint FindGeometryVAO(u32 geometryFormat, const Program& program);
+
+/**
+ * Moves the submeshes of every mesh down to close the gaps left by freed ranges. Does
+ * nothing and returns false while a submesh is allocated but not yet in app->meshes, as
+ * happens during model streaming.
+ */
+bool CompactGeometryHeap(App* app);
+
+/**
+ * Bytes taken by submeshes and bytes allocated on the GPU, all buffers together.
+ */
+void GetGeometryHeapUsage(u64& usedBytes, u64& capacityBytes);
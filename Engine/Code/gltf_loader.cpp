@@ -0,0 +1,718 @@
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "vertex_interleave.h"
+#include "mesh_processing.h"
+#include "buffer_management.h"
+#include "text_parsing.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+enum JsonType
+{
+    Json_Null,
+    Json_Bool,
+    Json_Number,
+    Json_String,
+    Json_Array,
+    Json_Object,
+};
+
+// Just enough of a DOM for the glTF header, which is small next to the binary data
+struct JsonValue
+{
+    JsonType                 type = Json_Null;
+    f64                      number = 0.0;   // Also 0 or 1 for booleans
+    std::string              string;
+    std::vector<JsonValue>   elements;       // Array items, or object member values
+    std::vector<std::string> keys;           // Object member names, parallel to elements
+};
+
+static const JsonValue NullJsonValue;
+
+static const char* SkipJsonSpaces(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        ++p;
+    return p;
+}
+
+static void AppendUtf8(std::string& string, u32 codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        string += (char)codepoint;
+    }
+    else if (codepoint < 0x800)
+    {
+        string += (char)(0xC0 | (codepoint >> 6));
+        string += (char)(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        string += (char)(0xE0 | (codepoint >> 12));
+        string += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        string += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static const char* ParseJsonString(const char* p, const char* end, std::string& string)
+{
+    if (p >= end || *p != '"')
+        return nullptr;
+
+    for (++p; p < end && *p != '"'; ++p)
+    {
+        if (*p != '\\')
+        {
+            string += *p;
+            continue;
+        }
+
+        if (++p >= end)
+            return nullptr;
+
+        switch (*p)
+        {
+            case 'b': string += '\b'; break;
+            case 'f': string += '\f'; break;
+            case 'n': string += '\n'; break;
+            case 'r': string += '\r'; break;
+            case 't': string += '\t'; break;
+            case 'u':
+            {
+                if (end - p < 5)
+                    return nullptr;
+                char digits[5] = { p[1], p[2], p[3], p[4], '\0' };
+                AppendUtf8(string, (u32)strtoul(digits, nullptr, 16));
+                p += 4;
+                break;
+            }
+            default: string += *p; break;
+        }
+    }
+
+    return p < end ? p + 1 : nullptr;
+}
+
+// Returns the end of the value, or nullptr if the text isn't valid JSON
+static const char* ParseJsonValue(const char* p, const char* end, JsonValue& value, u32 depth)
+{
+    p = SkipJsonSpaces(p, end);
+    if (p >= end || depth > GLB_MAX_JSON_DEPTH)
+        return nullptr;
+
+    if (*p == '{' || *p == '[')
+    {
+        const bool isObject = *p == '{';
+        const char closing = isObject ? '}' : ']';
+        value.type = isObject ? Json_Object : Json_Array;
+
+        p = SkipJsonSpaces(p + 1, end);
+        if (p < end && *p == closing)
+            return p + 1;
+
+        while (p)
+        {
+            if (isObject)
+            {
+                value.keys.push_back(std::string());
+                p = ParseJsonString(SkipJsonSpaces(p, end), end, value.keys.back());
+                p = p ? SkipJsonSpaces(p, end) : nullptr;
+                if (!p || p >= end || *p != ':')
+                    return nullptr;
+                ++p;
+            }
+
+            value.elements.push_back(JsonValue());
+            p = ParseJsonValue(p, end, value.elements.back(), depth + 1);
+            p = p ? SkipJsonSpaces(p, end) : nullptr;
+            if (!p || p >= end)
+                return nullptr;
+            if (*p == closing)
+                return p + 1;
+            if (*p != ',')
+                return nullptr;
+            ++p;
+        }
+        return nullptr;
+    }
+
+    if (*p == '"')
+    {
+        value.type = Json_String;
+        return ParseJsonString(p, end, value.string);
+    }
+
+    if (end - p >= 4 && memcmp(p, "true", 4) == 0)
+    {
+        value.type = Json_Bool;
+        value.number = 1.0;
+        return p + 4;
+    }
+
+    if (end - p >= 5 && memcmp(p, "false", 5) == 0)
+    {
+        value.type = Json_Bool;
+        return p + 5;
+    }
+
+    if (end - p >= 4 && memcmp(p, "null", 4) == 0)
+        return p + 4;
+
+    // Bounded by the chunk, which may end anywhere in a truncated file
+    value.type = Json_Number;
+    const char* numberEnd = ParseDecimal(p, end, value.number);
+    return numberEnd != p ? numberEnd : nullptr;
+}
+
+static const JsonValue& GetJsonMember(const JsonValue& object, const char* key)
+{
+    for (u32 i = 0; i < object.keys.size(); ++i)
+        if (object.keys[i] == key)
+            return object.elements[i];
+    return NullJsonValue;
+}
+
+static const JsonValue& GetJsonElement(const JsonValue& array, u32 index)
+{
+    return index < array.elements.size() ? array.elements[index] : NullJsonValue;
+}
+
+static f64 GetJsonNumber(const JsonValue& value, f64 defaultValue)
+{
+    return value.type == Json_Number ? value.number : defaultValue;
+}
+
+static u32 GetJsonIndex(const JsonValue& value)
+{
+    return value.type == Json_Number && value.number >= 0.0 ? (u32)value.number : UINT32_MAX;
+}
+
+// Contents of the GLB and the external buffers it may reference, all mapped
+struct GlbFile
+{
+    JsonValue               root;
+    std::vector<const u8*>  buffers;
+    std::vector<u64>        bufferSizes;
+    std::vector<MappedFile> externalFiles;
+};
+
+// An accessor resolved to where its elements live in a mapped buffer
+struct GlbAccessor
+{
+    const u8* data;
+    u32       count;
+    u32       stride;
+    GLenum    componentType; // glTF uses the GL enums
+    u32       componentCount;
+    bool      normalized;
+};
+
+struct GlbMeshInstance
+{
+    u32  meshIdx;
+    mat4 transform;
+};
+
+struct GlbPrimitive
+{
+    const JsonValue* primitive;
+    const mat4*      transform;
+};
+
+static u32 GetComponentSize(GLenum componentType)
+{
+    switch (componentType)
+    {
+        case GL_BYTE: case GL_UNSIGNED_BYTE:   return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT: case GL_FLOAT:   return 4;
+        default:                               return 0;
+    }
+}
+
+static u32 GetAccessorComponentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2")   return 2;
+    if (type == "VEC3")   return 3;
+    if (type == "VEC4")   return 4;
+    return 0;
+}
+
+static bool GetGlbAccessor(const GlbFile& glb, u32 accessorIdx, GlbAccessor& accessor)
+{
+    const JsonValue& json = GetJsonElement(GetJsonMember(glb.root, "accessors"), accessorIdx);
+    const JsonValue& view = GetJsonElement(GetJsonMember(glb.root, "bufferViews"), GetJsonIndex(GetJsonMember(json, "bufferView")));
+    const u32 bufferIdx = GetJsonIndex(GetJsonMember(view, "buffer"));
+
+    // Accessors without a view are all zeros, and sparse ones patch their view: both are
+    // left to Assimp
+    if (view.type != Json_Object || bufferIdx >= glb.buffers.size() || GetJsonMember(json, "sparse").type != Json_Null)
+        return false;
+
+    accessor.componentType = (GLenum)GetJsonNumber(GetJsonMember(json, "componentType"), 0.0);
+    accessor.componentCount = GetAccessorComponentCount(GetJsonMember(json, "type").string);
+    accessor.count = (u32)GetJsonNumber(GetJsonMember(json, "count"), 0.0);
+    accessor.normalized = GetJsonNumber(GetJsonMember(json, "normalized"), 0.0) != 0.0;
+
+    const u32 elementSize = GetComponentSize(accessor.componentType) * accessor.componentCount;
+    const u64 viewOffset = (u64)GetJsonNumber(GetJsonMember(view, "byteOffset"), 0.0);
+    const u64 viewLength = (u64)GetJsonNumber(GetJsonMember(view, "byteLength"), 0.0);
+    const u64 accessorOffset = (u64)GetJsonNumber(GetJsonMember(json, "byteOffset"), 0.0);
+    accessor.stride = (u32)GetJsonNumber(GetJsonMember(view, "byteStride"), elementSize);
+
+    if (elementSize == 0 || accessor.count == 0 || viewOffset + viewLength > glb.bufferSizes[bufferIdx] ||
+        accessorOffset + (u64)accessor.stride * (accessor.count - 1) + elementSize > viewLength)
+        return false;
+
+    accessor.data = glb.buffers[bufferIdx] + viewOffset + accessorOffset;
+    return true;
+}
+
+static f32 ReadComponent(const u8* src, GLenum componentType, bool normalized)
+{
+    switch (componentType)
+    {
+        case GL_BYTE:           { i8 c;  memcpy(&c, src, 1); return normalized ? glm::max(c / 127.0f, -1.0f) : (f32)c; }
+        case GL_UNSIGNED_BYTE:  { u8 c;  memcpy(&c, src, 1); return normalized ? c / 255.0f : (f32)c; }
+        case GL_SHORT:          { i16 c; memcpy(&c, src, 2); return normalized ? glm::max(c / 32767.0f, -1.0f) : (f32)c; }
+        case GL_UNSIGNED_SHORT: { u16 c; memcpy(&c, src, 2); return normalized ? c / 65535.0f : (f32)c; }
+        case GL_UNSIGNED_INT:   { u32 c; memcpy(&c, src, 4); return (f32)c; }
+        case GL_FLOAT:          { f32 c; memcpy(&c, src, 4); return c; }
+        default:                return 0.0f;
+    }
+}
+
+// Elements as vec4s, missing components are 0
+static void ReadAccessor(const GlbAccessor& accessor, std::vector<vec4>& values)
+{
+    const u32 componentSize = GetComponentSize(accessor.componentType);
+    values.assign(accessor.count, vec4(0.0f));
+    for (u32 i = 0; i < accessor.count; ++i)
+    {
+        const u8* src = accessor.data + (u64)i * accessor.stride;
+        for (u32 j = 0; j < accessor.componentCount; ++j)
+            values[i][j] = ReadComponent(src + j * componentSize, accessor.componentType, accessor.normalized);
+    }
+}
+
+// The element array itself when the vertex packer can read it as it is
+static const vec3* GetPackedVec3Array(const GlbAccessor& accessor)
+{
+    const bool packed = accessor.componentType == GL_FLOAT && accessor.componentCount == 3 &&
+                        accessor.stride == sizeof(vec3) && ((u64)accessor.data & 3) == 0;
+    return packed ? (const vec3*)accessor.data : nullptr;
+}
+
+static bool ReadAccessorIndices(const GlbAccessor& accessor, std::vector<u32>& indices)
+{
+    if (accessor.componentCount != 1 || (accessor.componentType != GL_UNSIGNED_BYTE &&
+        accessor.componentType != GL_UNSIGNED_SHORT && accessor.componentType != GL_UNSIGNED_INT))
+        return false;
+
+    indices.resize(accessor.count);
+    for (u32 i = 0; i < accessor.count; ++i)
+    {
+        const u8* src = accessor.data + (u64)i * accessor.stride;
+        if (accessor.componentType == GL_UNSIGNED_BYTE)
+            indices[i] = *src;
+        else if (accessor.componentType == GL_UNSIGNED_SHORT)
+            indices[i] = (u32)src[0] | ((u32)src[1] << 8);
+        else
+            memcpy(&indices[i], src, sizeof(u32));
+    }
+    return true;
+}
+
+static mat4 GetNodeLocalTransform(const JsonValue& node)
+{
+    const JsonValue& matrix = GetJsonMember(node, "matrix");
+    if (matrix.elements.size() == 16)
+    {
+        mat4 transform;
+        for (u32 i = 0; i < 16; ++i)
+            transform[i / 4][i % 4] = (f32)matrix.elements[i].number;
+        return transform;
+    }
+
+    const JsonValue& t = GetJsonMember(node, "translation");
+    const JsonValue& r = GetJsonMember(node, "rotation");
+    const JsonValue& s = GetJsonMember(node, "scale");
+    const vec3 translation = t.elements.size() == 3 ? vec3(t.elements[0].number, t.elements[1].number, t.elements[2].number) : vec3(0.0f);
+    const glm::quat rotation = r.elements.size() == 4 ? glm::quat((f32)r.elements[3].number, (f32)r.elements[0].number, (f32)r.elements[1].number, (f32)r.elements[2].number) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    const vec3 scale = s.elements.size() == 3 ? vec3(s.elements[0].number, s.elements[1].number, s.elements[2].number) : vec3(1.0f);
+    return glm::translate(translation) * glm::mat4_cast(rotation) * glm::scale(scale);
+}
+
+static void GatherGlbMeshInstances(const GlbFile& glb, u32 nodeIdx, const mat4& parentTransform, u32 depth, std::vector<GlbMeshInstance>& instances)
+{
+    const JsonValue& node = GetJsonElement(GetJsonMember(glb.root, "nodes"), nodeIdx);
+    if (node.type != Json_Object || depth > GLB_MAX_JSON_DEPTH)
+        return;
+
+    const mat4 transform = parentTransform * GetNodeLocalTransform(node);
+    const u32 meshIdx = GetJsonIndex(GetJsonMember(node, "mesh"));
+    if (meshIdx != UINT32_MAX)
+        instances.push_back(GlbMeshInstance{ meshIdx, transform });
+
+    for (const JsonValue& child : GetJsonMember(node, "children").elements)
+        GatherGlbMeshInstances(glb, GetJsonIndex(child), transform, depth + 1, instances);
+}
+
+// Depth first, so parents come before their children. The glTF mesh of every node, or
+// UINT32_MAX, goes to nodeMeshes.
+static void GatherGlbNodes(const GlbFile& glb, u32 nodeIdx, u32 parent, u32 depth, std::vector<ModelNode>& nodes, std::vector<u32>& nodeMeshes)
+{
+    const JsonValue& node = GetJsonElement(GetJsonMember(glb.root, "nodes"), nodeIdx);
+    if (node.type != Json_Object || depth > GLB_MAX_JSON_DEPTH)
+        return;
+
+    ModelNode modelNode;
+    modelNode.localTransform = GetNodeLocalTransform(node);
+    modelNode.modelTransform = parent == UINT32_MAX ? modelNode.localTransform : nodes[parent].modelTransform * modelNode.localTransform;
+    modelNode.parent = parent;
+    nodes.push_back(modelNode);
+    nodeMeshes.push_back(GetJsonIndex(GetJsonMember(node, "mesh")));
+
+    const u32 modelNodeIdx = (u32)nodes.size() - 1u;
+    for (const JsonValue& child : GetJsonMember(node, "children").elements)
+        GatherGlbNodes(glb, GetJsonIndex(child), modelNodeIdx, depth + 1, nodes, nodeMeshes);
+}
+
+static std::string GetGlbTexturePath(const GlbFile& glb, const JsonValue& textureInfo, const std::string& directory)
+{
+    const u32 textureIdx = GetJsonIndex(GetJsonMember(textureInfo, "index"));
+    if (textureIdx == UINT32_MAX)
+        return std::string();
+
+    const JsonValue& texture = GetJsonElement(GetJsonMember(glb.root, "textures"), textureIdx);
+    const JsonValue& image = GetJsonElement(GetJsonMember(glb.root, "images"), GetJsonIndex(GetJsonMember(texture, "source")));
+    const std::string& uri = GetJsonMember(image, "uri").string;
+
+    // Images stored in the GLB itself can't go through the texture cooker, which works on files
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+    {
+        ELOG("Embedded glTF image %u is not supported, the material slot is left empty", textureIdx);
+        return std::string();
+    }
+
+    return directory + "/" + uri;
+}
+
+static void ProcessGlbMaterial(const GlbFile& glb, const JsonValue& json, ImportedMaterial& material, const std::string& directory)
+{
+    const JsonValue& pbr = GetJsonMember(json, "pbrMetallicRoughness");
+    const JsonValue& baseColor = GetJsonMember(pbr, "baseColorFactor");
+    const JsonValue& emissive = GetJsonMember(json, "emissiveFactor");
+
+    material.name = GetJsonMember(json, "name").string;
+    material.albedo = baseColor.elements.size() >= 3 ? vec3(baseColor.elements[0].number, baseColor.elements[1].number, baseColor.elements[2].number) : vec3(1.0f);
+    material.emissive = emissive.elements.size() == 3 ? vec3(emissive.elements[0].number, emissive.elements[1].number, emissive.elements[2].number) : vec3(0.0f);
+    material.smoothness = 1.0f - (f32)GetJsonNumber(GetJsonMember(pbr, "roughnessFactor"), 1.0);
+
+    material.albedoTexture = GetGlbTexturePath(glb, GetJsonMember(pbr, "baseColorTexture"), directory);
+    material.emissiveTexture = GetGlbTexturePath(glb, GetJsonMember(json, "emissiveTexture"), directory);
+    material.normalsTexture = GetGlbTexturePath(glb, GetJsonMember(json, "normalTexture"), directory);
+}
+
+// Runs in the job system workers: it must only touch its own submesh
+static bool ProcessGlbPrimitive(const GlbFile& glb, const JsonValue& primitive, const mat4& transform, Submesh& submesh)
+{
+    const JsonValue& attributes = GetJsonMember(primitive, "attributes");
+
+    GlbAccessor positionAccessor;
+    if (!GetGlbAccessor(glb, GetJsonIndex(GetJsonMember(attributes, "POSITION")), positionAccessor) ||
+        positionAccessor.componentCount != 3)
+        return false;
+
+    const u32 vertexCount = positionAccessor.count;
+    const bool identity = transform == mat4(1.0f);
+    const glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+    const bool mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+
+    std::vector<u32> indices;
+    const u32 indicesIdx = GetJsonIndex(GetJsonMember(primitive, "indices"));
+    if (indicesIdx != UINT32_MAX)
+    {
+        GlbAccessor indexAccessor;
+        if (!GetGlbAccessor(glb, indicesIdx, indexAccessor) || !ReadAccessorIndices(indexAccessor, indices))
+            return false;
+    }
+    else
+    {
+        indices.resize(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+            indices[i] = i;
+    }
+
+    indices.resize(indices.size() - indices.size() % 3);
+    for (u32 i = 0; i < indices.size(); ++i)
+        if (indices[i] >= vertexCount)
+            return false;
+
+    // Mirroring transforms flip the winding, so it is flipped back
+    if (mirrored)
+        for (u32 i = 0; i < indices.size(); i += 3)
+            std::swap(indices[i + 1], indices[i + 2]);
+
+    std::vector<vec4> values;
+    std::vector<vec3> positions;
+    const vec3* positionData = identity ? GetPackedVec3Array(positionAccessor) : nullptr;
+    if (!positionData)
+    {
+        ReadAccessor(positionAccessor, values);
+        positions.resize(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+            positions[i] = vec3(transform * vec4(vec3(values[i]), 1.0f));
+        positionData = positions.data();
+    }
+
+    std::vector<vec3> normals;
+    const vec3* normalData = nullptr;
+    GlbAccessor normalAccessor;
+    if (GetGlbAccessor(glb, GetJsonIndex(GetJsonMember(attributes, "NORMAL")), normalAccessor) &&
+        normalAccessor.count == vertexCount && normalAccessor.componentCount == 3)
+    {
+        normalData = identity ? GetPackedVec3Array(normalAccessor) : nullptr;
+        if (!normalData)
+        {
+            ReadAccessor(normalAccessor, values);
+            normals.resize(vertexCount);
+            for (u32 i = 0; i < vertexCount; ++i)
+                normals[i] = glm::normalize(normalTransform * vec3(values[i]));
+            normalData = normals.data();
+        }
+    }
+    else
+    {
+        GenerateVertexNormals(vertexCount, positionData, indices.data(), indices.size(), normals);
+        normalData = normals.data();
+    }
+
+    // glTF puts the texture origin at the top left, the engine loads images bottom up
+    std::vector<vec3> texCoords;
+    GlbAccessor texCoordAccessor;
+    if (GetGlbAccessor(glb, GetJsonIndex(GetJsonMember(attributes, "TEXCOORD_0")), texCoordAccessor) &&
+        texCoordAccessor.count == vertexCount && texCoordAccessor.componentCount == 2)
+    {
+        ReadAccessor(texCoordAccessor, values);
+        texCoords.resize(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+            texCoords[i] = vec3(values[i].x, 1.0f - values[i].y, 0.0f);
+    }
+
+    // With V flipped, glTF bitangents point the way Assimp ones do, and get the same flip
+    std::vector<vec3> tangents;
+    std::vector<vec3> bitangents;
+    GlbAccessor tangentAccessor;
+    if (!texCoords.empty() && GetGlbAccessor(glb, GetJsonIndex(GetJsonMember(attributes, "TANGENT")), tangentAccessor) &&
+        tangentAccessor.count == vertexCount && tangentAccessor.componentCount == 4)
+    {
+        ReadAccessor(tangentAccessor, values);
+        tangents.resize(vertexCount);
+        bitangents.resize(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+        {
+            tangents[i] = glm::normalize(glm::mat3(transform) * vec3(values[i]));
+            bitangents[i] = glm::cross(normalData[i], tangents[i]) * (values[i].w < 0.0f ? -1.0f : 1.0f) * (mirrored ? -1.0f : 1.0f);
+        }
+    }
+    else if (!texCoords.empty())
+    {
+        GenerateTangentSpace(vertexCount, positionData, texCoords.data(), normalData, indices.data(), indices.size(), tangents, bitangents);
+    }
+
+    VertexStreams streams = {};
+    streams.vertexCount = vertexCount;
+    streams.positions = positionData;
+    streams.normals = normalData;
+    streams.texCoords = texCoords.empty() ? nullptr : texCoords.data();
+    streams.tangents = tangents.empty() ? nullptr : tangents.data();
+    streams.bitangents = bitangents.empty() ? nullptr : bitangents.data();
+    streams.flipBitangents = true;
+
+    BuildSubmeshVertices(streams, submesh);
+
+    submesh.indices.swap(indices);
+    submesh.indexCount = submesh.indices.size();
+    submesh.indexType = ChooseIndexType(vertexCount);
+    return true;
+}
+
+static bool OpenGlbFile(const MappedFile& file, const std::string& directory, GlbFile& glb)
+{
+    if (file.size < sizeof(GlbHeader) + sizeof(GlbChunkHeader))
+        return false;
+
+    const GlbHeader* header = (const GlbHeader*)file.data;
+    if (header->magic != GLB_MAGIC || header->version != GLB_VERSION || header->length > file.size)
+        return false;
+
+    // The JSON chunk comes first and the BIN chunk, if any, right after it
+    const u8* binData = nullptr;
+    u64 binSize = 0;
+    const char* jsonBegin = nullptr;
+    const char* jsonEnd = nullptr;
+    for (u64 offset = sizeof(GlbHeader); offset + sizeof(GlbChunkHeader) <= header->length; )
+    {
+        const GlbChunkHeader* chunk = (const GlbChunkHeader*)(file.data + offset);
+        const u64 dataOffset = offset + sizeof(GlbChunkHeader);
+        if (dataOffset + chunk->length > header->length)
+            return false;
+
+        if (chunk->type == GLB_CHUNK_JSON && !jsonBegin)
+        {
+            jsonBegin = (const char*)file.data + dataOffset;
+            jsonEnd = jsonBegin + chunk->length;
+        }
+        else if (chunk->type == GLB_CHUNK_BIN && !binData)
+        {
+            binData = file.data + dataOffset;
+            binSize = chunk->length;
+        }
+        offset = dataOffset + Align(chunk->length, 4);
+    }
+
+    if (!jsonBegin || !ParseJsonValue(jsonBegin, jsonEnd, glb.root, 0) || glb.root.type != Json_Object)
+        return false;
+
+    // Buffers without a URI are the BIN chunk, the others are files next to the GLB
+    for (const JsonValue& buffer : GetJsonMember(glb.root, "buffers").elements)
+    {
+        const std::string& uri = GetJsonMember(buffer, "uri").string;
+        if (uri.empty())
+        {
+            glb.buffers.push_back(binData);
+            glb.bufferSizes.push_back(binSize);
+        }
+        else if (uri.compare(0, 5, "data:") != 0)
+        {
+            glb.externalFiles.push_back(MapFile((directory + "/" + uri).c_str()));
+            if (!glb.externalFiles.back().data)
+                return false;
+            glb.buffers.push_back(glb.externalFiles.back().data);
+            glb.bufferSizes.push_back(glb.externalFiles.back().size);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ImportGlbSubmeshes(const char* filename, const std::string& directory, bool keepHierarchy, std::vector<Submesh>& submeshes,
+                        std::vector<u32>& submeshMaterials, std::vector<ImportedMaterial>& materials, std::vector<ModelNode>& nodes)
+{
+    MappedFile file = MapFile(filename);
+    if (!file.data)
+        return false;
+
+    GlbFile glb;
+    bool valid = OpenGlbFile(file, directory, glb);
+    if (!valid)
+        ELOG("Could not read %s as a GLB file", filename);
+
+    // With the hierarchy kept, every glTF mesh is imported once, untransformed, in order of
+    // first use, and the nodes draw it with their own transforms
+    const JsonValue& meshes = GetJsonMember(glb.root, "meshes");
+    std::vector<GlbMeshInstance> instances;
+    std::vector<u32> nodeMeshes;
+    std::vector<u32> meshInstances(meshes.elements.size(), UINT32_MAX);
+    if (valid)
+    {
+        const JsonValue& scenes = GetJsonMember(glb.root, "scenes");
+        const JsonValue& scene = GetJsonElement(scenes, (u32)GetJsonNumber(GetJsonMember(glb.root, "scene"), 0.0));
+        for (const JsonValue& node : GetJsonMember(scene, "nodes").elements)
+        {
+            if (keepHierarchy)
+                GatherGlbNodes(glb, GetJsonIndex(node), UINT32_MAX, 0, nodes, nodeMeshes);
+            else
+                GatherGlbMeshInstances(glb, GetJsonIndex(node), mat4(1.0f), 0, instances);
+        }
+
+        for (u32 meshIdx : nodeMeshes)
+        {
+            if (meshIdx < meshInstances.size() && meshInstances[meshIdx] == UINT32_MAX)
+            {
+                meshInstances[meshIdx] = (u32)instances.size();
+                instances.push_back(GlbMeshInstance{ meshIdx, mat4(1.0f) });
+            }
+        }
+    }
+
+    // Only triangle lists are imported, as SortByPType would keep them apart anyway
+    std::vector<GlbPrimitive> primitives;
+    std::vector<u32> instanceFirstPrimitives(instances.size() + 1, 0);
+    for (u32 instanceIdx = 0; instanceIdx < instances.size(); ++instanceIdx)
+    {
+        const GlbMeshInstance& instance = instances[instanceIdx];
+        for (const JsonValue& primitive : GetJsonMember(GetJsonElement(meshes, instance.meshIdx), "primitives").elements)
+        {
+            if (GetJsonNumber(GetJsonMember(primitive, "mode"), 4.0) == 4.0)
+                primitives.push_back(GlbPrimitive{ &primitive, &instance.transform });
+            else
+                ILOG("%s: skipping a primitive that isn't a triangle list", filename);
+        }
+        instanceFirstPrimitives[instanceIdx + 1] = (u32)primitives.size();
+    }
+
+    for (u32 nodeIdx = 0; nodeIdx < nodes.size(); ++nodeIdx)
+    {
+        const u32 meshIdx = nodeMeshes[nodeIdx];
+        if (meshIdx >= meshInstances.size())
+            continue;
+        for (u32 i = instanceFirstPrimitives[meshInstances[meshIdx]]; i < instanceFirstPrimitives[meshInstances[meshIdx] + 1]; ++i)
+            nodes[nodeIdx].submeshes.push_back(i);
+    }
+
+    const JsonValue& jsonMaterials = GetJsonMember(glb.root, "materials");
+    materials.resize(jsonMaterials.elements.size());
+    for (u32 i = 0; i < materials.size(); ++i)
+        ProcessGlbMaterial(glb, jsonMaterials.elements[i], materials[i], directory);
+
+    u32 defaultMaterial = UINT32_MAX;
+    for (const GlbPrimitive& primitive : primitives)
+    {
+        u32 materialIdx = GetJsonIndex(GetJsonMember(*primitive.primitive, "material"));
+        if (materialIdx >= materials.size())
+        {
+            if (defaultMaterial == UINT32_MAX)
+            {
+                ImportedMaterial material = {};
+                material.name = "DefaultMaterial";
+                material.albedo = vec3(1.0f);
+                material.emissive = vec3(0.0f);
+                material.smoothness = 0.0f;
+                materials.push_back(material);
+                defaultMaterial = (u32)materials.size() - 1u;
+            }
+            materialIdx = defaultMaterial;
+        }
+        submeshMaterials.push_back(materialIdx);
+    }
+
+    submeshes.resize(primitives.size());
+    std::vector<u8> primitiveValid(primitives.size(), 0);
+    ParallelFor(primitives.size(), [&](u32 i)
+    {
+        primitiveValid[i] = ProcessGlbPrimitive(glb, *primitives[i].primitive, *primitives[i].transform, submeshes[i]);
+    });
+
+    for (u32 i = 0; i < primitives.size() && valid; ++i)
+    {
+        if (!primitiveValid[i])
+        {
+            ELOG("%s: primitive %u uses accessors this importer doesn't support", filename, i);
+            valid = false;
+        }
+    }
+
+    for (MappedFile& externalFile : glb.externalFiles)
+        UnmapFile(externalFile);
+    UnmapFile(file);
+
+    return valid && !submeshes.empty();
+}
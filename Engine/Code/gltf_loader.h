@@ -0,0 +1,41 @@
+//
+// gltf_loader.h: Native importer for binary glTF 2.0 (GLB) files. The file is mapped and
+// the accessors are read in place from its BIN chunk: tightly packed float streams go
+// straight to the vertex packer, and only what has to change (node transforms, other
+// component types, the flipped V) goes through a temporary copy.
+//
+
+#pragma once
+
+#include "assimp_model_loading.h"
+
+#define GLB_MAGIC        0x46546C67 // "glTF"
+#define GLB_VERSION      2
+#define GLB_CHUNK_JSON   0x4E4F534A // "JSON"
+#define GLB_CHUNK_BIN    0x004E4942 // "BIN\0"
+#define GLB_MAX_JSON_DEPTH 64
+
+struct GlbHeader
+{
+    u32 magic;
+    u32 version;
+    u32 length;
+};
+
+struct GlbChunkHeader
+{
+    u32 length;
+    u32 type;
+};
+
+/**
+ * Imports the triangle primitives of the default scene of a GLB file, one submesh per
+ * primitive reference, with the node transforms baked in as PreTransformVertices does.
+ * With keepHierarchy, every primitive is imported once instead and the node tree goes to
+ * nodes. The submeshes only hold their vertices and full detail indices, like the ones of
+ * ImportObjSubmeshes. Returns false if the file is invalid or uses something this
+ * importer doesn't support (sparse accessors, embedded data URIs...), so the caller can
+ * fall back to Assimp.
+ */
+bool ImportGlbSubmeshes(const char* filename, const std::string& directory, bool keepHierarchy, std::vector<Submesh>& submeshes,
+                        std::vector<u32>& submeshMaterials, std::vector<ImportedMaterial>& materials, std::vector<ModelNode>& nodes);
@@ -0,0 +1,59 @@
+#include "hot_reload.h"
+#include "asset_streaming.h"
+#include "asset_database.h"
+
+struct HotReload
+{
+    u32 nextAsset; // Textures first, then models
+};
+
+static HotReload GlobalHotReload;
+
+static void CheckTexture(App* app, u32 texIdx)
+{
+    Texture& texture = app->textures[texIdx];
+    if (texture.lastWriteTimestamp == 0)
+        return;
+
+    const u64 timestamp = GetFileLastWriteTimestamp(texture.filepath.c_str());
+    if (timestamp != 0 && timestamp != texture.lastWriteTimestamp && ReloadTexture2DAsync(app, texIdx))
+    {
+        ILOG("Texture %s changed, reloading", texture.filepath.c_str());
+        texture.lastWriteTimestamp = timestamp;
+    }
+}
+
+// Models are watched together with their inputs, an edited MTL reloads the OBJ
+static void CheckModel(App* app, u32 modelIdx)
+{
+    Model& model = app->models[modelIdx];
+    if (model.lastWriteTimestamp == 0)
+        return;
+
+    const u64 timestamp = GetAssetSourceTimestamp(model.name.c_str());
+    if (timestamp != 0 && timestamp != model.lastWriteTimestamp && ReloadModelAsync(app, modelIdx))
+    {
+        ILOG("Model %s changed, reloading", model.name.c_str());
+        model.lastWriteTimestamp = timestamp;
+    }
+}
+
+void UpdateHotReload(App* app)
+{
+    const u32 textureCount = app->textures.size();
+    const u32 assetCount = textureCount + app->models.size();
+    if (assetCount == 0)
+        return;
+
+    const u32 checkCount = glm::min(assetCount, (u32)HOT_RELOAD_CHECKS_PER_FRAME);
+    for (u32 i = 0; i < checkCount; ++i)
+    {
+        const u32 assetIdx = GlobalHotReload.nextAsset % assetCount;
+        GlobalHotReload.nextAsset = assetIdx + 1;
+
+        if (assetIdx < textureCount)
+            CheckTexture(app, assetIdx);
+        else
+            CheckModel(app, assetIdx - textureCount);
+    }
+}
@@ -0,0 +1,17 @@
+//
+// hot_reload.h: Watches the files every texture and model was loaded from, and reloads
+// the ones that change in the background, so art can be iterated on without restarting.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define HOT_RELOAD_CHECKS_PER_FRAME 16 // Assets whose files are polled each frame, round robin
+
+/**
+ * Polls the write times of a few assets' source files, and starts a background reload
+ * of the ones that changed since they were loaded. Called once per frame from the main
+ * thread.
+ */
+void UpdateHotReload(App* app);
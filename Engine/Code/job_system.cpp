@@ -0,0 +1,152 @@
+#include "job_system.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <deque>
+
+struct JobSystem
+{
+    std::vector<std::thread>          workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex                        mutex;
+    std::condition_variable           jobAvailable;
+    bool                              isRunning;
+};
+
+static JobSystem GlobalJobSystem;
+
+static void WorkerThread()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(GlobalJobSystem.mutex);
+            GlobalJobSystem.jobAvailable.wait(lock, [] { return !GlobalJobSystem.isRunning || !GlobalJobSystem.jobs.empty(); });
+
+            if (GlobalJobSystem.jobs.empty())
+                return;
+
+            job = std::move(GlobalJobSystem.jobs.front());
+            GlobalJobSystem.jobs.pop_front();
+        }
+        job();
+    }
+}
+
+static void PushJob(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(GlobalJobSystem.mutex);
+        GlobalJobSystem.jobs.push_back(std::move(job));
+    }
+    GlobalJobSystem.jobAvailable.notify_one();
+}
+
+void InitJobSystem(u32 workerCount)
+{
+    ASSERT(GlobalJobSystem.workers.empty(), "The job system is already initialized");
+
+    if (workerCount == 0)
+    {
+        u32 hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    GlobalJobSystem.isRunning = true;
+    for (u32 i = 0; i < workerCount; ++i)
+        GlobalJobSystem.workers.push_back(std::thread(WorkerThread));
+
+    ILOG("Job system started with %u worker threads", workerCount);
+}
+
+void ShutdownJobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(GlobalJobSystem.mutex);
+        GlobalJobSystem.isRunning = false;
+    }
+    GlobalJobSystem.jobAvailable.notify_all();
+
+    for (u32 i = 0; i < GlobalJobSystem.workers.size(); ++i)
+        GlobalJobSystem.workers[i].join();
+
+    GlobalJobSystem.workers.clear();
+    GlobalJobSystem.jobs.clear();
+}
+
+u32 GetJobWorkerCount()
+{
+    return (u32)GlobalJobSystem.workers.size();
+}
+
+void RunJobAsync(std::function<void()> job)
+{
+    if (GetJobWorkerCount() == 0)
+        job();
+    else
+        PushJob(std::move(job));
+}
+
+void ParallelFor(u32 count, const std::function<void(u32)>& job)
+{
+    if (count == 0)
+        return;
+
+    const u32 workerCount = GetJobWorkerCount();
+    if (workerCount == 0 || count == 1)
+    {
+        for (u32 i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    // The state is shared with the helper jobs, which may only get to run after
+    // this call has returned (and then find no work left).
+    struct ParallelForState
+    {
+        std::function<void(u32)> job;
+        u32                      count;
+        std::atomic<u32>         nextIndex;
+        std::atomic<u32>         finishedCount;
+        std::mutex               mutex;
+        std::condition_variable  finished;
+    };
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->job = job;
+    state->count = count;
+    state->nextIndex = 0;
+    state->finishedCount = 0;
+
+    auto runJobs = [](ParallelForState& state)
+    {
+        for (;;)
+        {
+            u32 index = state.nextIndex.fetch_add(1);
+            if (index >= state.count)
+                break;
+
+            state.job(index);
+
+            if (state.finishedCount.fetch_add(1) + 1 == state.count)
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.finished.notify_all();
+            }
+        }
+    };
+
+    const u32 helperCount = workerCount < count - 1 ? workerCount : count - 1;
+    for (u32 i = 0; i < helperCount; ++i)
+        PushJob([state, runJobs] { runJobs(*state); });
+
+    // The calling thread works too, so nested ParallelFor calls from a worker can't starve
+    runJobs(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->finishedCount == state->count; });
+}
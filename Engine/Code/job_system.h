@@ -0,0 +1,32 @@
+//
+// job_system.h: A small pool of worker threads to spread CPU-heavy work (asset import,
+// decoding, cooking...) across cores. None of the jobs may issue OpenGL calls, the GL
+// context only lives in the main thread.
+//
+
+#pragma once
+
+#include "platform.h"
+#include <functional>
+
+/**
+ * Spawns the worker threads. A workerCount of 0 uses one worker per hardware thread,
+ * leaving one for the main thread.
+ */
+void InitJobSystem(u32 workerCount = 0);
+
+void ShutdownJobSystem();
+
+u32 GetJobWorkerCount();
+
+/**
+ * Runs job(i) for every i in [0, count) across the workers and the calling thread, and
+ * returns once all of them have finished. Runs serially if there are no workers.
+ */
+void ParallelFor(u32 count, const std::function<void(u32)>& job);
+
+/**
+ * Queues a job to run in a worker without waiting for it. Runs it right away if there
+ * are no workers. Anything it captures by reference must outlive it.
+ */
+void RunJobAsync(std::function<void()> job);
@@ -0,0 +1,310 @@
+#include "mesh_cache.h"
+#include "buffer_management.h"
+#include "asset_database.h"
+
+static u64 GetMeshCacheSettings(u32 importFlags, u32 loadFlags)
+{
+    return ((u64)importFlags << 32) | loadFlags;
+}
+
+static void CopyCacheString(char* dst, u32 dstSize, const char* src)
+{
+    strncpy(dst, src, dstSize - 1);
+    dst[dstSize - 1] = '\0';
+}
+
+static bool IsMeshCacheValid(const MappedFile& file, u64 sourceKey, u32 importFlags, u32 loadFlags)
+{
+    if (file.size < sizeof(MeshCacheHeader))
+        return false;
+
+    const MeshCacheHeader* header = (const MeshCacheHeader*)file.data;
+
+    if (header->magic != MESH_CACHE_MAGIC ||
+        header->version != MESH_CACHE_VERSION ||
+        header->sourceKey != sourceKey ||
+        header->importFlags != importFlags ||
+        header->loadFlags != loadFlags)
+        return false;
+
+    const u64 submeshTableEnd  = (u64)header->submeshTableOffset + (u64)header->submeshCount * sizeof(MeshCacheSubmesh);
+    const u64 materialTableEnd = (u64)header->materialTableOffset + (u64)header->materialCount * sizeof(MeshCacheMaterial);
+    const u64 meshletTableEnd  = (u64)header->meshletTableOffset + (u64)header->meshletCount * sizeof(Meshlet);
+    const u64 vertexDataEnd    = (u64)header->vertexDataOffset + header->vertexDataSize;
+    const u64 indexDataEnd     = (u64)header->indexDataOffset + header->indexDataSize;
+    const u64 positionDataEnd  = (u64)header->positionDataOffset + header->positionDataSize;
+    const u64 nodeTableEnd     = (u64)header->nodeTableOffset + (u64)header->nodeCount * sizeof(MeshCacheNode);
+    const u64 nodeSubmeshesEnd = (u64)header->nodeSubmeshTableOffset + (u64)header->nodeSubmeshCount * sizeof(u32);
+
+    if (submeshTableEnd  > file.size ||
+        materialTableEnd > file.size ||
+        meshletTableEnd  > file.size ||
+        vertexDataEnd    > file.size ||
+        indexDataEnd     > file.size ||
+        positionDataEnd  > file.size ||
+        nodeTableEnd     > file.size ||
+        nodeSubmeshesEnd > file.size)
+        return false;
+
+    const MeshCacheSubmesh* submeshes = (const MeshCacheSubmesh*)(file.data + header->submeshTableOffset);
+    const Meshlet* meshlets = (const Meshlet*)(file.data + header->meshletTableOffset);
+    for (u32 i = 0; i < header->submeshCount; ++i)
+    {
+        const MeshCacheSubmesh& submesh = submeshes[i];
+        if (submesh.attributeCount > MESH_CACHE_MAX_ATTRIBUTES ||
+            submesh.stride == 0 ||
+            submesh.lodCount > MAX_SUBMESH_LODS ||
+            (submesh.indexType != GL_UNSIGNED_SHORT && submesh.indexType != GL_UNSIGNED_INT) ||
+            (u64)submesh.vertexOffset + submesh.vertexDataSize > header->vertexDataSize ||
+            (u64)submesh.indexOffset + submesh.indexDataSize > header->indexDataSize ||
+            (u64)submesh.positionOffset + submesh.positionDataSize > header->positionDataSize ||
+            (u64)submesh.meshletOffset + submesh.meshletCount > header->meshletCount)
+            return false;
+
+        // Index ranges are in indices, checked against what the index data of the submesh holds
+        const u32 totalIndexCount = submesh.indexDataSize / (submesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+        if (submesh.indexCount > totalIndexCount)
+            return false;
+        for (u32 j = 0; j < submesh.meshletCount; ++j)
+        {
+            const Meshlet& meshlet = meshlets[submesh.meshletOffset + j];
+            if ((u64)meshlet.indexOffset + meshlet.indexCount > submesh.indexCount)
+                return false;
+        }
+        for (u32 j = 0; j < submesh.lodCount; ++j)
+            if ((u64)submesh.lods[j].indexOffset + submesh.lods[j].indexCount > totalIndexCount)
+                return false;
+    }
+
+    const MeshCacheNode* nodes = (const MeshCacheNode*)(file.data + header->nodeTableOffset);
+    const u32* nodeSubmeshes = (const u32*)(file.data + header->nodeSubmeshTableOffset);
+    for (u32 i = 0; i < header->nodeCount; ++i)
+    {
+        if ((u64)nodes[i].submeshOffset + nodes[i].submeshCount > header->nodeSubmeshCount ||
+            (nodes[i].parent != UINT32_MAX && nodes[i].parent >= i))
+            return false;
+        for (u32 j = 0; j < nodes[i].submeshCount; ++j)
+            if (nodeSubmeshes[nodes[i].submeshOffset + j] >= header->submeshCount)
+                return false;
+    }
+
+    return true;
+}
+
+bool ReadMeshCache(const char* filename, u32 importFlags, u32 loadFlags, ImportedModel& model)
+{
+    const u64 settings = GetMeshCacheSettings(importFlags, loadFlags);
+    const u64 sourceKey = GetAssetCookKey(filename, AssetType_Model, settings);
+    if (sourceKey == 0)
+        return false;
+
+    std::string cachePath = GetCookedAssetPath(sourceKey, MESH_CACHE_EXTENSION);
+    MappedFile file = MapFile(cachePath.c_str());
+    if (!file.data)
+        return false;
+
+    if (!IsMeshCacheValid(file, sourceKey, importFlags, loadFlags))
+    {
+        ILOG("Mesh cache %s is out of date", cachePath.c_str());
+        UnmapFile(file);
+        return false;
+    }
+
+    const MeshCacheHeader*   header    = (const MeshCacheHeader*)file.data;
+    const MeshCacheSubmesh*  submeshes = (const MeshCacheSubmesh*)(file.data + header->submeshTableOffset);
+    const MeshCacheMaterial* materials = (const MeshCacheMaterial*)(file.data + header->materialTableOffset);
+    const Meshlet*           meshlets  = (const Meshlet*)(file.data + header->meshletTableOffset);
+    const MeshCacheNode*     nodes     = (const MeshCacheNode*)(file.data + header->nodeTableOffset);
+    const u32*               nodeSubmeshes = (const u32*)(file.data + header->nodeSubmeshTableOffset);
+
+    model.materials.resize(header->materialCount);
+    for (u32 i = 0; i < header->materialCount; ++i)
+    {
+        const MeshCacheMaterial& cached = materials[i];
+
+        ImportedMaterial& material = model.materials[i];
+        material.name = cached.name;
+        material.albedo = cached.albedo;
+        material.emissive = cached.emissive;
+        material.smoothness = cached.smoothness;
+        material.albedoTexture = cached.albedoTexture;
+        material.emissiveTexture = cached.emissiveTexture;
+        material.specularTexture = cached.specularTexture;
+        material.normalsTexture = cached.normalsTexture;
+        material.bumpTexture = cached.bumpTexture;
+    }
+
+    for (u32 i = 0; i < header->submeshCount; ++i)
+    {
+        const MeshCacheSubmesh& cached = submeshes[i];
+
+        Submesh submesh = {};
+        submesh.vertexBufferLayout.attributes.assign(cached.attributes, cached.attributes + cached.attributeCount);
+        submesh.vertexBufferLayout.stride = cached.stride;
+        submesh.vertexOffset = cached.vertexOffset;
+        submesh.indexOffset = cached.indexOffset;
+        submesh.vertexDataSize = cached.vertexDataSize;
+        submesh.indexDataSize = cached.indexDataSize;
+        submesh.positionOffset = cached.positionOffset;
+        submesh.positionDataSize = cached.positionDataSize;
+        submesh.indexCount = cached.indexCount;
+        submesh.indexType = cached.indexType;
+        submesh.positionScale = cached.positionScale;
+        submesh.positionBias = cached.positionBias;
+        submesh.lods.assign(cached.lods, cached.lods + cached.lodCount);
+        submesh.boundsCenter = cached.boundsCenter;
+        submesh.boundsRadius = cached.boundsRadius;
+        submesh.meshlets.assign(meshlets + cached.meshletOffset, meshlets + cached.meshletOffset + cached.meshletCount);
+        model.submeshes.push_back(submesh);
+
+        model.submeshMaterials.push_back(cached.materialIndex < header->materialCount ? cached.materialIndex : 0);
+    }
+
+    model.nodes.resize(header->nodeCount);
+    for (u32 i = 0; i < header->nodeCount; ++i)
+    {
+        const MeshCacheNode& cached = nodes[i];
+
+        ModelNode& node = model.nodes[i];
+        node.localTransform = cached.localTransform;
+        node.modelTransform = cached.modelTransform;
+        node.parent = cached.parent;
+        node.submeshes.assign(nodeSubmeshes + cached.submeshOffset, nodeSubmeshes + cached.submeshOffset + cached.submeshCount);
+    }
+
+    // The blobs are already laid out as the GPU expects them, so they are uploaded from
+    // the mapped pages and the file stays mapped until then
+    model.vertexData = file.data + header->vertexDataOffset;
+    model.indexData = file.data + header->indexDataOffset;
+    model.positionData = file.data + header->positionDataOffset;
+    model.vertexDataSize = header->vertexDataSize;
+    model.indexDataSize = header->indexDataSize;
+    model.positionDataSize = header->positionDataSize;
+    model.cacheFile = file;
+
+    RecordAssetCook(filename, AssetType_Model, settings, sourceKey);
+    return true;
+}
+
+bool WriteMeshCache(const char* filename, u32 importFlags, u32 loadFlags, const ImportedModel& model)
+{
+    const u64 settings = GetMeshCacheSettings(importFlags, loadFlags);
+    const u64 sourceKey = GetAssetCookKey(filename, AssetType_Model, settings);
+    if (sourceKey == 0)
+        return false;
+
+    std::vector<MeshCacheSubmesh> submeshes(model.submeshes.size());
+    u32 meshletCount = 0;
+
+    for (u32 i = 0; i < model.submeshes.size(); ++i)
+    {
+        const Submesh& submesh = model.submeshes[i];
+        ASSERT(submesh.vertexBufferLayout.attributes.size() <= MESH_CACHE_MAX_ATTRIBUTES, "Too many vertex attributes for the mesh cache");
+        ASSERT(submesh.lods.size() <= MAX_SUBMESH_LODS, "Too many LODs for the mesh cache");
+
+        MeshCacheSubmesh& cached = submeshes[i];
+        cached = {};
+        cached.attributeCount = (u8)submesh.vertexBufferLayout.attributes.size();
+        for (u32 j = 0; j < cached.attributeCount; ++j)
+            cached.attributes[j] = submesh.vertexBufferLayout.attributes[j];
+        cached.stride = submesh.vertexBufferLayout.stride;
+        cached.materialIndex = model.submeshMaterials[i];
+        cached.vertexOffset = submesh.vertexOffset;
+        cached.indexOffset = submesh.indexOffset;
+        cached.vertexDataSize = submesh.vertexDataSize;
+        cached.indexDataSize = submesh.indexDataSize;
+        cached.positionOffset = submesh.positionOffset;
+        cached.positionDataSize = submesh.positionDataSize;
+        cached.indexCount = submesh.indexCount;
+        cached.indexType = submesh.indexType;
+        cached.meshletOffset = meshletCount;
+        cached.meshletCount = submesh.meshlets.size();
+        cached.lodCount = submesh.lods.size();
+        for (u32 j = 0; j < cached.lodCount; ++j)
+            cached.lods[j] = submesh.lods[j];
+        cached.boundsCenter = submesh.boundsCenter;
+        cached.boundsRadius = submesh.boundsRadius;
+        cached.positionScale = submesh.positionScale;
+        cached.positionBias = submesh.positionBias;
+
+        meshletCount += submesh.meshlets.size();
+    }
+
+    std::vector<MeshCacheNode> nodes(model.nodes.size());
+    std::vector<u32> nodeSubmeshes;
+    for (u32 i = 0; i < model.nodes.size(); ++i)
+    {
+        const ModelNode& node = model.nodes[i];
+
+        MeshCacheNode& cached = nodes[i];
+        cached = {};
+        cached.localTransform = node.localTransform;
+        cached.modelTransform = node.modelTransform;
+        cached.parent = node.parent;
+        cached.submeshOffset = nodeSubmeshes.size();
+        cached.submeshCount = node.submeshes.size();
+        nodeSubmeshes.insert(nodeSubmeshes.end(), node.submeshes.begin(), node.submeshes.end());
+    }
+
+    MeshCacheHeader header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceKey = sourceKey;
+    header.importFlags = importFlags;
+    header.loadFlags = loadFlags;
+    header.submeshCount = submeshes.size();
+    header.materialCount = model.materials.size();
+    header.submeshTableOffset = sizeof(MeshCacheHeader);
+    header.materialTableOffset = header.submeshTableOffset + header.submeshCount * sizeof(MeshCacheSubmesh);
+    header.meshletCount = meshletCount;
+    header.meshletTableOffset = header.materialTableOffset + header.materialCount * sizeof(MeshCacheMaterial);
+    header.nodeCount = nodes.size();
+    header.nodeTableOffset = Align(header.meshletTableOffset + header.meshletCount * sizeof(Meshlet), 16);
+    header.nodeSubmeshCount = nodeSubmeshes.size();
+    header.nodeSubmeshTableOffset = header.nodeTableOffset + header.nodeCount * sizeof(MeshCacheNode);
+    header.vertexDataOffset = Align(header.nodeSubmeshTableOffset + header.nodeSubmeshCount * sizeof(u32), 16);
+    header.vertexDataSize = model.vertexDataSize;
+    header.indexDataOffset = Align(header.vertexDataOffset + header.vertexDataSize, 16);
+    header.indexDataSize = model.indexDataSize;
+    header.positionDataOffset = Align(header.indexDataOffset + header.indexDataSize, 16);
+    header.positionDataSize = model.positionDataSize;
+
+    std::vector<u8> bytes(header.positionDataOffset + header.positionDataSize, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(bytes.data() + header.submeshTableOffset, submeshes.data(), submeshes.size() * sizeof(MeshCacheSubmesh));
+
+    MeshCacheMaterial* materials = (MeshCacheMaterial*)(bytes.data() + header.materialTableOffset);
+    for (u32 i = 0; i < model.materials.size(); ++i)
+    {
+        const ImportedMaterial& material = model.materials[i];
+        MeshCacheMaterial& cached = materials[i];
+        CopyCacheString(cached.name, MESH_CACHE_MAX_NAME, material.name.c_str());
+        cached.albedo = material.albedo;
+        cached.emissive = material.emissive;
+        cached.smoothness = material.smoothness;
+        CopyCacheString(cached.albedoTexture, MESH_CACHE_MAX_PATH, material.albedoTexture.c_str());
+        CopyCacheString(cached.emissiveTexture, MESH_CACHE_MAX_PATH, material.emissiveTexture.c_str());
+        CopyCacheString(cached.specularTexture, MESH_CACHE_MAX_PATH, material.specularTexture.c_str());
+        CopyCacheString(cached.normalsTexture, MESH_CACHE_MAX_PATH, material.normalsTexture.c_str());
+        CopyCacheString(cached.bumpTexture, MESH_CACHE_MAX_PATH, material.bumpTexture.c_str());
+    }
+
+    for (u32 i = 0; i < model.submeshes.size(); ++i)
+    {
+        const Submesh& submesh = model.submeshes[i];
+        memcpy(bytes.data() + header.meshletTableOffset + submeshes[i].meshletOffset * sizeof(Meshlet), submesh.meshlets.data(), submesh.meshlets.size() * sizeof(Meshlet));
+    }
+
+    memcpy(bytes.data() + header.nodeTableOffset, nodes.data(), nodes.size() * sizeof(MeshCacheNode));
+    memcpy(bytes.data() + header.nodeSubmeshTableOffset, nodeSubmeshes.data(), nodeSubmeshes.size() * sizeof(u32));
+    memcpy(bytes.data() + header.vertexDataOffset, model.vertexData, model.vertexDataSize);
+    memcpy(bytes.data() + header.indexDataOffset, model.indexData, model.indexDataSize);
+    memcpy(bytes.data() + header.positionDataOffset, model.positionData, model.positionDataSize);
+
+    std::string cachePath = GetCookedAssetPath(sourceKey, MESH_CACHE_EXTENSION);
+    if (!WriteBinaryFile(cachePath.c_str(), bytes.data(), bytes.size()))
+        return false;
+
+    RecordAssetCook(filename, AssetType_Model, settings, sourceKey);
+    return true;
+}
@@ -0,0 +1,107 @@
+//
+// mesh_cache.h: Cooked binary copies of imported models. A cooked file holds the final
+// interleaved vertex data, the position streams, the indices (LODs included), the vertex
+// layouts, the meshlets, the node tree and the material table of a model, so warm starts
+// can skip importing and upload straight from the mapped file. The files live in the
+// cooked asset directory, named after their asset database key.
+//
+
+#pragma once
+
+#include "engine.h"
+#include "mesh_lod.h"
+#include "assimp_model_loading.h"
+
+#define MESH_CACHE_MAGIC         0x4853454D // "MESH"
+#define MESH_CACHE_VERSION       12
+#define MESH_CACHE_EXTENSION     ".mcache"
+#define MESH_CACHE_MAX_ATTRIBUTES 8
+#define MESH_CACHE_MAX_PATH      256
+#define MESH_CACHE_MAX_NAME      64
+
+struct MeshCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceKey; // GetAssetCookKey of the source, also the file name
+    u32 importFlags;
+    u32 submeshCount;
+    u32 materialCount;
+    u32 submeshTableOffset;
+    u32 materialTableOffset;
+    u32 meshletCount;
+    u32 meshletTableOffset;
+    u32 vertexDataOffset;
+    u32 vertexDataSize;
+    u32 indexDataOffset;
+    u32 indexDataSize;
+    u32 loadFlags;
+    u32 nodeCount;
+    u32 nodeTableOffset;
+    u32 nodeSubmeshCount;       // Submesh indices of all the nodes, back to back
+    u32 nodeSubmeshTableOffset;
+    u32 positionDataOffset;
+    u32 positionDataSize;
+};
+
+struct MeshCacheSubmesh
+{
+    VertexBufferAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+    u8  attributeCount;
+    u8  stride;
+    u16 padding;
+    u32 materialIndex; // Index into the material table of the file
+    u32 vertexOffset;  // Bytes from the start of the vertex data
+    u32 indexOffset;   // Bytes from the start of the index data
+    u32 vertexDataSize;
+    u32 indexDataSize;
+    u32 positionOffset; // Bytes from the start of the position data
+    u32 positionDataSize;
+    u32 indexCount;
+    u32 indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, as stored in the index data
+    u32 meshletOffset; // Index of the first meshlet in the meshlet table
+    u32 meshletCount;
+    SubmeshLod lods[MAX_SUBMESH_LODS];
+    u32 lodCount;
+    vec3 boundsCenter;
+    f32 boundsRadius;
+    vec3 positionScale;
+    vec3 positionBias;
+};
+
+struct MeshCacheNode
+{
+    mat4 localTransform;
+    mat4 modelTransform;
+    u32  parent;
+    u32  submeshOffset; // Index of the first submesh index of the node in the node submesh table
+    u32  submeshCount;
+    u32  padding;
+};
+
+struct MeshCacheMaterial
+{
+    char name[MESH_CACHE_MAX_NAME];
+    vec3 albedo;
+    vec3 emissive;
+    f32  smoothness;
+    char albedoTexture[MESH_CACHE_MAX_PATH];
+    char emissiveTexture[MESH_CACHE_MAX_PATH];
+    char specularTexture[MESH_CACHE_MAX_PATH];
+    char normalsTexture[MESH_CACHE_MAX_PATH];
+    char bumpTexture[MESH_CACHE_MAX_PATH];
+};
+
+/**
+ * Reads a model from its cooked file if there is one for the current contents of the
+ * source and its MTL, the import and load flags and the format version. The submeshes get no CPU-side
+ * vertices or indices, only the GPU ready blobs are filled, as views into the mapped file
+ * that ReleaseImportedModel unmaps. Safe to call from any thread.
+ */
+bool ReadMeshCache(const char* filename, u32 importFlags, u32 loadFlags, ImportedModel& model);
+
+/**
+ * Writes the cooked file of an imported model. Its submeshes must still hold their
+ * CPU-side data for the tables, the vertex and index data come from the blobs.
+ */
+bool WriteMeshCache(const char* filename, u32 importFlags, u32 loadFlags, const ImportedModel& model);
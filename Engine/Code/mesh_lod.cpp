@@ -0,0 +1,357 @@
+#include "mesh_lod.h"
+#include "mesh_processing.h"
+#include "vertex_interleave.h"
+#include <algorithm>
+
+#define SIMPLIFY_MAX_PASSES 64
+
+// A collapse is rejected if it rotates any remaining triangle more than ~75 degrees
+#define SIMPLIFY_MIN_NORMAL_COS 0.25f
+
+// LODs that don't drop at least this fraction of the previous triangles aren't kept
+#define SUBMESH_LOD_MIN_REDUCTION 0.15f
+
+// Below this many triangles a submesh is not worth simplifying any further
+#define SUBMESH_LOD_MIN_TRIANGLES 32
+
+// Area weighted sum of the squared distances to a set of planes
+struct Quadric
+{
+    f64 a00, a01, a02, a11, a12, a22;
+    f64 b0, b1, b2;
+    f64 c;
+    f64 weight;
+};
+
+static Quadric MakePlaneQuadric(vec3 normal, f32 distance, f32 weight)
+{
+    Quadric q;
+    q.a00 = weight * normal.x * normal.x;
+    q.a01 = weight * normal.x * normal.y;
+    q.a02 = weight * normal.x * normal.z;
+    q.a11 = weight * normal.y * normal.y;
+    q.a12 = weight * normal.y * normal.z;
+    q.a22 = weight * normal.z * normal.z;
+    q.b0 = weight * normal.x * distance;
+    q.b1 = weight * normal.y * distance;
+    q.b2 = weight * normal.z * distance;
+    q.c = weight * distance * distance;
+    q.weight = weight;
+    return q;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+    q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Mean squared distance from p to the planes of the quadric
+static f64 EvaluateQuadric(const Quadric& q, vec3 p)
+{
+    if (q.weight <= 0.0)
+        return 0.0;
+
+    f64 x = p.x, y = p.y, z = p.z;
+    f64 error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+                2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+                q.c;
+    return glm::max(error, 0.0) / q.weight;
+}
+
+static bool PositionLess(const vec3& a, const vec3& b)
+{
+    if (a.x != b.x) return a.x < b.x;
+    if (a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
+// Vertices that must not move: the ones sharing their position with other vertices
+// (uv/normal seams) and the ones on open borders
+static void FindLockedVertices(const u32* indices, u32 indexCount, const std::vector<vec3>& positions, std::vector<bool>& locked)
+{
+    const u32 vertexCount = positions.size();
+
+    std::vector<u32> sorted(vertexCount);
+    for (u32 i = 0; i < vertexCount; ++i)
+        sorted[i] = i;
+    std::sort(sorted.begin(), sorted.end(), [&](u32 a, u32 b) { return PositionLess(positions[a], positions[b]); });
+
+    // Weld by position, and lock every welded group bigger than one vertex
+    std::vector<u32> canonical(vertexCount);
+    locked.assign(vertexCount, false);
+    for (u32 begin = 0; begin < vertexCount;)
+    {
+        u32 end = begin + 1;
+        while (end < vertexCount && positions[sorted[end]] == positions[sorted[begin]])
+            end++;
+
+        for (u32 i = begin; i < end; ++i)
+        {
+            canonical[sorted[i]] = sorted[begin];
+            locked[sorted[i]] = end - begin > 1;
+        }
+        begin = end;
+    }
+
+    // A welded edge without its opposite half-edge is on a border
+    std::vector<u64> edges;
+    edges.reserve(indexCount);
+    for (u32 i = 0; i < indexCount; i += 3)
+    {
+        for (u32 j = 0; j < 3; ++j)
+        {
+            u64 a = canonical[indices[i + j]];
+            u64 b = canonical[indices[i + (j + 1) % 3]];
+            edges.push_back((a << 32) | b);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<bool> lockedCanonical(vertexCount, false);
+    for (u64 edge : edges)
+    {
+        u64 reversed = (edge << 32) | (edge >> 32);
+        if (!std::binary_search(edges.begin(), edges.end(), reversed))
+        {
+            lockedCanonical[edge >> 32] = true;
+            lockedCanonical[edge & 0xFFFFFFFF] = true;
+        }
+    }
+
+    for (u32 v = 0; v < vertexCount; ++v)
+        if (lockedCanonical[canonical[v]])
+            locked[v] = true;
+}
+
+struct EdgeCollapse
+{
+    u32 from;
+    u32 to;
+    f64 cost;
+};
+
+f32 SimplifyIndices(const u32* indices, u32 indexCount, const std::vector<vec3>& positions,
+                    u32 targetIndexCount, f32 maxError, std::vector<u32>& output)
+{
+    const u32 vertexCount = positions.size();
+    const f64 maxCost = (f64)maxError * (f64)maxError;
+
+    output.assign(indices, indices + indexCount);
+
+    std::vector<bool> locked;
+    FindLockedVertices(indices, indexCount, positions, locked);
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (u32 i = 0; i < indexCount; i += 3)
+    {
+        const vec3& p0 = positions[indices[i + 0]];
+        const vec3& p1 = positions[indices[i + 1]];
+        const vec3& p2 = positions[indices[i + 2]];
+        vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        f32 area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+
+        normal /= area;
+        Quadric q = MakePlaneQuadric(normal, -glm::dot(normal, p0), area);
+        for (u32 j = 0; j < 3; ++j)
+            AddQuadric(quadrics[indices[i + j]], q);
+    }
+
+    std::vector<u32> remap(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        remap[v] = v;
+
+    std::vector<u32> adjacencyOffsets;
+    std::vector<u32> adjacency;
+    std::vector<EdgeCollapse> collapses;
+    std::vector<bool> touched;
+    f64 resultCost = 0.0;
+
+    for (u32 pass = 0; pass < SIMPLIFY_MAX_PASSES && output.size() > targetIndexCount; ++pass)
+    {
+        const u32 triangleCount = output.size() / 3;
+
+        // Vertex -> triangles adjacency of the current triangles
+        adjacencyOffsets.assign(vertexCount + 1, 0);
+        for (u32 index : output)
+            adjacencyOffsets[index + 1]++;
+        for (u32 v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(output.size());
+        {
+            std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (u32 i = 0; i < output.size(); ++i)
+                adjacency[fill[output[i]]++] = i / 3;
+        }
+
+        // Every half-edge can collapse its start onto its end, cheapest first
+        collapses.clear();
+        for (u32 i = 0; i < output.size(); i += 3)
+        {
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 a = output[i + j];
+                u32 b = output[i + (j + 1) % 3];
+                if (!locked[a])
+                    collapses.push_back(EdgeCollapse{ a, b, EvaluateQuadric(quadrics[a], positions[b]) });
+                if (!locked[b])
+                    collapses.push_back(EdgeCollapse{ b, a, EvaluateQuadric(quadrics[b], positions[a]) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) { return a.cost < b.cost; });
+
+        // Apply as many independent collapses as possible: once a vertex neighbourhood
+        // changes it is left alone until the next pass
+        touched.assign(vertexCount, false);
+        const u32 trianglesToRemove = triangleCount - targetIndexCount / 3;
+        u32 removedTriangles = 0;
+        u32 collapseCount = 0;
+
+        for (const EdgeCollapse& collapse : collapses)
+        {
+            if (collapse.cost > maxCost || removedTriangles >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            bool valid = true;
+            u32 removing = 0;
+            for (u32 a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && valid; ++a)
+            {
+                const u32* triangle = &output[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    removing++;
+                    continue;
+                }
+
+                vec3 p[3], q[3];
+                for (u32 j = 0; j < 3; ++j)
+                {
+                    p[j] = positions[triangle[j]];
+                    q[j] = positions[triangle[j] == collapse.from ? collapse.to : triangle[j]];
+                }
+                vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                vec3 newNormal = glm::cross(q[1] - q[0], q[2] - q[0]);
+                f32 lengths = glm::length(oldNormal) * glm::length(newNormal);
+                if (glm::dot(oldNormal, newNormal) < SIMPLIFY_MIN_NORMAL_COS * lengths || lengths == 0.0f)
+                    valid = false;
+            }
+
+            if (!valid)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            resultCost = glm::max(resultCost, collapse.cost);
+
+            for (u32 a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a)
+            {
+                const u32* triangle = &output[adjacency[a] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+
+            removedTriangles += removing;
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // Remap and drop the triangles that collapsed to a line
+        u32 writeIdx = 0;
+        for (u32 i = 0; i < output.size(); i += 3)
+        {
+            u32 a = remap[output[i + 0]];
+            u32 b = remap[output[i + 1]];
+            u32 c = remap[output[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+
+            output[writeIdx++] = a;
+            output[writeIdx++] = b;
+            output[writeIdx++] = c;
+        }
+        output.resize(writeIdx);
+    }
+
+    return (f32)sqrt(resultCost);
+}
+
+void BuildSubmeshLods(Submesh& submesh)
+{
+    std::vector<vec3> positions;
+    ReadVertexPositions(submesh, positions);
+
+    submesh.lods.clear();
+    submesh.boundsCenter = vec3(0.0f);
+    submesh.boundsRadius = 0.0f;
+    if (positions.empty())
+        return;
+
+    vec3 minPos = positions[0];
+    vec3 maxPos = positions[0];
+    for (const vec3& position : positions)
+    {
+        minPos = glm::min(minPos, position);
+        maxPos = glm::max(maxPos, position);
+    }
+    submesh.boundsCenter = (minPos + maxPos) * 0.5f;
+    for (const vec3& position : positions)
+        submesh.boundsRadius = glm::max(submesh.boundsRadius, glm::length(position - submesh.boundsCenter));
+
+    submesh.lods.push_back(SubmeshLod{ 0, submesh.indexCount, 0.0f });
+
+    std::vector<u32> source(submesh.indices.begin(), submesh.indices.begin() + submesh.indexCount);
+    std::vector<u32> simplified;
+    f32 error = 0.0f;
+
+    while (submesh.lods.size() < MAX_SUBMESH_LODS && source.size() / 3 > SUBMESH_LOD_MIN_TRIANGLES)
+    {
+        u32 targetIndexCount = (u32)(source.size() / 3 * SUBMESH_LOD_TRIANGLE_RATIO) * 3;
+        f32 lodError = SimplifyIndices(source.data(), source.size(), positions, targetIndexCount,
+                                       SUBMESH_LOD_MAX_RELATIVE_ERROR * submesh.boundsRadius, simplified);
+
+        if (simplified.empty() || simplified.size() > source.size() * (1.0f - SUBMESH_LOD_MIN_REDUCTION))
+            break;
+
+        // Every LOD is simplified from the previous one, so their errors add up
+        error += lodError;
+
+        SubmeshLod lod = {};
+        lod.indexOffset = submesh.indices.size();
+        lod.indexCount = simplified.size();
+        lod.error = error;
+        submesh.lods.push_back(lod);
+        submesh.indices.insert(submesh.indices.end(), simplified.begin(), simplified.end());
+
+        source.swap(simplified);
+    }
+}
+
+u32 SelectSubmeshLod(const Submesh& submesh, const mat4& world, f32 worldScale, vec3 cameraPosition,
+                     f32 fovY, f32 screenHeight, f32 bias)
+{
+    if (submesh.lods.size() <= 1)
+        return 0;
+
+    const vec3 center = vec3(world * vec4(submesh.boundsCenter, 1.0f));
+    const f32 distance = glm::length(center - cameraPosition) - submesh.boundsRadius * worldScale;
+    if (distance <= 0.0f)
+        return 0;
+
+    const f32 pixelsPerUnit = screenHeight / (2.0f * tanf(fovY * 0.5f) * distance);
+    const f32 threshold = SUBMESH_LOD_ERROR_PIXELS * exp2f(bias);
+
+    for (u32 lod = submesh.lods.size() - 1; lod > 0; --lod)
+        if (submesh.lods[lod].error * worldScale * pixelsPerUnit <= threshold)
+            return lod;
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+//
+// mesh_lod.h: Level of detail chains for submeshes. At import every submesh gets a few
+// simplified index lists (quadric edge collapse onto existing vertices, so all the LODs
+// share the vertex data) appended after its full detail indices. At draw time the
+// renderer picks the coarsest one whose error stays below a pixel threshold.
+//
+
+#pragma once
+
+#include "engine.h"
+
+// LOD 0 (the full detail indices) included
+#define MAX_SUBMESH_LODS 4
+
+// Each LOD aims at this fraction of the triangles of the previous one
+#define SUBMESH_LOD_TRIANGLE_RATIO 0.5f
+
+// Largest error a LOD may introduce, relative to the submesh bounding radius
+#define SUBMESH_LOD_MAX_RELATIVE_ERROR 0.05f
+
+// On-screen error, in pixels, tolerated with a LOD bias of 0
+#define SUBMESH_LOD_ERROR_PIXELS 1.0f
+
+/**
+ * Collapses edges of the triangle list until it has at most targetIndexCount indices or
+ * no collapse stays under maxError (model units). Border and attribute seam vertices are
+ * kept in place. Writes the new triangle list to output and returns the error reached.
+ */
+f32 SimplifyIndices(const u32* indices, u32 indexCount, const std::vector<vec3>& positions,
+                    u32 targetIndexCount, f32 maxError, std::vector<u32>& output);
+
+/**
+ * Builds the LOD chain of a submesh: appends the simplified index lists to its indices
+ * and fills submesh.lods and its bounding sphere. GL-free, runs in the job system workers.
+ */
+void BuildSubmeshLods(Submesh& submesh);
+
+/**
+ * Picks the coarsest LOD of the submesh whose projected error is within
+ * SUBMESH_LOD_ERROR_PIXELS scaled by 2^bias.
+ */
+u32 SelectSubmeshLod(const Submesh& submesh, const mat4& world, f32 worldScale, vec3 cameraPosition,
+                     f32 fovY, f32 screenHeight, f32 bias);
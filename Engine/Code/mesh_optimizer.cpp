@@ -0,0 +1,379 @@
+#include "mesh_optimizer.h"
+#include "mesh_processing.h"
+#include "vertex_interleave.h"
+#include <algorithm>
+
+// Renumbers the vertices of an index range to [0, count) so the work arrays only depend
+// on the range and not on the whole submesh. vertices gets the original index of each.
+static u32 CompactIndices(const u32* indices, u32 indexCount, std::vector<u32>& local, std::vector<u32>& vertices)
+{
+    vertices.assign(indices, indices + indexCount);
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+    local.resize(indexCount);
+    for (u32 i = 0; i < indexCount; ++i)
+        local[i] = std::lower_bound(vertices.begin(), vertices.end(), indices[i]) - vertices.begin();
+
+    return vertices.size();
+}
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 cacheSize)
+{
+    VertexCacheStats stats = {};
+    if (indexCount < 3)
+        return stats;
+
+    std::vector<u32> local, vertices;
+    const u32 vertexCount = CompactIndices(indices, indexCount, local, vertices);
+
+    // FIFO: a vertex is a hit while fewer than cacheSize misses happened since it was loaded
+    std::vector<u32> cacheTimestamps(vertexCount, 0);
+    u32 timestamp = cacheSize + 1;
+    u32 misses = 0;
+
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        u32 vertex = local[i];
+        if (timestamp - cacheTimestamps[vertex] > cacheSize)
+        {
+            cacheTimestamps[vertex] = timestamp++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (f32)misses / (f32)(indexCount / 3);
+    stats.atvr = (f32)misses / (f32)vertexCount;
+    return stats;
+}
+
+static u32 SkipDeadEnd(const std::vector<u32>& liveTriangles, std::vector<u32>& deadEnds, u32& cursor)
+{
+    // Most recently used vertices with triangles left first
+    while (!deadEnds.empty())
+    {
+        u32 vertex = deadEnds.back();
+        deadEnds.pop_back();
+        if (liveTriangles[vertex] > 0)
+            return vertex;
+    }
+
+    // Then the next one in input order
+    while (cursor < liveTriangles.size())
+    {
+        if (liveTriangles[cursor] > 0)
+            return cursor;
+        cursor++;
+    }
+
+    return UINT32_MAX;
+}
+
+void OptimizeVertexCache(u32* indices, u32 indexCount, std::vector<u32>* clusters)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    std::vector<u32> local, vertices;
+    const u32 vertexCount = CompactIndices(indices, indexCount, local, vertices);
+
+    // Vertex -> triangles adjacency, packed
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    std::vector<u32> adjacency(indexCount);
+    for (u32 i = 0; i < indexCount; ++i)
+        adjacencyOffsets[local[i] + 1]++;
+    for (u32 v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<u32> liveTriangles(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+    {
+        std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (u32 i = 0; i < indexCount; ++i)
+            adjacency[fill[local[i]]++] = i / 3;
+    }
+
+    std::vector<u32> cacheTimestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> deadEnds;
+    std::vector<u32> candidates;
+    std::vector<u32> output;
+    output.reserve(triangleCount * 3);
+
+    u32 timestamp = VERTEX_CACHE_SIZE + 1;
+    u32 cursor = 0;
+    u32 fanningVertex = 0;
+
+    if (clusters)
+    {
+        clusters->clear();
+        clusters->push_back(0);
+    }
+
+    while (fanningVertex != UINT32_MAX)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (u32 a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; ++a)
+        {
+            const u32 triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+
+            for (u32 j = 0; j < 3; ++j)
+            {
+                const u32 vertex = local[triangle * 3 + j];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+
+                if (timestamp - cacheTimestamps[vertex] > VERTEX_CACHE_SIZE)
+                    cacheTimestamps[vertex] = timestamp++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Next fanning vertex: the oldest candidate that will still be in the cache
+        // after emitting its remaining triangles
+        u32 nextVertex = UINT32_MAX;
+        i32 bestPriority = -1;
+        for (u32 vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+
+            i32 priority = 0;
+            if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+                priority = timestamp - cacheTimestamps[vertex];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                nextVertex = vertex;
+            }
+        }
+
+        if (nextVertex == UINT32_MAX)
+        {
+            nextVertex = SkipDeadEnd(liveTriangles, deadEnds, cursor);
+            if (clusters && nextVertex != UINT32_MAX)
+                clusters->push_back(output.size() / 3);
+        }
+
+        fanningVertex = nextVertex;
+    }
+
+    ASSERT(output.size() == triangleCount * 3, "Tipsify lost triangles");
+
+    for (u32 i = 0; i < triangleCount * 3; ++i)
+        indices[i] = vertices[output[i]];
+}
+
+// Area weighted centroid of a set of triangles
+static vec3 ComputeCentroid(const u32* indices, u32 indexCount, const std::vector<vec3>& positions)
+{
+    vec3 centroid = vec3(0.0f);
+    f32 totalArea = 0.0f;
+    for (u32 i = 0; i + 2 < indexCount; i += 3)
+    {
+        const vec3& p0 = positions[indices[i + 0]];
+        const vec3& p1 = positions[indices[i + 1]];
+        const vec3& p2 = positions[indices[i + 2]];
+        f32 area = glm::length(glm::cross(p1 - p0, p2 - p0));
+        centroid += (p0 + p1 + p2) * (area / 3.0f);
+        totalArea += area;
+    }
+
+    return totalArea > 0.0f ? centroid / totalArea : centroid;
+}
+
+// How much a cluster faces away from the mesh center: the higher, the more likely it
+// occludes the rest of the mesh and the earlier it should be drawn
+static f32 ComputeOverdrawSortKey(const u32* indices, u32 indexCount, const std::vector<vec3>& positions, vec3 meshCentroid)
+{
+    vec3 normal = vec3(0.0f);
+    for (u32 i = 0; i + 2 < indexCount; i += 3)
+    {
+        const vec3& p0 = positions[indices[i + 0]];
+        const vec3& p1 = positions[indices[i + 1]];
+        const vec3& p2 = positions[indices[i + 2]];
+        normal += glm::cross(p1 - p0, p2 - p0);
+    }
+
+    f32 length = glm::length(normal);
+    if (length == 0.0f)
+        return 0.0f;
+
+    return glm::dot(ComputeCentroid(indices, indexCount, positions) - meshCentroid, normal / length);
+}
+
+void OptimizeOverdraw(u32* indices, u32 indexCount, const std::vector<vec3>& positions,
+                      const std::vector<u32>& clusters, f32 threshold)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    std::vector<u32> hardClusters = clusters;
+    if (hardClusters.empty() || hardClusters[0] != 0)
+        hardClusters.insert(hardClusters.begin(), 0);
+
+    // Split the dead-end clusters further wherever the ACMR so far is already within
+    // threshold of the whole cluster, so there are more pieces to sort
+    std::vector<u32> cacheTimestamps(positions.size(), 0);
+    u32 timestamp = VERTEX_CACHE_SIZE + 1;
+    auto SimulateTriangle = [&](u32 triangle)
+    {
+        u32 misses = 0;
+        for (u32 j = 0; j < 3; ++j)
+        {
+            u32 vertex = indices[triangle * 3 + j];
+            if (timestamp - cacheTimestamps[vertex] > VERTEX_CACHE_SIZE)
+            {
+                cacheTimestamps[vertex] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    std::vector<u32> boundaries;
+    for (u32 c = 0; c < hardClusters.size(); ++c)
+    {
+        const u32 begin = hardClusters[c];
+        const u32 end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+        if (begin >= end)
+            continue;
+
+        timestamp += VERTEX_CACHE_SIZE + 1; // Flush
+        u32 clusterMisses = 0;
+        for (u32 t = begin; t < end; ++t)
+            clusterMisses += SimulateTriangle(t);
+        const f32 clusterThreshold = threshold * (f32)clusterMisses / (f32)(end - begin);
+
+        timestamp += VERTEX_CACHE_SIZE + 1;
+        u32 misses = 0;
+        u32 start = begin;
+        boundaries.push_back(begin);
+        for (u32 t = begin; t < end; ++t)
+        {
+            misses += SimulateTriangle(t);
+            if (t + 1 < end && (f32)misses / (f32)(t + 1 - start) <= clusterThreshold)
+            {
+                boundaries.push_back(t + 1);
+                timestamp += VERTEX_CACHE_SIZE + 1;
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+
+    const vec3 meshCentroid = ComputeCentroid(indices, indexCount, positions);
+
+    std::vector<f32> keys(boundaries.size());
+    std::vector<u32> order(boundaries.size());
+    for (u32 c = 0; c < boundaries.size(); ++c)
+    {
+        const u32 end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangleCount;
+        keys[c] = ComputeOverdrawSortKey(indices + boundaries[c] * 3, (end - boundaries[c]) * 3, positions, meshCentroid);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return keys[a] > keys[b]; });
+
+    std::vector<u32> sorted;
+    sorted.reserve(triangleCount * 3);
+    for (u32 c : order)
+    {
+        const u32 end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangleCount;
+        sorted.insert(sorted.end(), indices + boundaries[c] * 3, indices + end * 3);
+    }
+    memcpy(indices, sorted.data(), sorted.size() * sizeof(u32));
+}
+
+// Meshlets already are compact clusters, so for overdraw they are only sorted
+static void SortMeshletsForOverdraw(Submesh& submesh, const std::vector<vec3>& positions)
+{
+    const vec3 meshCentroid = ComputeCentroid(submesh.indices.data(), submesh.indexCount, positions);
+
+    std::vector<f32> keys(submesh.meshlets.size());
+    std::vector<u32> order(submesh.meshlets.size());
+    for (u32 i = 0; i < submesh.meshlets.size(); ++i)
+    {
+        const Meshlet& meshlet = submesh.meshlets[i];
+        keys[i] = ComputeOverdrawSortKey(submesh.indices.data() + meshlet.indexOffset, meshlet.indexCount, positions, meshCentroid);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return keys[a] > keys[b]; });
+
+    std::vector<Meshlet> meshlets;
+    std::vector<u32> indices;
+    meshlets.reserve(submesh.meshlets.size());
+    indices.reserve(submesh.indexCount);
+    for (u32 i : order)
+    {
+        Meshlet meshlet = submesh.meshlets[i];
+        const u32* src = submesh.indices.data() + meshlet.indexOffset;
+        meshlet.indexOffset = indices.size();
+        indices.insert(indices.end(), src, src + meshlet.indexCount);
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(indices.begin(), indices.end(), submesh.indices.begin());
+    submesh.meshlets.swap(meshlets);
+}
+
+void OptimizeVertexFetch(Submesh& submesh)
+{
+    const u32 vertexCount = GetSubmeshVertexCount(submesh);
+    const u32 stride = submesh.vertexBufferLayout.stride;
+
+    std::vector<u32> remap(vertexCount, UINT32_MAX);
+    u32 newVertexCount = 0;
+    for (u32& index : submesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+            remap[index] = newVertexCount++;
+        index = remap[index];
+    }
+
+    std::vector<u8> vertices(newVertexCount * stride);
+    for (u32 v = 0; v < vertexCount; ++v)
+        if (remap[v] != UINT32_MAX)
+            memcpy(vertices.data() + remap[v] * stride, submesh.vertices.data() + v * stride, stride);
+
+    submesh.vertices.swap(vertices);
+    submesh.indexType = ChooseIndexType(newVertexCount);
+}
+
+MeshOptimizationStats OptimizeSubmesh(Submesh& submesh)
+{
+    MeshOptimizationStats stats = {};
+    stats.triangleCount = submesh.indexCount / 3;
+    stats.before = AnalyzeVertexCache(submesh.indices.data(), submesh.indexCount);
+
+    std::vector<vec3> positions;
+    ReadVertexPositions(submesh, positions);
+
+    if (submesh.meshlets.empty())
+    {
+        std::vector<u32> clusters;
+        OptimizeVertexCache(submesh.indices.data(), submesh.indexCount, &clusters);
+        OptimizeOverdraw(submesh.indices.data(), submesh.indexCount, positions, clusters);
+    }
+    else
+    {
+        for (const Meshlet& meshlet : submesh.meshlets)
+            OptimizeVertexCache(submesh.indices.data() + meshlet.indexOffset, meshlet.indexCount);
+        SortMeshletsForOverdraw(submesh, positions);
+    }
+
+    for (u32 lod = 1; lod < submesh.lods.size(); ++lod)
+        OptimizeVertexCache(submesh.indices.data() + submesh.lods[lod].indexOffset, submesh.lods[lod].indexCount);
+
+    OptimizeVertexFetch(submesh);
+
+    stats.after = AnalyzeVertexCache(submesh.indices.data(), submesh.indexCount);
+    return stats;
+}
@@ -0,0 +1,60 @@
+//
+// mesh_optimizer.h: Reorders the triangles and vertices of submeshes for the GPU:
+//   - post-transform vertex cache: Tipsify (Sander, Nehab, Barczak 2007)
+//   - overdraw: clusters of the cache optimized order sorted so outward facing ones go first
+//   - vertex fetch: vertices renumbered in the order the indices first use them
+// Runs on every submesh before upload, and reports the cache efficiency it gets
+// as ACMR (transformed vertices per triangle) and ATVR (per vertex, 1 is optimal).
+//
+
+#pragma once
+
+#include "engine.h"
+
+// FIFO size simulated by the optimizer and the stats, a common post-transform cache size
+#define VERTEX_CACHE_SIZE 16
+
+// Overdraw clusters may lose this much ACMR relative to the cache optimized order
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+
+struct VertexCacheStats
+{
+    f32 acmr;
+    f32 atvr;
+};
+
+struct MeshOptimizationStats
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+    u32 triangleCount;
+};
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * Reorders the triangles of an index list with Tipsify. If clusters is given, it gets the
+ * first triangle of every run that starts from a dead end (a cache flush point).
+ */
+void OptimizeVertexCache(u32* indices, u32 indexCount, std::vector<u32>* clusters = nullptr);
+
+/**
+ * Splits the cache optimized triangles at the given clusters (and wherever the ACMR allows
+ * it within threshold) and sorts the pieces so the ones facing away from the mesh
+ * center are drawn first.
+ */
+void OptimizeOverdraw(u32* indices, u32 indexCount, const std::vector<vec3>& positions,
+                      const std::vector<u32>& clusters, f32 threshold = OVERDRAW_ACMR_THRESHOLD);
+
+/**
+ * Renumbers the vertices of the submesh in first use order across all its indices
+ * (LODs included), dropping the unused ones.
+ */
+void OptimizeVertexFetch(Submesh& submesh);
+
+/**
+ * Runs the three optimizations on a submesh. When it already has meshlets, they are
+ * kept as the overdraw clusters and only reordered. LOD ranges are cache optimized too.
+ * GL-free, runs in the job system workers.
+ */
+MeshOptimizationStats OptimizeSubmesh(Submesh& submesh);
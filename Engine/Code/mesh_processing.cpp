@@ -0,0 +1,311 @@
+#include "mesh_processing.h"
+#include "buffer_management.h"
+#include "vertex_interleave.h"
+
+u32 GetSubmeshVertexCount(const Submesh& submesh)
+{
+    const u32 stride = submesh.vertexBufferLayout.stride;
+    return stride > 0 ? (u32)(submesh.vertices.size() / stride) : 0;
+}
+
+GLenum ChooseIndexType(u32 vertexCount)
+{
+    // GL_UNSIGNED_BYTE is left out on purpose, most drivers convert it on the CPU
+    return vertexCount <= MAX_16BIT_INDEX_VERTEX_COUNT ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+u32 GetIndexSize(GLenum indexType)
+{
+    switch (indexType)
+    {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:   return 4;
+    }
+    ASSERT(false, "Invalid index type");
+    return 0;
+}
+
+u32 GetSubmeshIndexDataSize(const Submesh& submesh)
+{
+    return submesh.indices.size() * GetIndexSize(submesh.indexType);
+}
+
+void PackSubmeshIndices(const Submesh& submesh, void* output)
+{
+    if (submesh.indexType == GL_UNSIGNED_SHORT)
+    {
+        u16* dst = (u16*)output;
+        for (u32 i = 0; i < submesh.indices.size(); ++i)
+        {
+            ASSERT(submesh.indices[i] <= 0xffff, "Index does not fit 16 bits");
+            dst[i] = (u16)submesh.indices[i];
+        }
+    }
+    else
+    {
+        memcpy(output, submesh.indices.data(), submesh.indices.size() * sizeof(u32));
+    }
+}
+
+void BuildMeshBuffers(std::vector<Submesh>& submeshes, std::vector<u8>& vertexData, std::vector<u8>& indexData, std::vector<u8>& positionData)
+{
+    u32 vertexDataSize = 0;
+    u32 indexDataSize = 0;
+    u32 positionDataSize = 0;
+
+    for (Submesh& submesh : submeshes)
+    {
+        submesh.vertexOffset = vertexDataSize;
+        submesh.vertexDataSize = submesh.vertices.size();
+        vertexDataSize += submesh.vertexDataSize;
+
+        submesh.positionOffset = positionDataSize;
+        submesh.positionDataSize = GetSubmeshVertexCount(submesh) * MakePositionStreamLayout(submesh.vertexBufferLayout).stride;
+        positionDataSize += submesh.positionDataSize;
+
+        // 16 and 32-bit submeshes share the buffer, so every offset is kept 4-byte aligned
+        submesh.indexOffset = indexDataSize;
+        submesh.indexDataSize = GetSubmeshIndexDataSize(submesh);
+        indexDataSize = Align(indexDataSize + submesh.indexDataSize, sizeof(u32));
+    }
+
+    vertexData.assign(vertexDataSize, 0);
+    indexData.assign(indexDataSize, 0);
+    positionData.assign(positionDataSize, 0);
+
+    for (const Submesh& submesh : submeshes)
+    {
+        memcpy(vertexData.data() + submesh.vertexOffset, submesh.vertices.data(), submesh.vertices.size());
+        PackSubmeshIndices(submesh, indexData.data() + submesh.indexOffset);
+        ExtractPositionStream(submesh, positionData.data() + submesh.positionOffset);
+    }
+}
+
+static void FinishSplitPart(const Submesh& source, Submesh& part, const std::vector<u32>& partVertices)
+{
+    const u32 stride = source.vertexBufferLayout.stride;
+
+    part.vertices.resize(partVertices.size() * stride);
+    for (u32 i = 0; i < partVertices.size(); ++i)
+        memcpy(part.vertices.data() + i * stride, source.vertices.data() + partVertices[i] * stride, stride);
+
+    part.indexCount = part.indices.size();
+    part.indexType = ChooseIndexType(partVertices.size());
+}
+
+void SplitSubmesh(Submesh&& submesh, u32 maxVertexCount, std::vector<Submesh>& parts)
+{
+    const u32 vertexCount = GetSubmeshVertexCount(submesh);
+    if (vertexCount <= maxVertexCount)
+    {
+        parts.push_back(std::move(submesh));
+        return;
+    }
+
+    ASSERT(maxVertexCount >= 3, "Split parts must hold at least a triangle");
+
+    Submesh empty = {};
+    empty.vertexBufferLayout = submesh.vertexBufferLayout;
+    empty.positionScale = submesh.positionScale;
+    empty.positionBias = submesh.positionBias;
+
+    // Source vertex -> vertex of the current part, stamped with the part it belongs to
+    // so it doesn't need clearing between parts
+    std::vector<u32> remap(vertexCount);
+    std::vector<u32> remapPart(vertexCount, UINT32_MAX);
+    std::vector<u32> partVertices;
+
+    u32 partIdx = 0;
+    Submesh part = empty;
+
+    for (u32 i = 0; i + 2 < submesh.indices.size(); i += 3)
+    {
+        u32 newVertices = 0;
+        for (u32 j = 0; j < 3; ++j)
+            if (remapPart[submesh.indices[i + j]] != partIdx)
+                newVertices++;
+
+        if (partVertices.size() + newVertices > maxVertexCount)
+        {
+            FinishSplitPart(submesh, part, partVertices);
+            parts.push_back(std::move(part));
+            part = empty;
+            partVertices.clear();
+            partIdx++;
+        }
+
+        for (u32 j = 0; j < 3; ++j)
+        {
+            u32 vertex = submesh.indices[i + j];
+            if (remapPart[vertex] != partIdx)
+            {
+                remapPart[vertex] = partIdx;
+                remap[vertex] = partVertices.size();
+                partVertices.push_back(vertex);
+            }
+            part.indices.push_back(remap[vertex]);
+        }
+    }
+
+    if (!part.indices.empty())
+    {
+        FinishSplitPart(submesh, part, partVertices);
+        parts.push_back(std::move(part));
+    }
+}
+
+// Submeshes going into one merged submesh, with the bounds of their quantized positions
+struct SubmeshMergeGroup
+{
+    u32 material;
+    std::vector<u32> submeshes;
+    vec3 minPos;
+    vec3 maxPos;
+};
+
+static bool HasQuantizedPositions(const Submesh& submesh)
+{
+    return MakePositionStreamLayout(submesh.vertexBufferLayout).attributes[0].type == GL_UNSIGNED_SHORT;
+}
+
+u32 MergeSubmeshesByMaterial(std::vector<Submesh>& submeshes, std::vector<u32>& submeshMaterials)
+{
+    std::vector<SubmeshMergeGroup> groups;
+    for (u32 i = 0; i < submeshes.size(); ++i)
+    {
+        const Submesh& submesh = submeshes[i];
+        const bool quantized = HasQuantizedPositions(submesh);
+        const vec3 minPos = submesh.positionBias;
+        const vec3 maxPos = submesh.positionBias + submesh.positionScale;
+
+        SubmeshMergeGroup* target = nullptr;
+        for (SubmeshMergeGroup& group : groups)
+        {
+            const Submesh& first = submeshes[group.submeshes[0]];
+            if (group.material != submeshMaterials[i] || !AreLayoutsEqual(first.vertexBufferLayout, submesh.vertexBufferLayout))
+                continue;
+            if (quantized && !CanQuantizePositions(glm::min(group.minPos, minPos), glm::max(group.maxPos, maxPos)))
+                continue;
+
+            target = &group;
+            break;
+        }
+
+        if (target)
+        {
+            target->submeshes.push_back(i);
+            target->minPos = glm::min(target->minPos, minPos);
+            target->maxPos = glm::max(target->maxPos, maxPos);
+        }
+        else
+        {
+            groups.push_back(SubmeshMergeGroup{ submeshMaterials[i], std::vector<u32>(1, i), minPos, maxPos });
+        }
+    }
+
+    if (groups.size() == submeshes.size())
+        return submeshes.size();
+
+    std::vector<Submesh> merged(groups.size());
+    std::vector<u32> mergedMaterials(groups.size());
+    for (u32 groupIdx = 0; groupIdx < groups.size(); ++groupIdx)
+    {
+        const SubmeshMergeGroup& group = groups[groupIdx];
+        Submesh& result = merged[groupIdx];
+        mergedMaterials[groupIdx] = group.material;
+
+        result = std::move(submeshes[group.submeshes[0]]);
+        if (group.submeshes.size() == 1)
+            continue;
+
+        const vec3 positionScale = group.maxPos - group.minPos;
+        const bool quantized = HasQuantizedPositions(result);
+        if (quantized)
+            RequantizeVertexPositions(result, positionScale, group.minPos);
+
+        for (u32 i = 1; i < group.submeshes.size(); ++i)
+        {
+            Submesh& submesh = submeshes[group.submeshes[i]];
+            if (quantized)
+                RequantizeVertexPositions(submesh, positionScale, group.minPos);
+
+            const u32 baseVertex = GetSubmeshVertexCount(result);
+            result.vertices.insert(result.vertices.end(), submesh.vertices.begin(), submesh.vertices.end());
+            result.positions.insert(result.positions.end(), submesh.positions.begin(), submesh.positions.end());
+            for (u32 j = 0; j < submesh.indexCount; ++j)
+                result.indices.push_back(baseVertex + submesh.indices[j]);
+        }
+
+        result.indexCount = result.indices.size();
+        result.indexType = ChooseIndexType(GetSubmeshVertexCount(result));
+    }
+
+    submeshes.swap(merged);
+    submeshMaterials.swap(mergedMaterials);
+    return submeshes.size();
+}
+
+vec3 SafeNormalize(const vec3& v, const vec3& fallback)
+{
+    const f32 length = glm::length(v);
+    return length > 1e-20f ? v / length : fallback;
+}
+
+void GenerateVertexNormals(u32 vertexCount, const vec3* positions, const u32* indices, u32 indexCount, std::vector<vec3>& normals)
+{
+    normals.assign(vertexCount, vec3(0.0f));
+    for (u32 i = 0; i + 2 < indexCount; i += 3)
+    {
+        const vec3& p0 = positions[indices[i]];
+        const vec3& p1 = positions[indices[i + 1]];
+        const vec3& p2 = positions[indices[i + 2]];
+        const vec3 faceNormal = SafeNormalize(glm::cross(p1 - p0, p2 - p0), vec3(0.0f));
+        for (u32 j = 0; j < 3; ++j)
+            normals[indices[i + j]] += faceNormal;
+    }
+
+    for (vec3& normal : normals)
+        normal = SafeNormalize(normal, vec3(0.0f, 1.0f, 0.0f));
+}
+
+void GenerateTangentSpace(u32 vertexCount, const vec3* positions, const vec3* texCoords, const vec3* normals,
+                          const u32* indices, u32 indexCount, std::vector<vec3>& tangents, std::vector<vec3>& bitangents)
+{
+    tangents.assign(vertexCount, vec3(0.0f));
+    bitangents.assign(vertexCount, vec3(0.0f));
+    for (u32 i = 0; i + 2 < indexCount; i += 3)
+    {
+        const u32 i0 = indices[i];
+        const u32 i1 = indices[i + 1];
+        const u32 i2 = indices[i + 2];
+        const vec3 v = positions[i1] - positions[i0];
+        const vec3 w = positions[i2] - positions[i0];
+        f32 sx = texCoords[i1].x - texCoords[i0].x;
+        f32 sy = texCoords[i1].y - texCoords[i0].y;
+        f32 tx = texCoords[i2].x - texCoords[i0].x;
+        f32 ty = texCoords[i2].y - texCoords[i0].y;
+        const f32 dirCorrection = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+        if (sx * ty == sy * tx)
+        {
+            sx = 0.0f; sy = 1.0f;
+            tx = 1.0f; ty = 0.0f;
+        }
+
+        const vec3 tangent = (w * sy - v * ty) * dirCorrection;
+        const vec3 bitangent = (w * sx - v * tx) * dirCorrection;
+        for (u32 index : { i0, i1, i2 })
+        {
+            tangents[index] += tangent;
+            bitangents[index] += bitangent;
+        }
+    }
+
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        const vec3& normal = normals[i];
+        const vec3 anyTangent = glm::abs(normal.x) < 0.9f ? glm::cross(normal, vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, vec3(0.0f, 1.0f, 0.0f));
+        tangents[i] = SafeNormalize(tangents[i] - normal * glm::dot(tangents[i], normal), glm::normalize(anyTangent));
+        bitangents[i] = SafeNormalize(bitangents[i] - normal * glm::dot(bitangents[i], normal), glm::cross(normal, tangents[i]));
+    }
+}
@@ -0,0 +1,75 @@
+//
+// mesh_processing.h: CPU-side transformations of imported submeshes that run before
+// they are uploaded (index buffer packing, splitting...). Everything here is GL-free so
+// it can run in the job system workers.
+//
+
+#pragma once
+
+#include "engine.h"
+
+// Largest vertex count whose indices still fit GL_UNSIGNED_SHORT
+#define MAX_16BIT_INDEX_VERTEX_COUNT 65536u
+
+u32 GetSubmeshVertexCount(const Submesh& submesh);
+
+/**
+ * Smallest index type that can address vertexCount vertices.
+ */
+GLenum ChooseIndexType(u32 vertexCount);
+
+u32 GetIndexSize(GLenum indexType);
+
+/**
+ * Size in bytes of the GPU copy of all the submesh indices (LODs included), in its indexType.
+ */
+u32 GetSubmeshIndexDataSize(const Submesh& submesh);
+
+/**
+ * Writes all the submesh indices into output converted to submesh.indexType.
+ */
+void PackSubmeshIndices(const Submesh& submesh, void* output);
+
+/**
+ * Lays the submeshes out back to back in a vertex, an index and a position blob, ready to
+ * be copied to the GPU as they are, and fills their offsets and data sizes. The position
+ * blob holds a second, position-only copy of every vertex for depth-only programs.
+ */
+void BuildMeshBuffers(std::vector<Submesh>& submeshes, std::vector<u8>& vertexData, std::vector<u8>& indexData, std::vector<u8>& positionData);
+
+/**
+ * Splits a submesh whose vertices don't fit 16-bit indices into parts of at most
+ * maxVertexCount vertices each, walking its triangles in order. The parts keep the
+ * vertex layout and position dequantization of the source. Submeshes that already
+ * fit are moved to parts as they are.
+ */
+void SplitSubmesh(Submesh&& submesh, u32 maxVertexCount, std::vector<Submesh>& parts);
+
+/**
+ * Concatenates the submeshes sharing a material and a vertex layout into one, in the order
+ * they first appear, and drops the materials of the merged ones from submeshMaterials.
+ * Quantized positions are packed again from the source ones against the bounds of the
+ * merged submesh, so only submeshes whose bounds together still quantize with a small
+ * enough step are merged. Meant for submeshes as importers leave them, with vertices,
+ * full detail indices and source positions only.
+ * Returns the submesh count after merging.
+ */
+u32 MergeSubmeshesByMaterial(std::vector<Submesh>& submeshes, std::vector<u32>& submeshMaterials);
+
+/**
+ * v normalized, or fallback if it is too short to have a direction.
+ */
+vec3 SafeNormalize(const vec3& v, const vec3& fallback);
+
+/**
+ * Per vertex normals as the normalized sum of the normals of the triangles using them.
+ */
+void GenerateVertexNormals(u32 vertexCount, const vec3* positions, const u32* indices, u32 indexCount, std::vector<vec3>& normals);
+
+/**
+ * Per triangle UV derivatives summed per vertex and made orthonormal to the normals, with
+ * the conventions of Assimp's CalcTangentSpace, so the bitangents need the same flip as
+ * Assimp ones. Only xy of the texCoords are read.
+ */
+void GenerateTangentSpace(u32 vertexCount, const vec3* positions, const vec3* texCoords, const vec3* normals,
+                          const u32* indices, u32 indexCount, std::vector<vec3>& tangents, std::vector<vec3>& bitangents);
@@ -0,0 +1,129 @@
+#include "mesh_residency.h"
+#include "assimp_model_loading.h"
+#include "mesh_processing.h"
+#include "vertex_interleave.h"
+
+static const char* MeshResidencyNames[MeshResidency_Count] = { "Full", "Positions", "Counts" };
+
+MeshResidency GetModelMeshResidency(u32 loadFlags)
+{
+    if (loadFlags & ModelLoad_KeepCpuGeometry)
+        return MeshResidency_Full;
+    if (loadFlags & ModelLoad_KeepCpuPositions)
+        return MeshResidency_PositionsOnly;
+    return MeshResidency_CountsOnly;
+}
+
+// Every index of the submesh (LODs included), as it was packed into the index blob
+static void UnpackSubmeshIndices(const Submesh& submesh, const u8* indexData, std::vector<u32>& indices)
+{
+    const u32 indexSize = GetIndexSize(submesh.indexType);
+    const u8* src = indexData + submesh.indexOffset;
+
+    indices.resize(submesh.indexDataSize / indexSize);
+    for (u32 i = 0; i < indices.size(); ++i, src += indexSize)
+    {
+        if (indexSize == 2)
+        {
+            u16 index;
+            memcpy(&index, src, sizeof(index));
+            indices[i] = index;
+        }
+        else
+        {
+            memcpy(&indices[i], src, sizeof(u32));
+        }
+    }
+}
+
+static void RestoreSubmeshGeometry(Submesh& submesh, const u8* vertexData, const u8* indexData)
+{
+    if (submesh.vertices.empty() && vertexData)
+        submesh.vertices.assign(vertexData + submesh.vertexOffset, vertexData + submesh.vertexOffset + submesh.vertexDataSize);
+    if (submesh.indices.empty() && indexData)
+        UnpackSubmeshIndices(submesh, indexData, submesh.indices);
+}
+
+// Swapping with an empty vector is what actually gives the memory back
+template <typename T>
+static void ReleaseVector(std::vector<T>& vector)
+{
+    std::vector<T>().swap(vector);
+}
+
+static void ApplySubmeshResidency(Submesh& submesh, MeshResidency residency, const u8* vertexData, const u8* indexData)
+{
+    switch (residency)
+    {
+        case MeshResidency_Full:
+            RestoreSubmeshGeometry(submesh, vertexData, indexData);
+            ReleaseVector(submesh.positions);
+            break;
+
+        case MeshResidency_PositionsOnly:
+            if (submesh.positions.empty())
+            {
+                RestoreSubmeshGeometry(submesh, vertexData, indexData);
+                ReadVertexPositions(submesh, submesh.positions);
+            }
+            ReleaseVector(submesh.vertices);
+            // The LODs are only for drawing, what reads the positions wants the full detail
+            if (submesh.indices.size() > submesh.indexCount)
+            {
+                submesh.indices.resize(submesh.indexCount);
+                submesh.indices.shrink_to_fit();
+            }
+            break;
+
+        case MeshResidency_CountsOnly:
+            ReleaseVector(submesh.vertices);
+            ReleaseVector(submesh.indices);
+            ReleaseVector(submesh.positions);
+            break;
+
+        default:
+            ASSERT(false, "Invalid mesh residency");
+            break;
+    }
+}
+
+void ApplyMeshResidency(Mesh& mesh, MeshResidency residency, const u8* vertexData, const u8* indexData)
+{
+    ASSERT(residency >= mesh.residency || (vertexData && indexData), "Can't restore CPU geometry without its blobs");
+
+    mesh.residency = residency;
+    for (Submesh& submesh : mesh.submeshes)
+        ApplySubmeshResidency(submesh, residency, vertexData, indexData);
+}
+
+u64 GetSubmeshCpuMemory(const Submesh& submesh)
+{
+    return (u64)submesh.vertices.capacity() +
+           (u64)submesh.indices.capacity() * sizeof(u32) +
+           (u64)submesh.positions.capacity() * sizeof(vec3);
+}
+
+// What MeshResidency_Full keeps, from the sizes of the uploaded ranges
+static u64 GetSubmeshFullCpuMemory(const Submesh& submesh)
+{
+    return (u64)submesh.vertexDataSize + (u64)(submesh.indexDataSize / GetIndexSize(submesh.indexType)) * sizeof(u32);
+}
+
+void GetMeshResidencyStats(const App* app, MeshResidencyStats& stats)
+{
+    stats = {};
+    for (const Mesh& mesh : app->meshes)
+    {
+        stats.meshCount[mesh.residency]++;
+        for (const Submesh& submesh : mesh.submeshes)
+        {
+            stats.keptBytes[mesh.residency] += GetSubmeshCpuMemory(submesh);
+            stats.fullBytes[mesh.residency] += GetSubmeshFullCpuMemory(submesh);
+        }
+    }
+}
+
+const char* GetMeshResidencyName(MeshResidency residency)
+{
+    return MeshResidencyNames[residency];
+}
@@ -0,0 +1,39 @@
+//
+// mesh_residency.h: What happens to the CPU copy of a mesh once it is on the GPU. Draws
+// only need the counts and ranges of each submesh, so by default the vertices and indices
+// are dropped after the upload, and models that need them for picking, physics or
+// re-cooking ask for a full or a position-only copy with their load flags.
+//
+
+#pragma once
+
+#include "engine.h"
+
+struct MeshResidencyStats
+{
+    u32 meshCount[MeshResidency_Count];
+    u64 keptBytes[MeshResidency_Count]; // CPU geometry the meshes of each policy hold
+    u64 fullBytes[MeshResidency_Count]; // What they would hold with MeshResidency_Full
+};
+
+/**
+ * Returns the residency a model asks for with its ModelLoad_KeepCpu* flags.
+ */
+MeshResidency GetModelMeshResidency(u32 loadFlags);
+
+/**
+ * Sets the residency of a mesh and trims its submeshes to it. vertexData and indexData are
+ * the blobs the mesh was uploaded from: they refill what the submeshes don't have (mesh
+ * cache imports only come with the blobs), and may be null if the mesh only moves to a
+ * policy that keeps less.
+ */
+void ApplyMeshResidency(Mesh& mesh, MeshResidency residency, const u8* vertexData, const u8* indexData);
+
+/**
+ * Bytes of CPU geometry a submesh holds right now, by capacity.
+ */
+u64 GetSubmeshCpuMemory(const Submesh& submesh);
+
+void GetMeshResidencyStats(const App* app, MeshResidencyStats& stats);
+
+const char* GetMeshResidencyName(MeshResidency residency);
@@ -0,0 +1,254 @@
+#include "meshlet.h"
+#include "mesh_processing.h"
+#include "vertex_interleave.h"
+
+// Below this the normals of a meshlet spread over more than ~84 degrees, and the cone
+// would almost never cull anything
+#define MESHLET_MIN_CONE_DOT 0.1f
+
+static void ComputeMeshletBounds(const std::vector<vec3>& positions, const u32* indices, Meshlet& meshlet)
+{
+    const u32 triangleCount = meshlet.indexCount / 3;
+
+    // Bounding sphere around the AABB center
+    vec3 minPos = positions[indices[0]];
+    vec3 maxPos = minPos;
+    for (u32 i = 1; i < meshlet.indexCount; ++i)
+    {
+        minPos = glm::min(minPos, positions[indices[i]]);
+        maxPos = glm::max(maxPos, positions[indices[i]]);
+    }
+
+    meshlet.center = (minPos + maxPos) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (u32 i = 0; i < meshlet.indexCount; ++i)
+        meshlet.radius = glm::max(meshlet.radius, glm::length(positions[indices[i]] - meshlet.center));
+
+    // Normal cone
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    vec3 axis = vec3(0.0f);
+    u32 normalCount = 0;
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        const vec3& p0 = positions[indices[t * 3 + 0]];
+        const vec3& p1 = positions[indices[t * 3 + 1]];
+        const vec3& p2 = positions[indices[t * 3 + 2]];
+        vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        f32 area = glm::length(normal);
+        if (area > 0.0f)
+        {
+            normals[normalCount++] = normal / area;
+            axis += normal / area;
+        }
+    }
+
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneAxis = vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    f32 axisLength = glm::length(axis);
+    if (normalCount == 0 || axisLength == 0.0f)
+        return;
+    axis /= axisLength;
+
+    f32 minDot = 1.0f;
+    for (u32 t = 0; t < normalCount; ++t)
+        minDot = glm::min(minDot, glm::dot(axis, normals[t]));
+
+    if (minDot <= MESHLET_MIN_CONE_DOT)
+        return;
+
+    // Move the apex back along the axis until every triangle plane is in front of it,
+    // so a camera inside the cone sees all of them from behind
+    f32 maxT = 0.0f;
+    for (u32 t = 0, n = 0; t < triangleCount; ++t)
+    {
+        const vec3& p0 = positions[indices[t * 3 + 0]];
+        const vec3& p1 = positions[indices[t * 3 + 1]];
+        const vec3& p2 = positions[indices[t * 3 + 2]];
+        if (glm::length(glm::cross(p1 - p0, p2 - p0)) == 0.0f)
+            continue;
+
+        const vec3& normal = normals[n++];
+        f32 distance = glm::dot(meshlet.center - p0, normal);
+        maxT = glm::max(maxT, distance / glm::dot(axis, normal));
+    }
+
+    meshlet.coneApex = meshlet.center - axis * maxT;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void BuildSubmeshMeshlets(Submesh& submesh)
+{
+    const u32 vertexCount = GetSubmeshVertexCount(submesh);
+    const u32 triangleCount = submesh.indexCount / 3;
+
+    submesh.meshlets.clear();
+    if (triangleCount == 0)
+        return;
+
+    // Vertex -> triangles adjacency, packed
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    std::vector<u32> adjacency(triangleCount * 3);
+    for (u32 i = 0; i < triangleCount * 3; ++i)
+        adjacencyOffsets[submesh.indices[i] + 1]++;
+    for (u32 v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    {
+        std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (u32 i = 0; i < triangleCount * 3; ++i)
+            adjacency[fill[submesh.indices[i]]++] = i / 3;
+    }
+
+    std::vector<u32> vertexMeshlet(vertexCount, UINT32_MAX); // Last meshlet that used each vertex
+    std::vector<bool> triangleUsed(triangleCount, false);
+    std::vector<u32> orderedIndices;
+    orderedIndices.reserve(triangleCount * 3);
+
+    u32 meshletVertices[MESHLET_MAX_VERTICES];
+    u32 nextSeed = 0;
+
+    while (true)
+    {
+        while (nextSeed < triangleCount && triangleUsed[nextSeed])
+            nextSeed++;
+        if (nextSeed == triangleCount)
+            break;
+
+        const u32 meshletIdx = submesh.meshlets.size();
+
+        Meshlet meshlet = {};
+        meshlet.indexOffset = orderedIndices.size();
+
+        u32 meshletVertexCount = 0;
+        u32 meshletTriangleCount = 0;
+        u32 triangle = nextSeed;
+
+        // Grow the meshlet from the seed, always taking the neighbouring triangle that
+        // adds the fewest new vertices, so meshlets stay compact
+        while (triangle != UINT32_MAX)
+        {
+            triangleUsed[triangle] = true;
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 vertex = submesh.indices[triangle * 3 + j];
+                if (vertexMeshlet[vertex] != meshletIdx)
+                {
+                    vertexMeshlet[vertex] = meshletIdx;
+                    meshletVertices[meshletVertexCount++] = vertex;
+                }
+                orderedIndices.push_back(vertex);
+            }
+
+            if (++meshletTriangleCount == MESHLET_MAX_TRIANGLES)
+                break;
+
+            triangle = UINT32_MAX;
+            u32 bestNewVertices = 3;
+            for (u32 v = 0; v < meshletVertexCount && bestNewVertices > 0; ++v)
+            {
+                const u32 vertex = meshletVertices[v];
+                for (u32 a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a)
+                {
+                    const u32 candidate = adjacency[a];
+                    if (triangleUsed[candidate])
+                        continue;
+
+                    u32 newVertices = 0;
+                    for (u32 j = 0; j < 3; ++j)
+                        if (vertexMeshlet[submesh.indices[candidate * 3 + j]] != meshletIdx)
+                            newVertices++;
+
+                    if (meshletVertexCount + newVertices <= MESHLET_MAX_VERTICES &&
+                        (newVertices < bestNewVertices || (newVertices == bestNewVertices && candidate < triangle)))
+                    {
+                        triangle = candidate;
+                        bestNewVertices = newVertices;
+                    }
+                }
+            }
+        }
+
+        meshlet.indexCount = orderedIndices.size() - meshlet.indexOffset;
+        submesh.meshlets.push_back(meshlet);
+    }
+
+    submesh.indices.swap(orderedIndices);
+
+    std::vector<vec3> positions;
+    ReadVertexPositions(submesh, positions);
+    for (Meshlet& meshlet : submesh.meshlets)
+        ComputeMeshletBounds(positions, submesh.indices.data() + meshlet.indexOffset, meshlet);
+}
+
+MeshletCullingView MakeMeshletCullingView(const mat4& viewProjection, const mat4& world, vec3 cameraPosition)
+{
+    MeshletCullingView view = {};
+
+    // Gribb-Hartmann: the planes are combinations of the rows of the matrix
+    const mat4 m = glm::transpose(viewProjection);
+    view.frustumPlanes[0] = m[3] + m[0]; // Left
+    view.frustumPlanes[1] = m[3] - m[0]; // Right
+    view.frustumPlanes[2] = m[3] + m[1]; // Bottom
+    view.frustumPlanes[3] = m[3] - m[1]; // Top
+    view.frustumPlanes[4] = m[3] + m[2]; // Near
+    view.frustumPlanes[5] = m[3] - m[2]; // Far
+    for (u32 i = 0; i < 6; ++i)
+        view.frustumPlanes[i] /= glm::length(vec3(view.frustumPlanes[i]));
+
+    view.world = world;
+    view.worldScale = glm::max(glm::length(vec3(world[0])), glm::max(glm::length(vec3(world[1])), glm::length(vec3(world[2]))));
+
+    // Backfacing is preserved by affine transforms, so the cones are tested in model space
+    view.cameraPosition = vec3(glm::inverse(world) * vec4(cameraPosition, 1.0f));
+
+    return view;
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const MeshletCullingView& view)
+{
+    const vec4 center = view.world * vec4(meshlet.center, 1.0f);
+    const f32 radius = meshlet.radius * view.worldScale;
+    for (u32 i = 0; i < 6; ++i)
+        if (glm::dot(view.frustumPlanes[i], center) < -radius)
+            return false;
+
+    if (meshlet.coneCutoff < 1.0f)
+    {
+        vec3 toApex = meshlet.coneApex - view.cameraPosition;
+        f32 distance = glm::length(toApex);
+        if (distance > 0.0f && glm::dot(toApex / distance, meshlet.coneAxis) >= meshlet.coneCutoff)
+            return false;
+    }
+
+    return true;
+}
+
+u32 CullSubmeshMeshlets(const Submesh& submesh, const MeshletCullingView& view,
+                        std::vector<GLsizei>& counts, std::vector<const void*>& offsets)
+{
+    const u32 indexSize = GetIndexSize(submesh.indexType);
+
+    u32 visibleCount = 0;
+    u32 rangeEnd = UINT32_MAX;
+    for (const Meshlet& meshlet : submesh.meshlets)
+    {
+        if (!IsMeshletVisible(meshlet, view))
+            continue;
+
+        visibleCount++;
+        if (meshlet.indexOffset == rangeEnd)
+        {
+            counts.back() += meshlet.indexCount;
+        }
+        else
+        {
+            counts.push_back(meshlet.indexCount);
+            offsets.push_back((const void*)(u64)((submesh.firstIndex + meshlet.indexOffset) * indexSize));
+        }
+        rangeEnd = meshlet.indexOffset + meshlet.indexCount;
+    }
+
+    return visibleCount;
+}
@@ -0,0 +1,39 @@
+//
+// meshlet.h: Splits submeshes into small clusters of triangles (meshlets) at import, each
+// with a bounding sphere and a normal cone, and culls them against the camera before the
+// geometry pass so off-screen or back-facing parts of a model are never submitted.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+ * Groups the triangles of the submesh into meshlets, reordering its indices so each
+ * meshlet is a contiguous range. Triangles keep their relative order as much as
+ * possible. GL-free, runs in the job system workers.
+ */
+void BuildSubmeshMeshlets(Submesh& submesh);
+
+struct MeshletCullingView
+{
+    vec4 frustumPlanes[6]; // World space, normalized, pointing inwards
+    mat4 world;
+    f32  worldScale;       // Largest scale of world, grows the bounding spheres
+    vec3 cameraPosition;   // Model space, for the normal cones
+};
+
+MeshletCullingView MakeMeshletCullingView(const mat4& viewProjection, const mat4& world, vec3 cameraPosition);
+
+bool IsMeshletVisible(const Meshlet& meshlet, const MeshletCullingView& view);
+
+/**
+ * Appends the index ranges of the visible meshlets of the submesh to counts/offsets,
+ * ready for glMultiDrawElements. Contiguous visible meshlets are merged into a single
+ * range. Returns the number of visible meshlets.
+ */
+u32 CullSubmeshMeshlets(const Submesh& submesh, const MeshletCullingView& view,
+                        std::vector<GLsizei>& counts, std::vector<const void*>& offsets);
@@ -0,0 +1,121 @@
+#include "model_upload.h"
+#include "asset_streaming.h"
+#include "asset_database.h"
+#include "mesh_residency.h"
+
+void CreateImportedMaterials(App* app, const ImportedModel& model, bool asyncTextures, std::vector<u32>& materialSlots)
+{
+    const u32 texturesPerMaterial = MATERIAL_TEXTURE_SLOTS;
+    std::vector<std::string> texturePaths;
+    for (const ImportedMaterial& imported : model.materials)
+    {
+        const std::string* paths[MATERIAL_TEXTURE_SLOTS];
+        GetMaterialTexturePaths(imported, paths);
+        for (const std::string* path : paths)
+            texturePaths.push_back(*path);
+    }
+
+    const u32 placeholders[texturesPerMaterial] = { app->whiteTexIdx, app->blackTexIdx, app->whiteTexIdx, app->normalTexIdx, app->whiteTexIdx };
+
+    std::vector<TextureUsage> textureUsages(texturePaths.size());
+    for (u32 i = 0; i < texturePaths.size(); ++i)
+        textureUsages[i] = GetMaterialTextureUsage(i % texturesPerMaterial);
+
+    // Every texture of the model is decoded at once, either in the background or here
+    std::vector<u32> texIndices(texturePaths.size(), UINT32_MAX);
+    if (asyncTextures)
+    {
+        for (u32 i = 0; i < texturePaths.size(); ++i)
+            if (!texturePaths[i].empty())
+                texIndices[i] = LoadTexture2DAsync(app, texturePaths[i].c_str(), textureUsages[i], placeholders[i % texturesPerMaterial]);
+    }
+    else
+    {
+        LoadTextures2D(app, texturePaths, textureUsages, texIndices);
+    }
+
+    for (u32 i = 0; i < texturePaths.size(); ++i)
+    {
+        // Index 0 is the default white texture every material starts with
+        if (texturePaths[i].empty())
+            texIndices[i] = 0;
+        else if (texIndices[i] == UINT32_MAX)
+            texIndices[i] = app->magentaTexIdx;
+    }
+
+    for (u32 materialIdx = 0; materialIdx < model.materials.size(); ++materialIdx)
+    {
+        const ImportedMaterial& imported = model.materials[materialIdx];
+        const u32* materialTextures = &texIndices[materialIdx * texturesPerMaterial];
+
+        Material material = {};
+        material.name = imported.name;
+        material.albedo = imported.albedo;
+        material.emissive = imported.emissive;
+        material.smoothness = imported.smoothness;
+        material.albedoTextureIdx = materialTextures[0];
+        material.emissiveTextureIdx = materialTextures[1];
+        material.specularTextureIdx = materialTextures[2];
+        material.normalsTextureIdx = materialTextures[3];
+        material.bumpTextureIdx = materialTextures[4];
+
+        // Reloads overwrite the materials of the previous version, only new ones are added
+        if (materialIdx < materialSlots.size())
+        {
+            app->materials[materialSlots[materialIdx]] = material;
+        }
+        else
+        {
+            materialSlots.push_back((u32)app->materials.size());
+            app->materials.push_back(material);
+        }
+    }
+}
+
+u32 UploadImportedModel(App* app, const char* filename, u32 loadFlags, ImportedModel& imported)
+{
+    app->meshes.push_back(Mesh{});
+    Mesh& mesh = app->meshes.back();
+    u32 meshIdx = (u32)app->meshes.size() - 1u;
+
+    app->models.push_back(Model{});
+    Model& model = app->models.back();
+    model.name = filename;
+    model.loadFlags = loadFlags;
+    model.lastWriteTimestamp = GetAssetSourceTimestamp(filename);
+    model.meshIdx = meshIdx;
+    u32 modelIdx = (u32)app->models.size() - 1u;
+
+    // Textures cooked by the import go up as they are, LoadTextures2D then finds them loaded
+    for (ImportedTexture& texture : imported.textures)
+    {
+        bool isLoaded = false;
+        for (const Texture& appTexture : app->textures)
+            isLoaded = isLoaded || appTexture.filepath == texture.filepath;
+
+        if (!isLoaded)
+            AddTexture2D(app, texture.filepath, texture.usage, texture.cooked);
+    }
+
+    CreateImportedMaterials(app, imported, false, model.materialSlots);
+    for (u32 materialIdx : imported.submeshMaterials)
+        model.materialIdx.push_back(model.materialSlots[materialIdx]);
+    model.nodes.swap(imported.nodes);
+
+    UploadMeshBuffers(imported.submeshes, imported.vertexData, imported.indexData, imported.positionData);
+    mesh.submeshes.swap(imported.submeshes);
+    ApplyMeshResidency(mesh, GetModelMeshResidency(loadFlags), imported.vertexData, imported.indexData);
+    ReleaseImportedModel(imported);
+
+    return modelIdx;
+}
+
+u32 LoadModel(App* app, const char* filename, u32 loadFlags)
+{
+    // The textures are cooked by the import too, so all the CPU work is done before the upload
+    ImportedModel imported;
+    if (!ImportModel(filename, loadFlags | ModelLoad_CookTextures, imported))
+        return UINT32_MAX;
+
+    return UploadImportedModel(app, filename, loadFlags, imported);
+}
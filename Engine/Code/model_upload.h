@@ -0,0 +1,31 @@
+//
+// model_upload.h: The GL side of model loading. ImportModel builds an ImportedModel
+// without touching OpenGL, and these functions turn it into the app's materials, mesh and
+// model, uploading its geometry. Keeping the two apart is what lets the import run in the
+// job system workers and in the headless benchmark.
+//
+
+#pragma once
+
+#include "engine.h"
+#include "assimp_model_loading.h"
+
+/**
+ * Writes the materials of an imported model to the app materials in materialSlots, which
+ * maps each imported material to an app one, adding new materials and slots for the ones
+ * it doesn't have yet. Their textures are streamed in the background if asyncTextures is set.
+ */
+void CreateImportedMaterials(App* app, const ImportedModel& model, bool asyncTextures, std::vector<u32>& materialSlots);
+
+/**
+ * Adds an imported model to the app and uploads its geometry and the textures the import
+ * cooked right away, loading any other texture synchronously. Its submeshes, nodes and
+ * textures are moved out of imported. Returns the index of the new model.
+ */
+u32 UploadImportedModel(App* app, const char* filename, u32 loadFlags, ImportedModel& imported);
+
+/**
+ * Imports a model and uploads it, both on the calling thread. Returns UINT32_MAX if the
+ * import fails.
+ */
+u32 LoadModel(App* app, const char* filename, u32 loadFlags = DEFAULT_MODEL_LOAD_FLAGS);
@@ -0,0 +1,676 @@
+#include "obj_loader.h"
+#include "job_system.h"
+#include "vertex_interleave.h"
+#include "mesh_processing.h"
+#include "text_parsing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+// Face corner as indices into the whole file streams, UINT32_MAX if absent
+struct ObjCorner
+{
+    u32 position;
+    u32 texCoord;
+    u32 normal;
+};
+
+// Triangles from firstCorner on use the named material. The runs of a chunk before its
+// first usemtl keep whatever material the previous chunk ended with.
+struct ObjMaterialRun
+{
+    std::string material;
+    bool        inherited;
+    u32         firstCorner;
+};
+
+struct ObjChunk
+{
+    const char*                 begin;
+    const char*                 end;
+    u32                         positionCount; // Counted before parsing, so every chunk knows
+    u32                         texCoordCount; // where its vertices go in the file streams
+    u32                         normalCount;
+    u32                         firstPosition;
+    u32                         firstTexCoord;
+    u32                         firstNormal;
+    std::vector<ObjCorner>      corners;       // Three per triangle, polygons are fanned
+    std::vector<ObjMaterialRun> runs;
+    std::vector<std::string>    materialLibraries;
+    bool                        invalid;
+};
+
+struct ObjCornerRange
+{
+    const ObjChunk* chunk;
+    u32             begin;
+    u32             end;
+};
+
+struct ObjStreams
+{
+    std::vector<vec3> positions;
+    std::vector<vec3> texCoords; // z is always 0, as VertexStreams expects 3D coordinates
+    std::vector<vec3> normals;
+};
+
+static f64 GetElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while (p < end && IsBlank(*p))
+        ++p;
+    return p;
+}
+
+// memchr is vectorized by the C runtime, which makes it the fastest way to find lines
+static inline const char* FindLineEnd(const char* p, const char* end)
+{
+    const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+    return lineEnd ? lineEnd : end;
+}
+
+static inline bool MatchKeyword(const char* p, const char* end, const char* keyword, u32 length)
+{
+    return (u64)(end - p) > length && memcmp(p, keyword, length) == 0 && IsBlank(p[length]);
+}
+
+// Rest of the line without the surrounding blanks
+static std::string ReadLineString(const char* p, const char* end)
+{
+    p = SkipBlanks(p, end);
+    while (end > p && IsBlank(end[-1]))
+        --end;
+    return std::string(p, end);
+}
+
+// Decimal floats with an optional exponent, without going through the locale as strtof does
+static const char* ParseFloat(const char* p, const char* end, f32& value)
+{
+    f64 result = 0.0;
+    p = ParseDecimal(SkipBlanks(p, end), end, result);
+    value = (f32)result;
+    return p;
+}
+
+// OBJ indices are 1-based, or relative to the last vertex when negative. Returns the 0-based
+// index, UINT32_MAX if there is none and UINT32_MAX - 1 if it is out of range.
+static const char* ParseIndex(const char* p, const char* end, u32 count, u32& index)
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+
+    if (p >= end || !IsDigit(*p))
+    {
+        index = UINT32_MAX;
+        return p;
+    }
+
+    u64 value = 0;
+    for (; p < end && IsDigit(*p); ++p)
+        if (value <= UINT32_MAX)
+            value = value * 10 + (*p - '0');
+
+    if (value == 0 || value > count)
+        index = UINT32_MAX - 1;
+    else
+        index = negative ? count - (u32)value : (u32)value - 1;
+    return p;
+}
+
+static void CountObjChunkVertices(ObjChunk& chunk)
+{
+    chunk.positionCount = 0;
+    chunk.texCoordCount = 0;
+    chunk.normalCount = 0;
+
+    // Same tests as ParseObjChunk, or the chunk would write past its slice
+    const char* end = chunk.end;
+    for (const char* p = chunk.begin; p < end; )
+    {
+        p = SkipBlanks(p, end);
+        const char* lineEnd = FindLineEnd(p, end);
+        if (lineEnd - p >= 2 && p[0] == 'v')
+        {
+            if (IsBlank(p[1]))
+                ++chunk.positionCount;
+            else if (p[1] == 't' && lineEnd - p >= 3 && IsBlank(p[2]))
+                ++chunk.texCoordCount;
+            else if (p[1] == 'n' && lineEnd - p >= 3 && IsBlank(p[2]))
+                ++chunk.normalCount;
+        }
+        p = lineEnd + 1;
+    }
+}
+
+// Runs in the job system workers: every chunk writes its own slice of the streams
+static void ParseObjChunk(ObjChunk& chunk, ObjStreams& streams)
+{
+    u32 positionCount = chunk.firstPosition;
+    u32 texCoordCount = chunk.firstTexCoord;
+    u32 normalCount = chunk.firstNormal;
+
+    ObjMaterialRun firstRun = { std::string(), true, 0 };
+    chunk.runs.push_back(firstRun);
+
+    std::vector<ObjCorner> polygon;
+    const char* end = chunk.end;
+    for (const char* p = chunk.begin; p < end; )
+    {
+        p = SkipBlanks(p, end);
+        const char* lineEnd = FindLineEnd(p, end);
+
+        if (lineEnd - p >= 2 && p[0] == 'v')
+        {
+            if (IsBlank(p[1]))
+            {
+                vec3& position = streams.positions[positionCount++];
+                p = ParseFloat(p + 1, lineEnd, position.x);
+                p = ParseFloat(p, lineEnd, position.y);
+                p = ParseFloat(p, lineEnd, position.z);
+            }
+            else if (p[1] == 't' && lineEnd - p >= 3 && IsBlank(p[2]))
+            {
+                vec3& texCoord = streams.texCoords[texCoordCount++];
+                p = ParseFloat(p + 2, lineEnd, texCoord.x);
+                p = ParseFloat(p, lineEnd, texCoord.y);
+                texCoord.z = 0.0f;
+            }
+            else if (p[1] == 'n' && lineEnd - p >= 3 && IsBlank(p[2]))
+            {
+                vec3& normal = streams.normals[normalCount++];
+                p = ParseFloat(p + 2, lineEnd, normal.x);
+                p = ParseFloat(p, lineEnd, normal.y);
+                p = ParseFloat(p, lineEnd, normal.z);
+            }
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && IsBlank(p[1]))
+        {
+            polygon.clear();
+            for (p = SkipBlanks(p + 1, lineEnd); p < lineEnd; p = SkipBlanks(p, lineEnd))
+            {
+                ObjCorner corner = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+                p = ParseIndex(p, lineEnd, positionCount, corner.position);
+                if (p < lineEnd && *p == '/')
+                {
+                    p = ParseIndex(p + 1, lineEnd, texCoordCount, corner.texCoord);
+                    if (p < lineEnd && *p == '/')
+                        p = ParseIndex(p + 1, lineEnd, normalCount, corner.normal);
+                }
+
+                if (corner.position >= UINT32_MAX - 1 || corner.texCoord == UINT32_MAX - 1 || corner.normal == UINT32_MAX - 1 ||
+                    (p < lineEnd && !IsBlank(*p)))
+                {
+                    chunk.invalid = true;
+                    return;
+                }
+                polygon.push_back(corner);
+            }
+
+            // Fanned around the first corner, as faces are expected to be convex
+            for (u32 i = 2; i < polygon.size(); ++i)
+            {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+        else if (MatchKeyword(p, lineEnd, "usemtl", 6))
+        {
+            ObjMaterialRun run = { ReadLineString(p + 6, lineEnd), false, (u32)chunk.corners.size() };
+            chunk.runs.push_back(run);
+        }
+        else if (MatchKeyword(p, lineEnd, "mtllib", 6))
+        {
+            chunk.materialLibraries.push_back(ReadLineString(p + 6, lineEnd));
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+// Texture statements may start with options such as "-bm 0.5" before the file name
+static std::string ReadTextureFilename(const char* p, const char* end, const std::string& directory)
+{
+    struct TextureOption { const char* name; u32 argumentCount; };
+    static const TextureOption options[] =
+    {
+        { "-blendu", 1 }, { "-blendv", 1 }, { "-boost", 1 }, { "-mm", 2 }, { "-o", 3 }, { "-s", 3 }, { "-t", 3 },
+        { "-texres", 1 }, { "-clamp", 1 }, { "-bm", 1 }, { "-imfchan", 1 }, { "-type", 1 }, { "-cc", 1 },
+    };
+
+    for (p = SkipBlanks(p, end); p < end && *p == '-'; p = SkipBlanks(p, end))
+    {
+        const char* optionEnd = p;
+        while (optionEnd < end && !IsBlank(*optionEnd))
+            ++optionEnd;
+
+        u32 argumentCount = 0;
+        for (const TextureOption& option : options)
+            if ((size_t)(optionEnd - p) == strlen(option.name) && memcmp(p, option.name, optionEnd - p) == 0)
+                argumentCount = option.argumentCount;
+
+        p = optionEnd;
+        for (u32 i = 0; i < argumentCount; ++i)
+        {
+            p = SkipBlanks(p, end);
+            while (p < end && !IsBlank(*p))
+                ++p;
+        }
+    }
+
+    std::string filename = ReadLineString(p, end);
+    return filename.empty() ? filename : directory + "/" + filename;
+}
+
+// Same defaults Assimp gives OBJ materials
+static ImportedMaterial MakeDefaultObjMaterial(const std::string& name)
+{
+    ImportedMaterial material = {};
+    material.name = name;
+    material.albedo = vec3(0.6f);
+    material.emissive = vec3(0.0f);
+    material.smoothness = 0.0f;
+    return material;
+}
+
+static bool ParseMtlFile(const std::string& path, const std::string& directory, std::vector<ImportedMaterial>& materials)
+{
+    MappedFile file = MapFile(path.c_str());
+    if (!file.data)
+    {
+        ELOG("Could not open material library %s", path.c_str());
+        return false;
+    }
+
+    ImportedMaterial* material = nullptr;
+    const char* end = (const char*)file.data + file.size;
+    for (const char* p = (const char*)file.data; p < end; p = FindLineEnd(p, end) + 1)
+    {
+        p = SkipBlanks(p, end);
+        const char* lineEnd = FindLineEnd(p, end);
+
+        if (MatchKeyword(p, lineEnd, "newmtl", 6))
+        {
+            materials.push_back(MakeDefaultObjMaterial(ReadLineString(p + 6, lineEnd)));
+            material = &materials.back();
+        }
+        else if (!material)
+        {
+            continue;
+        }
+        else if (MatchKeyword(p, lineEnd, "Kd", 2))
+        {
+            p = ParseFloat(p + 2, lineEnd, material->albedo.x);
+            p = ParseFloat(p, lineEnd, material->albedo.y);
+            ParseFloat(p, lineEnd, material->albedo.z);
+        }
+        else if (MatchKeyword(p, lineEnd, "Ke", 2))
+        {
+            p = ParseFloat(p + 2, lineEnd, material->emissive.x);
+            p = ParseFloat(p, lineEnd, material->emissive.y);
+            ParseFloat(p, lineEnd, material->emissive.z);
+        }
+        else if (MatchKeyword(p, lineEnd, "Ns", 2))
+        {
+            f32 shininess = 0.0f;
+            ParseFloat(p + 2, lineEnd, shininess);
+            material->smoothness = shininess / 256.0f;
+        }
+        else if (MatchKeyword(p, lineEnd, "map_Kd", 6))
+        {
+            material->albedoTexture = ReadTextureFilename(p + 6, lineEnd, directory);
+        }
+        else if (MatchKeyword(p, lineEnd, "map_Ke", 6))
+        {
+            material->emissiveTexture = ReadTextureFilename(p + 6, lineEnd, directory);
+        }
+        else if (MatchKeyword(p, lineEnd, "map_Ks", 6))
+        {
+            material->specularTexture = ReadTextureFilename(p + 6, lineEnd, directory);
+        }
+        else if (MatchKeyword(p, lineEnd, "norm", 4))
+        {
+            material->normalsTexture = ReadTextureFilename(p + 4, lineEnd, directory);
+        }
+        // Height maps are used as normal maps, and take precedence as in the Assimp path
+        else if (MatchKeyword(p, lineEnd, "map_Bump", 8) || MatchKeyword(p, lineEnd, "map_bump", 8))
+        {
+            material->normalsTexture = ReadTextureFilename(p + 8, lineEnd, directory);
+        }
+        else if (MatchKeyword(p, lineEnd, "bump", 4))
+        {
+            material->normalsTexture = ReadTextureFilename(p + 4, lineEnd, directory);
+        }
+    }
+
+    UnmapFile(file);
+    return true;
+}
+
+static inline u32 HashObjCorner(const ObjCorner& corner)
+{
+    u32 hash = corner.position * 0x9E3779B1u;
+    hash = (hash ^ (hash >> 15)) + corner.texCoord * 0x85EBCA77u;
+    hash = (hash ^ (hash >> 13)) + corner.normal * 0xC2B2AE3Du;
+    return hash ^ (hash >> 16);
+}
+
+static inline bool operator==(const ObjCorner& a, const ObjCorner& b)
+{
+    return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+static inline u64 GetWeldCellKey(const ivec3& cell)
+{
+    return (u64)(u32)cell.x | ((u64)(u32)cell.y << 21) | ((u64)(u32)cell.z << 42);
+}
+
+// Face normals summed over every vertex within a small distance, as GenSmoothNormals does
+// with its SpatialSort, so positions repeated in the file (seams, split groups) still
+// smooth together. The grid cells are one distance wide, so the neighbors of a vertex are
+// all in the 27 cells around its own.
+static void GenerateSmoothNormals(const std::vector<vec3>& positions, const std::vector<u32>& indices, std::vector<vec3>& normals)
+{
+    const u32 vertexCount = (u32)positions.size();
+    std::vector<vec3> vertexNormals(vertexCount, vec3(0.0f));
+    for (u32 i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const vec3& p0 = positions[indices[i]];
+        const vec3& p1 = positions[indices[i + 1]];
+        const vec3& p2 = positions[indices[i + 2]];
+        const vec3 faceNormal = SafeNormalize(glm::cross(p1 - p0, p2 - p0), vec3(0.0f));
+        for (u32 j = 0; j < 3; ++j)
+            vertexNormals[indices[i + j]] += faceNormal;
+    }
+
+    vec3 boundsMin = vertexCount > 0 ? positions[0] : vec3(0.0f);
+    vec3 boundsMax = boundsMin;
+    for (const vec3& position : positions)
+    {
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+
+    // At most 1 / OBJ_NORMAL_WELD_EPSILON + 1 cells per axis, well within 21 bits
+    const f32 epsilon = glm::length(boundsMax - boundsMin) * OBJ_NORMAL_WELD_EPSILON;
+    const f32 cellScale = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+    std::unordered_map<u64, u32> cellFirstVertex;
+    std::vector<u32> nextCellVertex(vertexCount, UINT32_MAX);
+    std::vector<ivec3> vertexCells(vertexCount);
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        vertexCells[i] = ivec3(glm::floor((positions[i] - boundsMin) * cellScale));
+        std::pair<std::unordered_map<u64, u32>::iterator, bool> cell = cellFirstVertex.emplace(GetWeldCellKey(vertexCells[i]), i);
+        if (!cell.second)
+        {
+            nextCellVertex[i] = cell.first->second;
+            cell.first->second = i;
+        }
+    }
+
+    normals.resize(vertexCount);
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        vec3 normal(0.0f);
+        for (i32 z = -1; z <= 1; ++z)
+        for (i32 y = -1; y <= 1; ++y)
+        for (i32 x = -1; x <= 1; ++x)
+        {
+            const ivec3 cell = vertexCells[i] + ivec3(x, y, z);
+            if (cell.x < 0 || cell.y < 0 || cell.z < 0)
+                continue;
+
+            std::unordered_map<u64, u32>::const_iterator it = cellFirstVertex.find(GetWeldCellKey(cell));
+            if (it == cellFirstVertex.end())
+                continue;
+
+            for (u32 j = it->second; j != UINT32_MAX; j = nextCellVertex[j])
+            {
+                const vec3 offset = positions[j] - positions[i];
+                if (glm::dot(offset, offset) <= epsilon * epsilon)
+                    normal += vertexNormals[j];
+            }
+        }
+        normals[i] = SafeNormalize(normal, vec3(0.0f, 1.0f, 0.0f));
+    }
+}
+
+// Runs in the job system workers: welds the corners of one material into a submesh
+static void BuildObjSubmesh(const std::vector<ObjCornerRange>& ranges, const ObjStreams& streams, Submesh& submesh)
+{
+    u32 cornerCount = 0;
+    bool hasTexCoords = !streams.texCoords.empty();
+    bool hasNormals = !streams.normals.empty();
+    for (const ObjCornerRange& range : ranges)
+    {
+        cornerCount += range.end - range.begin;
+        for (u32 i = range.begin; i < range.end; ++i)
+            hasNormals = hasNormals && range.chunk->corners[i].normal != UINT32_MAX;
+    }
+
+    // Open addressing table from corner to vertex, at most half full
+    u32 slotCount = 16;
+    while (slotCount < cornerCount * 2)
+        slotCount *= 2;
+    std::vector<u32> slots(slotCount, UINT32_MAX);
+
+    std::vector<ObjCorner> vertices;
+    std::vector<u32> indices(cornerCount);
+    u32* dstIndex = indices.data();
+    for (const ObjCornerRange& range : ranges)
+    {
+        for (u32 i = range.begin; i < range.end; ++i)
+        {
+            ObjCorner corner = range.chunk->corners[i];
+            if (!hasNormals)
+                corner.normal = UINT32_MAX;
+
+            u32 slot = HashObjCorner(corner) & (slotCount - 1);
+            while (slots[slot] != UINT32_MAX && !(vertices[slots[slot]] == corner))
+                slot = (slot + 1) & (slotCount - 1);
+
+            if (slots[slot] == UINT32_MAX)
+            {
+                slots[slot] = (u32)vertices.size();
+                vertices.push_back(corner);
+            }
+            *dstIndex++ = slots[slot];
+        }
+    }
+
+    const u32 vertexCount = (u32)vertices.size();
+    std::vector<vec3> positions(vertexCount);
+    std::vector<vec3> texCoords(hasTexCoords ? vertexCount : 0);
+    std::vector<vec3> normals;
+    for (u32 i = 0; i < vertexCount; ++i)
+    {
+        positions[i] = streams.positions[vertices[i].position];
+        if (hasTexCoords)
+            texCoords[i] = vertices[i].texCoord != UINT32_MAX ? streams.texCoords[vertices[i].texCoord] : vec3(0.0f);
+    }
+
+    if (hasNormals)
+    {
+        normals.resize(vertexCount);
+        for (u32 i = 0; i < vertexCount; ++i)
+            normals[i] = streams.normals[vertices[i].normal];
+    }
+    else
+    {
+        GenerateSmoothNormals(positions, indices, normals);
+    }
+
+    std::vector<vec3> tangents;
+    std::vector<vec3> bitangents;
+    if (hasTexCoords)
+        GenerateTangentSpace(vertexCount, positions.data(), texCoords.data(), normals.data(), indices.data(), cornerCount, tangents, bitangents);
+
+    VertexStreams vertexStreams = {};
+    vertexStreams.vertexCount = vertexCount;
+    vertexStreams.positions = positions.data();
+    vertexStreams.normals = normals.data();
+    vertexStreams.texCoords = hasTexCoords ? texCoords.data() : nullptr;
+    vertexStreams.tangents = hasTexCoords ? tangents.data() : nullptr;
+    vertexStreams.bitangents = hasTexCoords ? bitangents.data() : nullptr;
+    vertexStreams.flipBitangents = true;
+
+    BuildSubmeshVertices(vertexStreams, submesh);
+
+    submesh.indices.swap(indices);
+    submesh.indexCount = submesh.indices.size();
+    submesh.indexType = ChooseIndexType(vertexCount);
+}
+
+bool ImportObjSubmeshes(const char* filename, const std::string& directory, std::vector<Submesh>& submeshes,
+                        std::vector<u32>& submeshMaterials, std::vector<ImportedMaterial>& materials,
+                        std::vector<std::string>& materialLibraries)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    MappedFile file = MapFile(filename);
+    if (!file.data)
+        return false;
+
+    // Chunks end right after a line break, so no line is split between two of them
+    std::vector<ObjChunk> chunks;
+    const char* text = (const char*)file.data;
+    const char* textEnd = text + file.size;
+    for (const char* chunkBegin = text; chunkBegin < textEnd; )
+    {
+        const char* chunkEnd = (u64)(textEnd - chunkBegin) > OBJ_CHUNK_SIZE ? FindLineEnd(chunkBegin + OBJ_CHUNK_SIZE, textEnd) : textEnd;
+        chunkEnd = chunkEnd < textEnd ? chunkEnd + 1 : textEnd;
+
+        chunks.push_back(ObjChunk{});
+        chunks.back().begin = chunkBegin;
+        chunks.back().end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    ParallelFor(chunks.size(), [&](u32 i)
+    {
+        CountObjChunkVertices(chunks[i]);
+    });
+
+    ObjStreams streams;
+    u32 positionCount = 0;
+    u32 texCoordCount = 0;
+    u32 normalCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.firstPosition = positionCount;
+        chunk.firstTexCoord = texCoordCount;
+        chunk.firstNormal = normalCount;
+        positionCount += chunk.positionCount;
+        texCoordCount += chunk.texCoordCount;
+        normalCount += chunk.normalCount;
+    }
+    streams.positions.resize(positionCount);
+    streams.texCoords.resize(texCoordCount);
+    streams.normals.resize(normalCount);
+
+    ParallelFor(chunks.size(), [&](u32 i)
+    {
+        ParseObjChunk(chunks[i], streams);
+    });
+
+    // Before the validation, so the Assimp fallback still knows which MTL files the OBJ uses
+    materialLibraries.clear();
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (const std::string& library : chunk.materialLibraries)
+        {
+            const std::string libraryPath = directory + "/" + library;
+            if (std::find(materialLibraries.begin(), materialLibraries.end(), libraryPath) == materialLibraries.end())
+                materialLibraries.push_back(libraryPath);
+        }
+    }
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (chunk.invalid)
+        {
+            ELOG("Invalid face in %s", filename);
+            UnmapFile(file);
+            return false;
+        }
+    }
+
+    for (const std::string& libraryPath : materialLibraries)
+        ParseMtlFile(libraryPath, directory, materials);
+
+    std::unordered_map<std::string, u32> materialIndices;
+    for (u32 i = 0; i < materials.size(); ++i)
+        materialIndices.emplace(materials[i].name, i);
+
+    // Triangles are grouped per material in order of first use, as OptimizeMeshes merges
+    // every mesh sharing a material. Unknown materials get a default one, like in Assimp.
+    std::vector<std::vector<ObjCornerRange>> materialRanges;
+    std::vector<u32> submeshOfMaterial;
+    u32 currentMaterial = UINT32_MAX;
+    u32 defaultMaterial = UINT32_MAX;
+    for (const ObjChunk& chunk : chunks)
+    {
+        for (u32 runIdx = 0; runIdx < chunk.runs.size(); ++runIdx)
+        {
+            const ObjMaterialRun& run = chunk.runs[runIdx];
+            const u32 runEnd = runIdx + 1 < chunk.runs.size() ? chunk.runs[runIdx + 1].firstCorner : (u32)chunk.corners.size();
+
+            if (!run.inherited)
+            {
+                std::unordered_map<std::string, u32>::const_iterator it = materialIndices.find(run.material);
+                currentMaterial = it != materialIndices.end() ? it->second : UINT32_MAX;
+            }
+
+            if (run.firstCorner == runEnd)
+                continue;
+
+            if (currentMaterial == UINT32_MAX)
+            {
+                if (defaultMaterial == UINT32_MAX)
+                {
+                    materials.push_back(MakeDefaultObjMaterial("DefaultMaterial"));
+                    defaultMaterial = (u32)materials.size() - 1u;
+                }
+                currentMaterial = defaultMaterial;
+            }
+
+            if (currentMaterial >= submeshOfMaterial.size())
+                submeshOfMaterial.resize(currentMaterial + 1, UINT32_MAX);
+            if (submeshOfMaterial[currentMaterial] == UINT32_MAX)
+            {
+                submeshOfMaterial[currentMaterial] = (u32)materialRanges.size();
+                materialRanges.push_back(std::vector<ObjCornerRange>());
+                submeshMaterials.push_back(currentMaterial);
+            }
+
+            ObjCornerRange range = { &chunk, run.firstCorner, runEnd };
+            materialRanges[submeshOfMaterial[currentMaterial]].push_back(range);
+        }
+    }
+
+    submeshes.resize(materialRanges.size());
+    ParallelFor(materialRanges.size(), [&](u32 i)
+    {
+        BuildObjSubmesh(materialRanges[i], streams, submeshes[i]);
+    });
+
+    UnmapFile(file);
+
+    ILOG("Parsed %s: %u positions, %u submeshes in %.2f ms", filename, positionCount, (u32)submeshes.size(), GetElapsedMilliseconds(start));
+    return true;
+}
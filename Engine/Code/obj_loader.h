@@ -0,0 +1,26 @@
+//
+// obj_loader.h: Native Wavefront OBJ/MTL importer. The file is mapped and cut into
+// line-aligned chunks that are tokenized in parallel, then the face corners of every
+// material are welded into indexed submeshes. It builds the same submeshes the Assimp
+// path does (one per material, smooth normals and tangent space when the file has none)
+// without going through a generic scene graph, and ImportModel falls back to Assimp if
+// it fails.
+//
+
+#pragma once
+
+#include "assimp_model_loading.h"
+
+#define OBJ_CHUNK_SIZE          (64 * 1024) // Bytes of text per parse job, cut at the next line end
+#define OBJ_NORMAL_WELD_EPSILON 1e-4f       // Of the submesh bounds diagonal, as in Assimp's ComputePositionEpsilon
+
+/**
+ * Parses an OBJ file and the MTL libraries it names into one submesh per material, in
+ * order of first use. The submeshes only hold their vertices and full detail indices, the
+ * meshlets, LODs and optimizations are left to the caller. Only does CPU work, so it may
+ * run in any thread. Returns false if the file can't be read or has invalid indices;
+ * materialLibraries gets the paths of the MTL files it names even then.
+ */
+bool ImportObjSubmeshes(const char* filename, const std::string& directory, std::vector<Submesh>& submeshes,
+                        std::vector<u32>& submeshMaterials, std::vector<ImportedMaterial>& materials,
+                        std::vector<std::string>& materialLibraries);
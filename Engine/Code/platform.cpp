@@ -4,18 +4,9 @@
 // it needs in order to create the application (e.g. window, graphics context, I/O, allocators, etc).
 //
 
-#ifdef _WIN32
-#define VC_EXTRALEAN
-#define WIN32_LEAN_AND_MEAN
-#define _CRT_SECURE_NO_WARNINGS
-#include <Windows.h>
-#else
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#endif
-
 #include "engine.h"
+#include "job_system.h"
+#include "asset_database.h"
 
 #include <GLFW/glfw3.h>
 #include <stdio.h>
@@ -219,6 +210,8 @@ int main()
 
     GlobalFrameArenaMemory = (u8*)malloc(GLOBAL_FRAME_ARENA_SIZE);
 
+    InitJobSystem();
+
     Init(&app);
 
     while (app.isRunning)
@@ -282,6 +275,9 @@ int main()
         GlobalFrameArenaHead = 0;
     }
 
+    ShutdownJobSystem();
+    SaveAssetDatabase();
+
     free(GlobalFrameArenaMemory);
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -394,37 +390,3 @@ String ReadTextFile(const char* filepath)
 
     return fileText;
 }
-
-u64 GetFileLastWriteTimestamp(const char* filepath)
-{
-#ifdef _WIN32
-    union Filetime2u64 {
-        FILETIME filetime;
-        u64      u64time;
-    } conversor;
-
-    WIN32_FILE_ATTRIBUTE_DATA Data;
-    if(GetFileAttributesExA(filepath, GetFileExInfoStandard, &Data)) {
-        conversor.filetime = Data.ftLastWriteTime;
-        return(conversor.u64time);
-    }
-#else
-    // NOTE: This has not been tested in unix-like systems
-    struct stat attrib;
-    if (stat(filepath, &attrib) == 0) {
-        return attrib.st_mtime;
-    }
-#endif
-
-    return 0;
-}
-
-void LogString(const char* str)
-{
-#ifdef _WIN32
-    OutputDebugStringA(str);
-    OutputDebugStringA("\n");
-#else
-    fprintf(stderr, "%s\n", str);
-#endif
-}
@@ -81,12 +81,50 @@ String ReadTextFile(const char *filepath);
  */
 u64 GetFileLastWriteTimestamp(const char *filepath);
 
+struct MappedFile
+{
+    u8*   data;
+    u64   size;
+    void* fileHandle;
+    void* mappingHandle;
+};
+
+/**
+ * Maps a whole file into memory as read-only pages. The returned data pointer is
+ * NULL if the file could not be opened. Call UnmapFile once the contents are no
+ * longer needed.
+ */
+MappedFile MapFile(const char *filepath);
+
+void UnmapFile(MappedFile& file);
+
+/**
+ * Writes a whole buffer into a file, replacing its previous contents.
+ */
+bool WriteBinaryFile(const char *filepath, const void *data, u64 size);
+
+/**
+ * Creates a directory unless it already exists. Returns false if it couldn't be created.
+ */
+bool MakeDirectory(const char *path);
+
+/**
+ * Deletes a file. Returns false if it couldn't be deleted, e.g. while it is mapped on Windows.
+ */
+bool RemoveFile(const char *filepath);
+
 /**
  * It logs a string to whichever outputs are configured in the platform layer.
  * By default, the string is printed in the output console of VisualStudio.
  */
 void LogString(const char* str);
 
+/**
+ * Returns the peak resident memory of the process so far in bytes, or 0 if the OS
+ * doesn't report it.
+ */
+u64 GetPeakMemoryUsage();
+
 #define ILOG(...)                 \
 {                                 \
 char logBuffer[1024] = {};        \
@@ -0,0 +1,181 @@
+//
+// platform_os.cpp: The part of the platform layer that talks to the OS but not to the
+// window or the graphics context (files, logging, process stats), so tools that only do
+// CPU work, like the import benchmark, can link it without GLFW.
+//
+
+#ifdef _WIN32
+#define VC_EXTRALEAN
+#define WIN32_LEAN_AND_MEAN
+#define _CRT_SECURE_NO_WARNINGS
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include "platform.h"
+
+u64 GetFileLastWriteTimestamp(const char* filepath)
+{
+#ifdef _WIN32
+    union Filetime2u64 {
+        FILETIME filetime;
+        u64      u64time;
+    } conversor;
+
+    WIN32_FILE_ATTRIBUTE_DATA Data;
+    if(GetFileAttributesExA(filepath, GetFileExInfoStandard, &Data)) {
+        conversor.filetime = Data.ftLastWriteTime;
+        return(conversor.u64time);
+    }
+#else
+    // NOTE: This has not been tested in unix-like systems
+    struct stat attrib;
+    if (stat(filepath, &attrib) == 0) {
+        return attrib.st_mtime;
+    }
+#endif
+
+    return 0;
+}
+
+MappedFile MapFile(const char* filepath)
+{
+    MappedFile file = {};
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle == NULL)
+    {
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    file.data = (u8*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (file.data == NULL)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    file.size = (u64)fileSize.QuadPart;
+    file.fileHandle = fileHandle;
+    file.mappingHandle = mappingHandle;
+#else
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return file;
+
+    struct stat attrib;
+    if (fstat(fd, &attrib) != 0 || attrib.st_size == 0)
+    {
+        close(fd);
+        return file;
+    }
+
+    void* data = mmap(NULL, attrib.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return file;
+
+    file.data = (u8*)data;
+    file.size = (u64)attrib.st_size;
+#endif
+
+    return file;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (file.data == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+    CloseHandle((HANDLE)file.mappingHandle);
+    CloseHandle((HANDLE)file.fileHandle);
+#else
+    munmap(file.data, file.size);
+#endif
+
+    file = {};
+}
+
+bool WriteBinaryFile(const char* filepath, const void* data, u64 size)
+{
+    FILE* file = fopen(filepath, "wb");
+    if (!file)
+    {
+        ELOG("fopen() failed writing file %s", filepath);
+        return false;
+    }
+
+    bool success = fwrite(data, 1, size, file) == size;
+    fclose(file);
+
+    if (!success)
+    {
+        ELOG("fwrite() failed writing file %s", filepath);
+    }
+
+    return success;
+}
+
+bool MakeDirectory(const char* path)
+{
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat attrib;
+    return mkdir(path, 0755) == 0 || (stat(path, &attrib) == 0 && S_ISDIR(attrib.st_mode));
+#endif
+}
+
+bool RemoveFile(const char* filepath)
+{
+    return remove(filepath) == 0;
+}
+
+void LogString(const char* str)
+{
+#ifdef _WIN32
+    OutputDebugStringA(str);
+    OutputDebugStringA("\n");
+#else
+    fprintf(stderr, "%s\n", str);
+#endif
+}
+
+u64 GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (u64)counters.PeakWorkingSetSize;
+#else
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (u64)usage.ru_maxrss * 1024;
+#endif
+
+    return 0;
+}
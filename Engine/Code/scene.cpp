@@ -0,0 +1,193 @@
+#include "scene.h"
+#include "buffer_management.h"
+#include "asset_streaming.h"
+
+#include <chrono>
+
+static f64 GetElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool SaveScene(App* app, const char* filepath)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const u32 entityCount = app->enTities.size();
+
+    SceneFileHeader header = {};
+    header.magic = SCENE_FILE_MAGIC;
+    header.version = SCENE_FILE_VERSION;
+    header.modelCount = app->models.size();
+    header.entityCount = entityCount;
+    header.lightCount = app->lights.size();
+    header.modelTableOffset = Align(sizeof(SceneFileHeader), 16);
+    header.positionsOffset = Align(header.modelTableOffset + header.modelCount * sizeof(SceneModel), 16);
+    header.rotationsOffset = Align(header.positionsOffset + entityCount * sizeof(vec3), 16);
+    header.scalesOffset = Align(header.rotationsOffset + entityCount * sizeof(vec3), 16);
+    header.worldMatricesOffset = Align(header.scalesOffset + entityCount * sizeof(vec3), 16);
+    header.modelsOffset = Align(header.worldMatricesOffset + entityCount * sizeof(mat4), 16);
+    header.lightTableOffset = Align(header.modelsOffset + entityCount * sizeof(u32), 16);
+    header.cameraPos = app->camera.pos;
+    header.cameraAngles = app->camera.angles;
+    header.cameraTarget = app->camera.target;
+    header.cameraFovY = app->camera.fovY;
+    header.cameraZNear = app->camera.zNear;
+    header.cameraZFar = app->camera.zFar;
+
+    std::vector<u8> bytes(header.lightTableOffset + header.lightCount * sizeof(SceneLight), 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+
+    // The whole model table is written, so entity model indices are stored as they are
+    SceneModel* models = (SceneModel*)(bytes.data() + header.modelTableOffset);
+    for (u32 i = 0; i < header.modelCount; ++i)
+    {
+        strncpy(models[i].name, app->models[i].name.c_str(), SCENE_MAX_MODEL_NAME - 1);
+        models[i].name[SCENE_MAX_MODEL_NAME - 1] = '\0';
+        models[i].loadFlags = app->models[i].loadFlags;
+    }
+
+    vec3* positions = (vec3*)(bytes.data() + header.positionsOffset);
+    vec3* rotations = (vec3*)(bytes.data() + header.rotationsOffset);
+    vec3* scales = (vec3*)(bytes.data() + header.scalesOffset);
+    mat4* worldMatrices = (mat4*)(bytes.data() + header.worldMatricesOffset);
+    u32* modelIndices = (u32*)(bytes.data() + header.modelsOffset);
+    for (u32 i = 0; i < entityCount; ++i)
+    {
+        const Entity& entity = app->enTities[i];
+        positions[i] = entity.pos;
+        rotations[i] = entity.rotAngle;
+        scales[i] = entity.scale;
+        worldMatrices[i] = entity.worldMatrix;
+        modelIndices[i] = entity.modelIdx;
+    }
+
+    SceneLight* lights = (SceneLight*)(bytes.data() + header.lightTableOffset);
+    for (u32 i = 0; i < header.lightCount; ++i)
+    {
+        const Light& light = app->lights[i];
+        lights[i].type = (u32)light.type;
+        lights[i].col = light.col;
+        lights[i].dir = light.dir;
+        lights[i].pos = light.pos;
+        lights[i].range = light.range;
+        lights[i].attenuation = light.attenuation;
+        lights[i].worldMatrix = light.worldMatrix;
+    }
+
+    if (!WriteBinaryFile(filepath, bytes.data(), bytes.size()))
+    {
+        ELOG("Could not write scene %s", filepath);
+        return false;
+    }
+
+    ILOG("Saved scene %s: %u entities, %u lights in %.2f ms", filepath, entityCount, header.lightCount, GetElapsedMilliseconds(start));
+    return true;
+}
+
+static bool IsSceneFileValid(const MappedFile& file)
+{
+    if (file.size < sizeof(SceneFileHeader))
+        return false;
+
+    const SceneFileHeader* header = (const SceneFileHeader*)file.data;
+    if (header->magic != SCENE_FILE_MAGIC || header->version != SCENE_FILE_VERSION)
+        return false;
+
+    const u64 entityCount = header->entityCount;
+    return (u64)header->modelTableOffset + header->modelCount * sizeof(SceneModel) <= file.size &&
+           (u64)header->positionsOffset + entityCount * sizeof(vec3) <= file.size &&
+           (u64)header->rotationsOffset + entityCount * sizeof(vec3) <= file.size &&
+           (u64)header->scalesOffset + entityCount * sizeof(vec3) <= file.size &&
+           (u64)header->worldMatricesOffset + entityCount * sizeof(mat4) <= file.size &&
+           (u64)header->modelsOffset + entityCount * sizeof(u32) <= file.size &&
+           (u64)header->lightTableOffset + header->lightCount * sizeof(SceneLight) <= file.size;
+}
+
+// Index of the app model a scene model refers to, loading it if it isn't there yet
+static u32 ResolveSceneModel(App* app, const SceneModel& sceneModel)
+{
+    std::string name(sceneModel.name, strnlen(sceneModel.name, SCENE_MAX_MODEL_NAME));
+    for (u32 modelIdx = 0; modelIdx < app->models.size(); ++modelIdx)
+        if (app->models[modelIdx].name == name && app->models[modelIdx].loadFlags == sceneModel.loadFlags)
+            return modelIdx;
+
+    return LoadModelAsync(app, name.c_str(), sceneModel.loadFlags);
+}
+
+bool LoadScene(App* app, const char* filepath)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    MappedFile file = MapFile(filepath);
+    if (!file.data)
+        return false;
+
+    if (!IsSceneFileValid(file))
+    {
+        ELOG("Scene %s is invalid or from another version", filepath);
+        UnmapFile(file);
+        return false;
+    }
+
+    const SceneFileHeader* header = (const SceneFileHeader*)file.data;
+    const SceneModel*      models = (const SceneModel*)(file.data + header->modelTableOffset);
+
+    // Models are resolved once per table entry, not per entity
+    std::vector<u32> modelRemap(header->modelCount);
+    for (u32 i = 0; i < header->modelCount; ++i)
+        modelRemap[i] = ResolveSceneModel(app, models[i]);
+
+    const vec3* positions = (const vec3*)(file.data + header->positionsOffset);
+    const vec3* rotations = (const vec3*)(file.data + header->rotationsOffset);
+    const vec3* scales = (const vec3*)(file.data + header->scalesOffset);
+    const mat4* worldMatrices = (const mat4*)(file.data + header->worldMatricesOffset);
+    const u32*  modelIndices = (const u32*)(file.data + header->modelsOffset);
+
+    app->currentEntity = nullptr;
+    app->enTities.clear();
+    app->enTities.reserve(header->entityCount);
+    for (u32 i = 0; i < header->entityCount; ++i)
+    {
+        if (modelIndices[i] >= header->modelCount)
+            continue;
+
+        Entity entity;
+        entity.pos = positions[i];
+        entity.rotAngle = rotations[i];
+        entity.scale = scales[i];
+        entity.worldMatrix = worldMatrices[i];
+        entity.modelIdx = modelRemap[modelIndices[i]];
+        entity.localParamsOffset = 0;
+        entity.localParamsSize = 0;
+        app->enTities.push_back(entity);
+    }
+
+    const SceneLight* lights = (const SceneLight*)(file.data + header->lightTableOffset);
+
+    app->currentLight = -1;
+    app->lights.resize(header->lightCount);
+    for (u32 i = 0; i < header->lightCount; ++i)
+    {
+        Light& light = app->lights[i];
+        light.type = (LightType)lights[i].type;
+        light.col = lights[i].col;
+        light.dir = lights[i].dir;
+        light.pos = lights[i].pos;
+        light.range = lights[i].range;
+        light.attenuation = lights[i].attenuation;
+        light.worldMatrix = lights[i].worldMatrix;
+    }
+
+    app->camera.pos = header->cameraPos;
+    app->camera.angles = header->cameraAngles;
+    app->camera.target = header->cameraTarget;
+    app->camera.fovY = header->cameraFovY;
+    app->camera.zNear = header->cameraZNear;
+    app->camera.zFar = header->cameraZFar;
+
+    ILOG("Loaded scene %s: %u entities, %u lights in %.2f ms", filepath, (u32)app->enTities.size(), header->lightCount, GetElapsedMilliseconds(start));
+
+    UnmapFile(file);
+    return true;
+}
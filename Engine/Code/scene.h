@@ -0,0 +1,67 @@
+//
+// scene.h: Binary scene files holding the entities, the lights and the camera. The entity
+// data is stored as one array per field, so saving and loading are a handful of tight
+// loops over a single mapped file, with no parsing and no per-entity allocations.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define SCENE_FILE_MAGIC    0x454E4353 // "SCNE"
+#define SCENE_FILE_VERSION  2
+#define SCENE_FILE_PATH     "scene.bin"
+#define SCENE_MAX_MODEL_NAME 256
+
+struct SceneFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 modelCount;
+    u32 entityCount;
+    u32 lightCount;
+    u32 modelTableOffset;    // SceneModel entries, referenced by index from the entities
+    u32 positionsOffset;     // One vec3 per entity
+    u32 rotationsOffset;     // One vec3 per entity, Euler angles in degrees
+    u32 scalesOffset;        // One vec3 per entity
+    u32 worldMatricesOffset; // One mat4 per entity, as computed from the three above
+    u32 modelsOffset;        // One u32 per entity, into the model table
+    u32 lightTableOffset;    // SceneLight entries
+    vec3 cameraPos;
+    vec3 cameraAngles;
+    vec3 cameraTarget;
+    f32  cameraFovY;
+    f32  cameraZNear;
+    f32  cameraZFar;
+};
+
+// Models are referenced by their source file, or the name of the generated mesh, and the
+// flags they were loaded with
+struct SceneModel
+{
+    char name[SCENE_MAX_MODEL_NAME];
+    u32  loadFlags;
+};
+
+struct SceneLight
+{
+    u32  type;
+    vec3 col;
+    vec3 dir;
+    vec3 pos;
+    f32  range;
+    vec3 attenuation;
+    mat4 worldMatrix;
+};
+
+/**
+ * Writes the entities, the lights and the camera of the app to a scene file.
+ */
+bool SaveScene(App* app, const char* filepath);
+
+/**
+ * Replaces the entities, the lights and the camera with the ones in a scene file. Models
+ * the app doesn't have yet are streamed in. Returns false, leaving the scene untouched,
+ * if the file is missing or invalid.
+ */
+bool LoadScene(App* app, const char* filepath);
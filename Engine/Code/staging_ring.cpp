@@ -0,0 +1,170 @@
+#include "staging_ring.h"
+#include "buffer_management.h"
+
+#include <deque>
+
+// Where a frame's writes end in the ring, and the bytes they took (alignment and the
+// space skipped when wrapping around included)
+struct StagingFrame
+{
+    GLsync fence;
+    u32    end;
+    u32    bytes;
+};
+
+struct StagingRing
+{
+    GLuint                   handle;
+    u32                      capacity;
+    u32                      head;       // Next write goes here or after
+    u32                      tail;       // Start of the oldest data the GPU may still read
+    u32                      usedBytes;  // Between tail and head, the current frame included
+    u32                      frameBytes; // Written since the last fence
+    u32                      frameBudget;
+    std::deque<StagingFrame> frames;     // Fenced, oldest first
+};
+
+static StagingRing GlobalStagingRing;
+
+static void InitStagingRing(StagingRing& ring)
+{
+    glGenBuffers(1, &ring.handle);
+    glBindBuffer(GL_COPY_READ_BUFFER, ring.handle);
+    glBufferData(GL_COPY_READ_BUFFER, STAGING_RING_SIZE, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    ring.capacity = STAGING_RING_SIZE;
+    ring.head = 0;
+    ring.tail = 0;
+    ring.usedBytes = 0;
+    ring.frameBytes = 0;
+}
+
+static void RetireStagingFrames(StagingRing& ring)
+{
+    while (!ring.frames.empty())
+    {
+        StagingFrame& frame = ring.frames.front();
+        GLenum status = glClientWaitSync(frame.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(frame.fence);
+        ring.tail = frame.end;
+        ring.usedBytes -= frame.bytes;
+        ring.frames.pop_front();
+    }
+
+    // Nothing in flight, so the next write may start at the beginning and not wrap
+    if (ring.usedBytes == 0)
+        ring.head = ring.tail = 0;
+}
+
+// Largest write that fits at once, the tail side when the ring would have to wrap
+static u32 GetContiguousSpace(const StagingRing& ring)
+{
+    if (ring.usedBytes == 0)
+        return ring.capacity;
+
+    const u32 head = Align(ring.head, STAGING_RING_ALIGNMENT);
+    if (ring.head > ring.tail)
+        return glm::max(ring.capacity - glm::min(head, ring.capacity), ring.tail);
+
+    return ring.tail - glm::min(head, ring.tail);
+}
+
+// Offset for size bytes, or UINT32_MAX if they would overwrite data still in flight
+static u32 AllocateStagingRange(StagingRing& ring, u32 size)
+{
+    const u32 head = Align(ring.head, STAGING_RING_ALIGNMENT);
+
+    u32 offset = UINT32_MAX;
+    if (ring.usedBytes == 0 || ring.head > ring.tail)
+    {
+        if ((u64)head + size <= ring.capacity)
+            offset = head;
+        else if (size <= ring.tail)
+            offset = 0;
+    }
+    else if ((u64)head + size <= ring.tail)
+    {
+        offset = head;
+    }
+
+    if (offset == UINT32_MAX)
+        return UINT32_MAX;
+
+    const u32 bytes = (offset == 0 && ring.usedBytes > 0 ? ring.capacity - ring.head : offset - ring.head) + size;
+    ring.head = offset + size;
+    ring.usedBytes += bytes;
+    ring.frameBytes += bytes;
+    return offset;
+}
+
+void BeginStagingFrame(u32 frameBudget)
+{
+    StagingRing& ring = GlobalStagingRing;
+    if (ring.handle == 0)
+        InitStagingRing(ring);
+
+    RetireStagingFrames(ring);
+    ring.frameBudget = frameBudget;
+}
+
+void FenceStagingFrame()
+{
+    StagingRing& ring = GlobalStagingRing;
+    if (ring.frameBytes == 0)
+        return;
+
+    StagingFrame frame = {};
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame.end = ring.head;
+    frame.bytes = ring.frameBytes;
+    ring.frames.push_back(frame);
+    ring.frameBytes = 0;
+}
+
+u32 GetStagingSpace()
+{
+    StagingRing& ring = GlobalStagingRing;
+    if (ring.handle == 0)
+        return 0;
+
+    const u32 budgetLeft = ring.frameBudget - glm::min(ring.frameBytes, ring.frameBudget);
+    return glm::min(GetContiguousSpace(ring), budgetLeft);
+}
+
+u32 WriteStagingData(const void* data, u32 size)
+{
+    StagingRing& ring = GlobalStagingRing;
+    if (ring.handle == 0)
+        InitStagingRing(ring);
+
+    const u32 offset = AllocateStagingRange(ring, size);
+    if (offset == UINT32_MAX)
+        return UINT32_MAX;
+
+    // The range is known to be free of GPU reads, so the driver doesn't need to sync
+    glBindBuffer(GL_COPY_READ_BUFFER, ring.handle);
+    void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped)
+    {
+        memcpy(mapped, data, size);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    return mapped ? offset : UINT32_MAX;
+}
+
+GLuint GetStagingBuffer()
+{
+    return GlobalStagingRing.handle;
+}
+
+void GetStagingRingUsage(u64& usedBytes, u64& capacityBytes)
+{
+    usedBytes = GlobalStagingRing.usedBytes;
+    capacityBytes = GlobalStagingRing.capacity;
+}
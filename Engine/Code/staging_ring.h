@@ -0,0 +1,46 @@
+//
+// staging_ring.h: One GPU staging buffer used as a ring by every upload. Data is written
+// into the free part of the ring through unsynchronized mappings and then copied on the
+// GPU, with glCopyBufferSubData into the geometry buffers or as the pixel unpack buffer of
+// the texture uploads, so the driver never has to hold on to the caller's memory or wait
+// for a buffer the GPU is reading. Each frame's writes are fenced, and their part of the
+// ring is reused once the fence has passed.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define STAGING_RING_SIZE      (16 * 1024 * 1024) // Room for a few frames of the largest upload budget
+#define STAGING_RING_ALIGNMENT 16                 // Of every write, enough for any copy or unpack offset
+
+/**
+ * Retires the frames the GPU is done with and sets how many bytes the streaming may stage
+ * during this frame. Call once per frame before any upload.
+ */
+void BeginStagingFrame(u32 frameBudget);
+
+/**
+ * Fences the writes of the frame, after all the copies that read them were issued.
+ */
+void FenceStagingFrame();
+
+/**
+ * Bytes that can be staged in one write right now, within the frame budget and without
+ * waiting for the GPU. Streaming clamps its uploads to it and resumes next frame at 0.
+ */
+u32 GetStagingSpace();
+
+/**
+ * Copies size bytes into the ring and returns their offset in the staging buffer, or
+ * UINT32_MAX if they don't fit right now. Loads that can't wait (it doesn't check the
+ * frame budget) then upload directly instead.
+ */
+u32 WriteStagingData(const void* data, u32 size);
+
+GLuint GetStagingBuffer();
+
+/**
+ * Bytes of the ring waiting for the GPU, and its size.
+ */
+void GetStagingRingUsage(u64& usedBytes, u64& capacityBytes);
@@ -0,0 +1,70 @@
+#include "text_parsing.h"
+
+static const f64 PowersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Up to 18 significant digits are kept, which is plenty for a float and for the integers
+// JSON stores as numbers
+const char* ParseDecimal(const char* p, const char* end, f64& value)
+{
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    bool hasDigits = false;
+    u64 mantissa = 0;
+    i32 exponent = 0;
+    for (; p < end && IsDigit(*p); ++p)
+    {
+        hasDigits = true;
+        if (mantissa < 100000000000000000ull)
+            mantissa = mantissa * 10 + (*p - '0');
+        else
+            ++exponent;
+    }
+
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && IsDigit(*p); ++p)
+        {
+            hasDigits = true;
+            if (mantissa < 100000000000000000ull)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+        }
+    }
+
+    if (!hasDigits)
+        return start;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+
+        i32 explicitExponent = 0;
+        for (; p < end && IsDigit(*p); ++p)
+            if (explicitExponent < 1000)
+                explicitExponent = explicitExponent * 10 + (*p - '0');
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    f64 result = (f64)mantissa;
+    for (; exponent > 22; exponent -= 22)
+        result *= 1e22;
+    for (; exponent < -22; exponent += 22)
+        result /= 1e22;
+    result = exponent >= 0 ? result * PowersOf10[exponent] : result / PowersOf10[-exponent];
+
+    value = negative ? -result : result;
+    return p;
+}
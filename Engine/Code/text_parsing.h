@@ -0,0 +1,21 @@
+//
+// text_parsing.h: Number parsing shared by the text formats the native importers read
+// (OBJ, MTL and the JSON chunk of GLB files). It works on bounded ranges of mapped files,
+// which aren't null terminated, and doesn't depend on the C locale as strtod does.
+//
+
+#pragma once
+
+#include "engine.h"
+
+inline bool IsDigit(char c)
+{
+    return (u32)(c - '0') < 10u;
+}
+
+/**
+ * Parses a decimal number with an optional sign, fraction and exponent from [p, end),
+ * without skipping leading blanks. Returns where the number ends, p itself if there
+ * are no digits.
+ */
+const char* ParseDecimal(const char* p, const char* end, f64& value);
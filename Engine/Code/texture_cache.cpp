@@ -0,0 +1,94 @@
+#include "texture_cache.h"
+#include "buffer_management.h"
+#include "asset_database.h"
+
+static bool IsTextureCacheValid(const MappedFile& file, u64 sourceKey, TextureUsage usage)
+{
+    if (file.size < sizeof(TextureCacheHeader))
+        return false;
+
+    const TextureCacheHeader* header = (const TextureCacheHeader*)file.data;
+
+    if (header->magic != TEXTURE_CACHE_MAGIC ||
+        header->version != TEXTURE_CACHE_VERSION ||
+        header->sourceKey != sourceKey ||
+        header->usage != (u32)usage ||
+        header->levelCount == 0 ||
+        header->levelCount > TEXTURE_CACHE_MAX_LEVELS)
+        return false;
+
+    const u64 levelTableEnd = (u64)header->levelTableOffset + (u64)header->levelCount * sizeof(TextureLevel);
+    const u64 dataEnd       = (u64)header->dataOffset + header->dataSize;
+    if (levelTableEnd > file.size || dataEnd > file.size)
+        return false;
+
+    const TextureLevel* levels = (const TextureLevel*)(file.data + header->levelTableOffset);
+    for (u32 i = 0; i < header->levelCount; ++i)
+        if ((u64)levels[i].offset + levels[i].dataSize > header->dataSize)
+            return false;
+
+    return true;
+}
+
+bool ReadTextureCache(const char* filename, TextureUsage usage, CookedTexture& texture)
+{
+    const u64 sourceKey = GetAssetCookKey(filename, AssetType_Texture, usage);
+    if (sourceKey == 0)
+        return false;
+
+    std::string cachePath = GetCookedAssetPath(sourceKey, TEXTURE_CACHE_EXTENSION);
+    MappedFile file = MapFile(cachePath.c_str());
+    if (!file.data)
+        return false;
+
+    if (!IsTextureCacheValid(file, sourceKey, usage))
+    {
+        ILOG("Texture cache %s is out of date", cachePath.c_str());
+        UnmapFile(file);
+        return false;
+    }
+
+    const TextureCacheHeader* header = (const TextureCacheHeader*)file.data;
+    const TextureLevel*       levels = (const TextureLevel*)(file.data + header->levelTableOffset);
+
+    texture.internalFormat = header->internalFormat;
+    texture.levels.assign(levels, levels + header->levelCount);
+    texture.data.assign(file.data + header->dataOffset, file.data + header->dataOffset + header->dataSize);
+
+    UnmapFile(file);
+
+    RecordAssetCook(filename, AssetType_Texture, usage, sourceKey);
+    return true;
+}
+
+bool WriteTextureCache(const char* filename, TextureUsage usage, const CookedTexture& texture)
+{
+    const u64 sourceKey = GetAssetCookKey(filename, AssetType_Texture, usage);
+    if (sourceKey == 0)
+        return false;
+
+    ASSERT(texture.levels.size() <= TEXTURE_CACHE_MAX_LEVELS, "Too many mip levels for the texture cache");
+
+    TextureCacheHeader header = {};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceKey = sourceKey;
+    header.usage = usage;
+    header.internalFormat = texture.internalFormat;
+    header.levelCount = texture.levels.size();
+    header.levelTableOffset = sizeof(TextureCacheHeader);
+    header.dataOffset = Align(header.levelTableOffset + header.levelCount * sizeof(TextureLevel), 16);
+    header.dataSize = texture.data.size();
+
+    std::vector<u8> bytes(header.dataOffset + header.dataSize, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(bytes.data() + header.levelTableOffset, texture.levels.data(), texture.levels.size() * sizeof(TextureLevel));
+    memcpy(bytes.data() + header.dataOffset, texture.data.data(), texture.data.size());
+
+    std::string cachePath = GetCookedAssetPath(sourceKey, TEXTURE_CACHE_EXTENSION);
+    if (!WriteBinaryFile(cachePath.c_str(), bytes.data(), bytes.size()))
+        return false;
+
+    RecordAssetCook(filename, AssetType_Texture, usage, sourceKey);
+    return true;
+}
@@ -0,0 +1,36 @@
+//
+// texture_cache.h: Cooked binary copies of textures. A cooked file holds every mip level
+// of a texture already block compressed, so warm starts skip both the image decoding and
+// the encoding and upload the levels as they are. Textures with the same contents and
+// usage share one file in the cooked asset directory.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define TEXTURE_CACHE_MAGIC      0x43584554 // "TEXC"
+#define TEXTURE_CACHE_VERSION    3
+#define TEXTURE_CACHE_EXTENSION  ".tcache"
+#define TEXTURE_CACHE_MAX_LEVELS 16
+
+struct TextureCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceKey;        // GetAssetCookKey of the source, also the file name
+    u32 usage;            // TextureUsage the texture was cooked for
+    u32 internalFormat;
+    u32 levelCount;
+    u32 levelTableOffset; // TextureLevel entries, largest level first
+    u32 dataOffset;
+    u32 dataSize;
+};
+
+/**
+ * Reads a texture from its cooked file if there is one for the current contents of the
+ * source, the usage and the format version. Safe to call from any thread.
+ */
+bool ReadTextureCache(const char* filename, TextureUsage usage, CookedTexture& texture);
+
+bool WriteTextureCache(const char* filename, TextureUsage usage, const CookedTexture& texture);
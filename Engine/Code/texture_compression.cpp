@@ -0,0 +1,215 @@
+#include "texture_compression.h"
+#include "job_system.h"
+
+#include <cfloat>
+
+#define TEXELS_PER_BLOCK (TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE)
+
+GLenum GetTextureFormatGL(TextureFormat format)
+{
+    switch (format)
+    {
+        case TextureFormat_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureFormat_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureFormat_BC4: return GL_COMPRESSED_RED_RGTC1;
+        case TextureFormat_BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: ASSERT(false, "Unknown texture format"); return GL_NONE;
+    }
+}
+
+u32 GetTextureBlockBytes(TextureFormat format)
+{
+    return (format == TextureFormat_BC1 || format == TextureFormat_BC4) ? 8 : 16;
+}
+
+u32 GetCompressedLevelSize(TextureFormat format, ivec2 size)
+{
+    const u32 blocksX = (size.x + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+    const u32 blocksY = (size.y + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+    return blocksX * blocksY * GetTextureBlockBytes(format);
+}
+
+static u16 PackRgb565(vec3 color)
+{
+    u32 r = (u32)glm::clamp(color.r * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+    u32 g = (u32)glm::clamp(color.g * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f);
+    u32 b = (u32)glm::clamp(color.b * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static vec3 UnpackRgb565(u16 color)
+{
+    u32 r = (color >> 11) & 31;
+    u32 g = (color >> 5) & 63;
+    u32 b = color & 31;
+    return vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// BC1 color block: two 565 endpoints along the principal axis of the texels, and a
+// 2-bit index per texel into the 4 colors between them
+static void EncodeColorBlock(const u8 texels[TEXELS_PER_BLOCK][4], u8* block)
+{
+    vec3 colors[TEXELS_PER_BLOCK];
+    vec3 mean = vec3(0.0f);
+    for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+    {
+        colors[i] = vec3(texels[i][0], texels[i][1], texels[i][2]);
+        mean += colors[i];
+    }
+    mean /= (f32)TEXELS_PER_BLOCK;
+
+    f32 cov[6] = {};
+    for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+    {
+        vec3 d = colors[i] - mean;
+        cov[0] += d.r * d.r; cov[1] += d.r * d.g; cov[2] += d.r * d.b;
+        cov[3] += d.g * d.g; cov[4] += d.g * d.b; cov[5] += d.b * d.b;
+    }
+
+    // A few power iterations are enough to find the dominant axis of a 4x4 block
+    vec3 axis = vec3(1.0f);
+    for (u32 iteration = 0; iteration < 4; ++iteration)
+    {
+        vec3 next = vec3(cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                         cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                         cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+        f32 largest = glm::max(glm::abs(next.r), glm::max(glm::abs(next.g), glm::abs(next.b)));
+        if (largest < 1e-6f)
+            break;
+        axis = next / largest;
+    }
+    axis = glm::normalize(axis);
+
+    f32 minT = FLT_MAX, maxT = -FLT_MAX;
+    for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+    {
+        f32 t = glm::dot(colors[i] - mean, axis);
+        minT = glm::min(minT, t);
+        maxT = glm::max(maxT, t);
+    }
+
+    // Pull the endpoints in a bit, the extremes are rarely worth an exact match
+    const f32 inset = (maxT - minT) / 16.0f;
+    u16 color0 = PackRgb565(mean + axis * (maxT - inset));
+    u16 color1 = PackRgb565(mean + axis * (minT + inset));
+
+    // color0 > color1 selects the 4 color mode, color0 == color1 means a solid block
+    if (color0 < color1)
+    {
+        u16 swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    u32 indices = 0;
+    if (color0 != color1)
+    {
+        vec3 palette[4];
+        palette[0] = UnpackRgb565(color0);
+        palette[1] = UnpackRgb565(color1);
+        palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+        palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+        for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+        {
+            u32 best = 0;
+            f32 bestDistance = FLT_MAX;
+            for (u32 p = 0; p < 4; ++p)
+            {
+                vec3 d = colors[i] - palette[p];
+                f32 distance = glm::dot(d, d);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    memcpy(block + 0, &color0, sizeof(color0));
+    memcpy(block + 2, &color1, sizeof(color1));
+    memcpy(block + 4, &indices, sizeof(indices));
+}
+
+// BC4 channel block: the channel's min and max as endpoints, and a 3-bit index per texel
+// into the 8 values between them
+static void EncodeChannelBlock(const u8 texels[TEXELS_PER_BLOCK][4], u32 channel, u8* block)
+{
+    u8 minValue = 255, maxValue = 0;
+    for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+    {
+        minValue = glm::min(minValue, texels[i][channel]);
+        maxValue = glm::max(maxValue, texels[i][channel]);
+    }
+
+    // value0 > value1 selects the 8 value mode
+    block[0] = maxValue;
+    block[1] = minValue;
+
+    u64 indices = 0;
+    if (maxValue != minValue)
+    {
+        const f32 scale = 7.0f / (f32)(maxValue - minValue);
+        for (u32 i = 0; i < TEXELS_PER_BLOCK; ++i)
+        {
+            // Steps from the min (0) to the max (7), mapped to the index order of the palette
+            u32 step = (u32)((texels[i][channel] - minValue) * scale + 0.5f);
+            u64 index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (3 * i);
+        }
+    }
+
+    for (u32 i = 0; i < 6; ++i)
+        block[2 + i] = (u8)(indices >> (8 * i));
+}
+
+static void EncodeBlock(const u8 texels[TEXELS_PER_BLOCK][4], TextureFormat format, u8* block)
+{
+    switch (format)
+    {
+        case TextureFormat_BC1:
+            EncodeColorBlock(texels, block);
+            break;
+        case TextureFormat_BC3:
+            EncodeChannelBlock(texels, 3, block);
+            EncodeColorBlock(texels, block + 8);
+            break;
+        case TextureFormat_BC4:
+            EncodeChannelBlock(texels, 0, block);
+            break;
+        case TextureFormat_BC5:
+            EncodeChannelBlock(texels, 0, block);
+            EncodeChannelBlock(texels, 1, block + 8);
+            break;
+        default:
+            ASSERT(false, "Unknown texture format");
+    }
+}
+
+void CompressImage(const u8* rgba, ivec2 size, TextureFormat format, u8* blocks)
+{
+    const u32 blocksX = (size.x + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+    const u32 blocksY = (size.y + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+    const u32 blockBytes = GetTextureBlockBytes(format);
+
+    ParallelFor(blocksY, [&](u32 blockY)
+    {
+        u8 texels[TEXELS_PER_BLOCK][4];
+        for (u32 blockX = 0; blockX < blocksX; ++blockX)
+        {
+            for (u32 y = 0; y < TEXTURE_BLOCK_SIZE; ++y)
+            {
+                for (u32 x = 0; x < TEXTURE_BLOCK_SIZE; ++x)
+                {
+                    u32 imageX = glm::min(blockX * TEXTURE_BLOCK_SIZE + x, (u32)size.x - 1);
+                    u32 imageY = glm::min(blockY * TEXTURE_BLOCK_SIZE + y, (u32)size.y - 1);
+                    memcpy(texels[y * TEXTURE_BLOCK_SIZE + x], rgba + (imageY * size.x + imageX) * 4, 4);
+                }
+            }
+
+            EncodeBlock(texels, format, blocks + (blockY * blocksX + blockX) * blockBytes);
+        }
+    });
+}
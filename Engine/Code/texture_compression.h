@@ -0,0 +1,43 @@
+//
+// texture_compression.h: CPU encoders for the BC1/BC3/BC4/BC5 block formats (S3TC and
+// RGTC in OpenGL terms), used when cooking textures so they stay compressed in VRAM.
+//
+
+#pragma once
+
+#include "engine.h"
+
+// S3TC is an extension the glad loader wasn't generated with, the values are fixed
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#define TEXTURE_BLOCK_SIZE 4 // Texels per side of a compressed block
+
+enum TextureFormat
+{
+    TextureFormat_BC1, // RGB, 8 bytes per block
+    TextureFormat_BC3, // RGBA, 16 bytes per block
+    TextureFormat_BC4, // R, 8 bytes per block
+    TextureFormat_BC5, // RG, 16 bytes per block
+    TextureFormat_Count
+};
+
+GLenum GetTextureFormatGL(TextureFormat format);
+
+u32 GetTextureBlockBytes(TextureFormat format);
+
+/**
+ * Bytes taken by a size.x * size.y level in the given format, partial blocks included.
+ */
+u32 GetCompressedLevelSize(TextureFormat format, ivec2 size);
+
+/**
+ * Encodes an RGBA8 image into blocks of the given format, writing
+ * GetCompressedLevelSize(format, size) bytes to blocks. The block rows are spread over
+ * the job system workers. Edge blocks repeat the last row and column of the image.
+ */
+void CompressImage(const u8* rgba, ivec2 size, TextureFormat format, u8* blocks);
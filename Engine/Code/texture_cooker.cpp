@@ -0,0 +1,84 @@
+#include "texture_cooker.h"
+#include "texture_compression.h"
+#include "texture_cache.h"
+#include "texture_mips.h"
+#include <stb_image.h>
+
+Image LoadImage(const char* filename, i32 desiredChannels)
+{
+    Image img = {};
+    // The flip flag is per thread, since images are decoded in the job system workers too
+    stbi_set_flip_vertically_on_load_thread(true);
+    img.pixels = stbi_load(filename, &img.size.x, &img.size.y, &img.nchannels, desiredChannels);
+    if (img.pixels)
+    {
+        if (desiredChannels != 0)
+            img.nchannels = desiredChannels;
+        img.stride = img.size.x * img.nchannels;
+    }
+    else
+    {
+        ELOG("Could not open file %s", filename);
+    }
+    return img;
+}
+
+void FreeImage(Image image)
+{
+    stbi_image_free(image.pixels);
+}
+
+static const char* TextureFormatNames[TextureFormat_Count] = { "BC1", "BC3", "BC4", "BC5" };
+
+static TextureFormat ChooseTextureFormat(const u8* rgba, ivec2 size, TextureUsage usage)
+{
+    if (usage == TextureUsage_Normals)
+        return TextureFormat_BC5;
+    if (usage == TextureUsage_Mask)
+        return TextureFormat_BC4;
+
+    for (u32 i = 0; i < (u32)(size.x * size.y); ++i)
+        if (rgba[i * 4 + 3] != 255)
+            return TextureFormat_BC3;
+
+    return TextureFormat_BC1;
+}
+
+bool CookTexture(const char* filename, TextureUsage usage, CookedTexture& texture)
+{
+    if (ReadTextureCache(filename, usage, texture))
+        return true;
+
+    Image image = LoadImage(filename, 4);
+    if (!image.pixels)
+        return false;
+
+    const TextureFormat format = ChooseTextureFormat((const u8*)image.pixels, image.size, usage);
+
+    std::vector<MipLevel> mips;
+    BuildMipChain((const u8*)image.pixels, image.size, GetMipChainSettings(usage), mips);
+    FreeImage(image);
+
+    texture.internalFormat = GetTextureFormatGL(format);
+    texture.levels.clear();
+    texture.data.clear();
+
+    for (const MipLevel& mip : mips)
+    {
+        TextureLevel entry = {};
+        entry.size = mip.size;
+        entry.offset = texture.data.size();
+        entry.dataSize = GetCompressedLevelSize(format, mip.size);
+        texture.levels.push_back(entry);
+
+        texture.data.resize(entry.offset + entry.dataSize);
+        CompressImage(mip.rgba.data(), mip.size, format, texture.data.data() + entry.offset);
+    }
+
+    ILOG("Cooked texture %s: %s, %d x %d, %u levels, %u KB", filename, TextureFormatNames[format],
+         texture.levels[0].size.x, texture.levels[0].size.y, (u32)texture.levels.size(), (u32)texture.data.size() / 1024);
+
+    WriteTextureCache(filename, usage, texture);
+
+    return true;
+}
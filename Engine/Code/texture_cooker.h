@@ -0,0 +1,24 @@
+//
+// texture_cooker.h: Turns source images into block compressed textures with their whole
+// mip chain, picking the format and the mip filter from what the texture is used for, and
+// keeps the results in the texture cache.
+//
+
+#pragma once
+
+#include "engine.h"
+
+/**
+ * Gets the cooked version of a texture, from its cache file if it is up to date, or else
+ * by decoding the image, building its mips and compressing them (and then writing the
+ * cache). GL-free, runs in the job system workers.
+ */
+bool CookTexture(const char* filename, TextureUsage usage, CookedTexture& texture);
+
+/**
+ * Decodes an image file with stb_image, flipped for OpenGL, forcing desiredChannels
+ * channels unless it's 0. Doesn't touch OpenGL, so it may run in any thread.
+ */
+Image LoadImage(const char* filename, i32 desiredChannels = 0);
+
+void FreeImage(Image image);
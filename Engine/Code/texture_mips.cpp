@@ -0,0 +1,206 @@
+#include "texture_mips.h"
+#include "job_system.h"
+
+#define MAX_FILTER_TAPS 24
+
+// The source texels, clamped to the edge, and normalized weights making a destination texel
+struct FilterTaps
+{
+    u32 count;
+    i32 sources[MAX_FILTER_TAPS];
+    f32 weights[MAX_FILTER_TAPS];
+};
+
+MipChainSettings GetMipChainSettings(TextureUsage usage)
+{
+    MipChainSettings settings = {};
+    settings.filter = MipFilter_Kaiser;
+    settings.gammaCorrect = usage == TextureUsage_Color;
+    settings.normalMap = usage == TextureUsage_Normals;
+
+    // Sinc lobes overshoot on normal maps and only add noise once renormalized
+    if (settings.normalMap)
+        settings.filter = MipFilter_Box;
+
+    return settings;
+}
+
+static f32 BesselI0(f32 x)
+{
+    // Power series, converges quickly for the alphas used by the Kaiser window
+    f32 sum = 1.0f;
+    f32 term = 1.0f;
+    const f32 halfX = x * 0.5f;
+    for (u32 k = 1; k < 32; ++k)
+    {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1e-7f)
+            break;
+    }
+    return sum;
+}
+
+static f32 Sinc(f32 x)
+{
+    if (glm::abs(x) < 1e-4f)
+        return 1.0f;
+    const f32 pix = glm::pi<f32>() * x;
+    return glm::sin(pix) / pix;
+}
+
+static f32 EvaluateFilter(MipFilter filter, f32 x)
+{
+    if (filter == MipFilter_Box)
+        return glm::abs(x) < 0.5f ? 1.0f : 0.0f;
+
+    const f32 t = x / KAISER_FILTER_WIDTH;
+    if (t * t >= 1.0f)
+        return 0.0f;
+    const f32 window = BesselI0(KAISER_FILTER_ALPHA * glm::sqrt(1.0f - t * t)) / BesselI0(KAISER_FILTER_ALPHA);
+    return Sinc(x) * window;
+}
+
+// Taps of one axis, for every destination texel of a srcSize to dstSize reduction
+static void BuildFilterTaps(MipFilter filter, i32 srcSize, i32 dstSize, std::vector<FilterTaps>& taps)
+{
+    const f32 scale = (f32)srcSize / (f32)dstSize;
+    const f32 radius = filter == MipFilter_Box ? 0.5f : KAISER_FILTER_WIDTH;
+
+    taps.resize(dstSize);
+    for (i32 dst = 0; dst < dstSize; ++dst)
+    {
+        FilterTaps& texelTaps = taps[dst];
+        texelTaps.count = 0;
+
+        const f32 center = (dst + 0.5f) * scale;
+        const i32 first = (i32)glm::floor(center - radius * scale);
+        const i32 last = (i32)glm::ceil(center + radius * scale);
+
+        f32 weightSum = 0.0f;
+        for (i32 src = first; src <= last && texelTaps.count < MAX_FILTER_TAPS; ++src)
+        {
+            const f32 weight = EvaluateFilter(filter, (src + 0.5f - center) / scale);
+            if (weight == 0.0f)
+                continue;
+
+            texelTaps.sources[texelTaps.count] = glm::clamp(src, 0, srcSize - 1);
+            texelTaps.weights[texelTaps.count] = weight;
+            texelTaps.count++;
+            weightSum += weight;
+        }
+
+        for (u32 i = 0; i < texelTaps.count; ++i)
+            texelTaps.weights[i] /= weightSum;
+    }
+}
+
+static f32 SrgbToLinear(f32 c)
+{
+    return c <= 0.04045f ? c / 12.92f : glm::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 LinearToSrgb(f32 c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * glm::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static void DecodeTexels(const u8* rgba, u32 texelCount, const MipChainSettings& settings, std::vector<vec4>& texels)
+{
+    f32 srgbToLinear[256];
+    for (u32 i = 0; i < 256; ++i)
+        srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+
+    texels.resize(texelCount);
+    for (u32 i = 0; i < texelCount; ++i)
+    {
+        const u8* texel = rgba + i * 4;
+        vec4 value = vec4(texel[0], texel[1], texel[2], texel[3]) / 255.0f;
+        if (settings.gammaCorrect)
+            value = vec4(srgbToLinear[texel[0]], srgbToLinear[texel[1]], srgbToLinear[texel[2]], value.a);
+        if (settings.normalMap)
+            value = vec4(vec3(value) * 2.0f - 1.0f, value.a);
+        texels[i] = value;
+    }
+}
+
+static void EncodeTexels(const std::vector<vec4>& texels, const MipChainSettings& settings, std::vector<u8>& rgba)
+{
+    rgba.resize(texels.size() * 4);
+    for (u32 i = 0; i < texels.size(); ++i)
+    {
+        vec4 value = texels[i];
+        if (settings.gammaCorrect)
+            value = vec4(LinearToSrgb(glm::max(value.r, 0.0f)), LinearToSrgb(glm::max(value.g, 0.0f)), LinearToSrgb(glm::max(value.b, 0.0f)), value.a);
+        if (settings.normalMap)
+            value = vec4(vec3(value) * 0.5f + 0.5f, value.a);
+
+        value = glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f;
+        for (u32 c = 0; c < 4; ++c)
+            rgba[i * 4 + c] = (u8)value[c];
+    }
+}
+
+static void DownsampleTexels(const std::vector<vec4>& src, ivec2 srcSize, std::vector<vec4>& dst, ivec2 dstSize, const MipChainSettings& settings)
+{
+    std::vector<FilterTaps> tapsX, tapsY;
+    BuildFilterTaps(settings.filter, srcSize.x, dstSize.x, tapsX);
+    BuildFilterTaps(settings.filter, srcSize.y, dstSize.y, tapsY);
+
+    // Separable: the rows are filtered first, then the columns
+    std::vector<vec4> rows(dstSize.x * srcSize.y);
+    ParallelFor(srcSize.y, [&](u32 y)
+    {
+        for (i32 x = 0; x < dstSize.x; ++x)
+        {
+            const FilterTaps& taps = tapsX[x];
+            vec4 sum = vec4(0.0f);
+            for (u32 i = 0; i < taps.count; ++i)
+                sum += src[y * srcSize.x + taps.sources[i]] * taps.weights[i];
+            rows[y * dstSize.x + x] = sum;
+        }
+    });
+
+    dst.resize(dstSize.x * dstSize.y);
+    ParallelFor(dstSize.y, [&](u32 y)
+    {
+        const FilterTaps& taps = tapsY[y];
+        for (i32 x = 0; x < dstSize.x; ++x)
+        {
+            vec4 sum = vec4(0.0f);
+            for (u32 i = 0; i < taps.count; ++i)
+                sum += rows[taps.sources[i] * dstSize.x + x] * taps.weights[i];
+
+            if (settings.normalMap)
+            {
+                const vec3 normal = vec3(sum);
+                const f32 length = glm::length(normal);
+                sum = vec4(length > 1e-6f ? normal / length : vec3(0.0f, 0.0f, 1.0f), sum.a);
+            }
+
+            dst[y * dstSize.x + x] = sum;
+        }
+    });
+}
+
+void BuildMipChain(const u8* rgba, ivec2 size, const MipChainSettings& settings, std::vector<MipLevel>& levels)
+{
+    levels.clear();
+    levels.push_back(MipLevel{ size, std::vector<u8>(rgba, rgba + size.x * size.y * 4) });
+
+    // Every level is filtered from the float copy of the previous one, not from its 8-bit
+    // version, so rounding errors don't pile up down the chain
+    std::vector<vec4> texels, nextTexels;
+    DecodeTexels(rgba, size.x * size.y, settings, texels);
+
+    while (size.x > 1 || size.y > 1)
+    {
+        const ivec2 nextSize = glm::max(size / 2, ivec2(1));
+        DownsampleTexels(texels, size, nextTexels, nextSize, settings);
+        texels.swap(nextTexels);
+        size = nextSize;
+
+        levels.push_back(MipLevel{ size, std::vector<u8>() });
+        EncodeTexels(texels, settings, levels.back().rgba);
+    }
+}
@@ -0,0 +1,40 @@
+//
+// texture_mips.h: CPU mip chain generation for the texture cooker. Levels are filtered in
+// floating point from the previous one, in linear space for color textures and as unit
+// vectors for normal maps, so the result doesn't depend on the driver and it is the same
+// on every run.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define KAISER_FILTER_WIDTH 3.0f // Radius of the Kaiser filter, in destination texels
+#define KAISER_FILTER_ALPHA 4.0f
+
+enum MipFilter
+{
+    MipFilter_Box,    // Average of the texels under each destination texel
+    MipFilter_Kaiser, // Windowed sinc, sharper mips with less aliasing
+};
+
+struct MipChainSettings
+{
+    MipFilter filter;
+    bool      gammaCorrect; // RGB is sRGB encoded, filter it in linear space
+    bool      normalMap;    // RGB is a unit vector, renormalize it after filtering
+};
+
+struct MipLevel
+{
+    ivec2           size;
+    std::vector<u8> rgba;
+};
+
+MipChainSettings GetMipChainSettings(TextureUsage usage);
+
+/**
+ * Builds the mip chain of an RGBA8 image down to 1x1, the first level being the image
+ * itself. GL-free, the rows of each level are spread over the job system workers.
+ */
+void BuildMipChain(const u8* rgba, ivec2 size, const MipChainSettings& settings, std::vector<MipLevel>& levels);
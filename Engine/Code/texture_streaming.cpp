@@ -0,0 +1,272 @@
+#include "texture_streaming.h"
+#include "staging_ring.h"
+
+#include <cfloat>
+
+struct StreamedTexture
+{
+    u32           texIdx;
+    CookedTexture cooked;
+    u32           tailLevel;         // Finest of the levels that are never evicted
+    u32           residentLevel;     // Level 0 of the GL texture storage
+    u32           completeLevel;     // Finest level with its data, one coarser while residentLevel streams in
+    u32           uploadedBlockRows; // Of residentLevel while it streams in
+    u32           wantedLevel;       // From this frame's screen footprint
+    u32           targetLevel;       // The wanted level once fitted in the memory budget
+};
+
+struct TextureStreaming
+{
+    std::vector<StreamedTexture> textures;
+};
+
+static TextureStreaming GlobalTextureStreaming;
+
+static u32 GetTailLevel(const CookedTexture& cooked)
+{
+    for (u32 level = 0; level < cooked.levels.size(); ++level)
+    {
+        const ivec2 size = cooked.levels[level].size;
+        if (glm::max(size.x, size.y) <= TEXTURE_STREAMING_TAIL_SIZE)
+            return level;
+    }
+    return cooked.levels.size() - 1;
+}
+
+static u64 GetChainMemory(const CookedTexture& cooked, u32 firstLevel)
+{
+    u64 bytes = 0;
+    for (u32 level = firstLevel; level < cooked.levels.size(); ++level)
+        bytes += cooked.levels[level].dataSize;
+    return bytes;
+}
+
+// Moves the texture to a new GL texture holding its levels from firstLevel down, and
+// copies over the levels both have data for, on the GPU
+static void ReallocateStreamedTexture(App* app, StreamedTexture& texture, u32 firstLevel)
+{
+    Texture& appTexture = app->textures[texture.texIdx];
+    const CookedTexture& cooked = texture.cooked;
+
+    GLuint handle = CreateCompressedTexture2D(cooked, firstLevel, false);
+
+    const u32 firstCopiedLevel = glm::max(firstLevel, texture.completeLevel);
+    for (u32 level = firstCopiedLevel; level < cooked.levels.size(); ++level)
+    {
+        const ivec2 size = cooked.levels[level].size;
+        glCopyImageSubData(appTexture.handle, GL_TEXTURE_2D, level - texture.residentLevel, 0, 0, 0,
+                           handle, GL_TEXTURE_2D, level - firstLevel, 0, 0, 0, size.x, size.y, 1);
+    }
+
+    // Sampling is clamped to the levels with data until the finer ones are uploaded
+    glBindTexture(GL_TEXTURE_2D, handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstCopiedLevel - firstLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glDeleteTextures(1, &appTexture.handle);
+    appTexture.handle = handle;
+
+    texture.residentLevel = firstLevel;
+    texture.completeLevel = firstCopiedLevel;
+    texture.uploadedBlockRows = 0;
+}
+
+// Uploads rows of the resident level until the staging ring frame budget runs out
+static void UploadStreamedLevel(StreamedTexture& texture, GLuint handle)
+{
+    const CookedTexture& cooked = texture.cooked;
+    const u32 level = texture.residentLevel;
+    const u32 blockRowCount = GetTextureLevelBlockRows(cooked, level);
+    const u32 rowBytes = cooked.levels[level].dataSize / blockRowCount;
+
+    // Rows that don't fit the staging ring this frame wait for the next ones
+    const u32 stagingRows = GetStagingSpace() / rowBytes;
+    if (stagingRows == 0)
+        return;
+
+    const u32 rows = glm::min(blockRowCount - texture.uploadedBlockRows, stagingRows);
+
+    glBindTexture(GL_TEXTURE_2D, handle);
+    UploadCompressedTextureRows(cooked, level, texture.residentLevel, texture.uploadedBlockRows, rows);
+
+    texture.uploadedBlockRows += rows;
+
+    if (texture.uploadedBlockRows == blockRowCount)
+    {
+        texture.completeLevel = level;
+        texture.uploadedBlockRows = 0;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void AddStreamedTexture(App* app, u32 texIdx, CookedTexture& cooked)
+{
+    Texture& appTexture = app->textures[texIdx];
+    const u32 tailLevel = GetTailLevel(cooked);
+
+    appTexture.handle = CreateCompressedTexture2D(cooked, tailLevel, true);
+    appTexture.isPlaceholder = false;
+
+    // Small textures are whole already, there's nothing to stream
+    if (tailLevel == 0)
+        return;
+
+    GlobalTextureStreaming.textures.push_back(StreamedTexture{});
+    StreamedTexture& texture = GlobalTextureStreaming.textures.back();
+    texture.texIdx = texIdx;
+    texture.cooked.internalFormat = cooked.internalFormat;
+    texture.cooked.levels.swap(cooked.levels);
+    texture.cooked.data.swap(cooked.data);
+    texture.tailLevel = tailLevel;
+    texture.residentLevel = tailLevel;
+    texture.completeLevel = tailLevel;
+    texture.uploadedBlockRows = 0;
+    texture.wantedLevel = tailLevel;
+    texture.targetLevel = tailLevel;
+}
+
+void RemoveStreamedTexture(u32 texIdx)
+{
+    std::vector<StreamedTexture>& textures = GlobalTextureStreaming.textures;
+    for (u32 i = 0; i < textures.size(); ++i)
+    {
+        if (textures[i].texIdx == texIdx)
+        {
+            textures.erase(textures.begin() + i);
+            return;
+        }
+    }
+}
+
+// Finest level worth having for an entity covering screenDiameter pixels, assuming its
+// UVs span the texture once
+static u32 GetWantedLevel(const StreamedTexture& texture, f32 screenDiameter)
+{
+    const ivec2 size = texture.cooked.levels[0].size;
+    const f32 texelsPerPixel = (f32)glm::max(size.x, size.y) / glm::max(screenDiameter, 1.0f);
+    const f32 level = glm::floor(glm::log2(glm::max(texelsPerPixel, 1.0f)));
+    return glm::min((u32)level, texture.tailLevel);
+}
+
+static f32 GetScreenDiameter(App* app, const mat4& world, const Submesh& submesh)
+{
+    // Meshes without bounds always get their finest level
+    if (submesh.boundsRadius <= 0.0f)
+        return FLT_MAX;
+
+    const f32 worldScale = glm::max(glm::length(vec3(world[0])), glm::max(glm::length(vec3(world[1])), glm::length(vec3(world[2]))));
+    const f32 radius = submesh.boundsRadius * worldScale;
+
+    const vec3 center = vec3(world * vec4(submesh.boundsCenter, 1.0f));
+    const f32 distance = glm::length(center - app->camera.pos) - radius;
+    if (distance <= 0.0f)
+        return FLT_MAX;
+
+    const f32 pixelsPerUnit = app->displaySize.y / (2.0f * tanf(glm::radians(app->camera.fovY) * 0.5f) * distance);
+    return 2.0f * radius * pixelsPerUnit;
+}
+
+void UpdateTextureStreaming(App* app)
+{
+    std::vector<StreamedTexture>& textures = GlobalTextureStreaming.textures;
+    if (textures.empty())
+        return;
+
+    std::vector<u32> streamedIndices(app->textures.size(), UINT32_MAX);
+    for (u32 i = 0; i < textures.size(); ++i)
+    {
+        streamedIndices[textures[i].texIdx] = i;
+        textures[i].wantedLevel = textures[i].tailLevel;
+    }
+
+    for (const Entity& entity : app->enTities)
+    {
+        const Model& model = app->models[entity.modelIdx];
+        const Mesh& mesh = app->meshes[model.meshIdx];
+
+        // Every node instance of a submesh has its own footprint, as the geometry pass draws them
+        const u32 nodeCount = model.nodes.empty() ? 1u : (u32)model.nodes.size();
+        for (u32 n = 0; n < nodeCount; ++n)
+        {
+            const ModelNode* node = model.nodes.empty() ? nullptr : &model.nodes[n];
+            const mat4 world = node ? entity.worldMatrix * node->modelTransform : entity.worldMatrix;
+
+            const u32 submeshCount = node ? (u32)node->submeshes.size() : (u32)mesh.submeshes.size();
+            for (u32 k = 0; k < submeshCount; ++k)
+            {
+                const u32 i = node ? node->submeshes[k] : k;
+                if (i >= mesh.submeshes.size() || i >= model.materialIdx.size())
+                    continue;
+
+                const Material& material = app->materials[model.materialIdx[i]];
+                const u32 materialTextures[] = { material.albedoTextureIdx, material.emissiveTextureIdx, material.specularTextureIdx,
+                                                 material.normalsTextureIdx, material.bumpTextureIdx };
+
+                const f32 screenDiameter = GetScreenDiameter(app, world, mesh.submeshes[i]);
+                for (u32 texIdx : materialTextures)
+                {
+                    if (texIdx >= streamedIndices.size() || streamedIndices[texIdx] == UINT32_MAX)
+                        continue;
+
+                    StreamedTexture& texture = textures[streamedIndices[texIdx]];
+                    texture.wantedLevel = glm::min(texture.wantedLevel, GetWantedLevel(texture, screenDiameter));
+                }
+            }
+        }
+    }
+
+    // Keep a level that is only one step finer than wanted, so textures on the edge of two
+    // levels don't get evicted and uploaded again every other frame
+    u64 totalMemory = 0;
+    for (StreamedTexture& texture : textures)
+    {
+        texture.targetLevel = texture.wantedLevel == texture.residentLevel + 1 ? texture.residentLevel : texture.wantedLevel;
+        totalMemory += GetChainMemory(texture.cooked, texture.targetLevel);
+    }
+
+    // Over budget, drop the largest level left until everything fits
+    const u64 memoryBudget = (u64)app->textureMemoryBudgetMB * 1024 * 1024;
+    while (totalMemory > memoryBudget)
+    {
+        StreamedTexture* largest = nullptr;
+        for (StreamedTexture& texture : textures)
+            if (texture.targetLevel < texture.tailLevel &&
+                (!largest || texture.cooked.levels[texture.targetLevel].dataSize > largest->cooked.levels[largest->targetLevel].dataSize))
+                largest = &texture;
+
+        if (!largest)
+            break;
+
+        totalMemory -= largest->cooked.levels[largest->targetLevel].dataSize;
+        largest->targetLevel++;
+    }
+
+    // Evictions first, they free memory for what streams in
+    for (StreamedTexture& texture : textures)
+        if (texture.targetLevel > texture.residentLevel)
+            ReallocateStreamedTexture(app, texture, texture.targetLevel);
+
+    // Finer levels stream in one at a time per texture
+    for (StreamedTexture& texture : textures)
+    {
+        if (GetStagingSpace() == 0)
+            break;
+
+        const bool isUploading = texture.completeLevel > texture.residentLevel;
+        if (!isUploading && texture.targetLevel < texture.residentLevel)
+            ReallocateStreamedTexture(app, texture, texture.residentLevel - 1);
+
+        if (texture.completeLevel > texture.residentLevel)
+            UploadStreamedLevel(texture, app->textures[texture.texIdx].handle);
+    }
+}
+
+u64 GetStreamedTextureMemory()
+{
+    u64 bytes = 0;
+    for (const StreamedTexture& texture : GlobalTextureStreaming.textures)
+        bytes += GetChainMemory(texture.cooked, texture.residentLevel);
+    return bytes;
+}
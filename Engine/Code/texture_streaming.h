@@ -0,0 +1,37 @@
+//
+// texture_streaming.h: Per-texture mip residency. Textures start with only their coarse
+// levels on the GPU, and finer levels are uploaded (or dropped) every frame depending on
+// how big the entities using them are on screen, within a global texture memory budget.
+//
+
+#pragma once
+
+#include "engine.h"
+
+#define TEXTURE_STREAMING_TAIL_SIZE 64 // Levels this size and smaller are always resident
+
+/**
+ * Creates the GL texture of app->textures[texIdx] with the coarse levels of a cooked
+ * texture. If it has finer levels, the cooked data is swapped out to upload them later.
+ */
+void AddStreamedTexture(App* app, u32 texIdx, CookedTexture& cooked);
+
+/**
+ * Stops streaming app->textures[texIdx], as before replacing it. Its GL texture is left
+ * to the caller.
+ */
+void RemoveStreamedTexture(u32 texIdx);
+
+/**
+ * Picks the finest level each streamed texture needs from the screen footprint of the
+ * entities using it, fits them in app->textureMemoryBudgetMB by dropping the finest
+ * levels of the largest textures first, then evicts and uploads levels to match, as much
+ * as the staging ring frame budget left by the asset streaming allows. Called once per
+ * frame from the main thread, after the camera matrices are updated.
+ */
+void UpdateTextureStreaming(App* app);
+
+/**
+ * Bytes taken by the resident levels of the streamed textures.
+ */
+u64 GetStreamedTextureMemory();
@@ -0,0 +1,566 @@
+#include "vertex_interleave.h"
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define INTERLEAVE_SSE2 1
+#else
+#define INTERLEAVE_SSE2 0
+#endif
+
+#define SNORM16_MAX 32767.0f
+#define UNORM16_MAX 65535.0f
+
+static u16 FloatToHalf(f32 value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const u32 sign = (bits >> 16) & 0x8000;
+    const i32 exponent = (i32)((bits >> 23) & 0xFF) - 127 + 15;
+    u32 mantissa = bits & 0x7FFFFF;
+
+    if (exponent <= 0)
+    {
+        // Too small for a normal half: flush to a subnormal or zero
+        if (exponent < -10)
+            return (u16)sign;
+
+        mantissa |= 0x800000;
+        const u32 shift = (u32)(14 - exponent);
+        u32 half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return (u16)(sign | half);
+    }
+
+    if (exponent >= 31)
+        return (u16)(sign | 0x7C00);
+
+    u32 half = sign | ((u32)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+        half++; // Round, the carry may correctly bump the exponent
+    return (u16)half;
+}
+
+bool CanQuantizePositions(const vec3& minPos, const vec3& maxPos)
+{
+    const vec3 extent = maxPos - minPos;
+    const f32 maxExtent = glm::max(extent.x, glm::max(extent.y, extent.z));
+    return maxExtent / UNORM16_MAX <= MAX_POSITION_QUANTIZATION_STEP;
+}
+
+VertexFormat ChooseVertexFormat(const VertexStreams& streams)
+{
+    VertexFormat format = {};
+    format.hasTexCoords = streams.texCoords != nullptr;
+    format.hasTangentSpace = streams.tangents != nullptr && streams.bitangents != nullptr;
+
+    vec3 minPos = vec3(0.0f);
+    vec3 maxPos = vec3(0.0f);
+    if (streams.vertexCount > 0)
+    {
+        minPos = maxPos = streams.positions[0];
+        for (u32 i = 1; i < streams.vertexCount; ++i)
+        {
+            minPos = glm::min(minPos, streams.positions[i]);
+            maxPos = glm::max(maxPos, streams.positions[i]);
+        }
+    }
+
+    const vec3 extent = maxPos - minPos;
+    if (CanQuantizePositions(minPos, maxPos))
+    {
+        format.positionEncoding = PositionEncoding_Unorm16;
+        format.positionScale = extent;
+        format.positionBias = minPos;
+    }
+    else
+    {
+        format.positionEncoding = PositionEncoding_Float;
+        format.positionScale = vec3(1.0f);
+        format.positionBias = vec3(0.0f);
+    }
+
+    format.texCoordEncoding = TexCoordEncoding_Unorm16;
+    if (format.hasTexCoords)
+    {
+        for (u32 i = 0; i < streams.vertexCount; ++i)
+        {
+            const vec3& uv = streams.texCoords[i];
+            if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f)
+            {
+                // Tiled coordinates keep their range with half floats
+                format.texCoordEncoding = TexCoordEncoding_Half;
+                break;
+            }
+        }
+    }
+
+    return format;
+}
+
+VertexBufferLayout MakeVertexBufferLayout(const VertexFormat& format)
+{
+    VertexBufferLayout vertexBufferLayout = {};
+    if (format.positionEncoding == PositionEncoding_Unorm16)
+    {
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 0, 4, 0, GL_TRUE, GL_UNSIGNED_SHORT } );
+        vertexBufferLayout.stride = 4 * sizeof(u16);
+    }
+    else
+    {
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 0, 3, 0, GL_FALSE, GL_FLOAT } );
+        vertexBufferLayout.stride = 3 * sizeof(f32);
+    }
+
+    vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 1, 2, vertexBufferLayout.stride, GL_TRUE, GL_SHORT } );
+    vertexBufferLayout.stride += 2 * sizeof(i16);
+
+    if (format.hasTexCoords)
+    {
+        if (format.texCoordEncoding == TexCoordEncoding_Half)
+            vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride, GL_FALSE, GL_HALF_FLOAT } );
+        else
+            vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride, GL_TRUE, GL_UNSIGNED_SHORT } );
+        vertexBufferLayout.stride += 2 * sizeof(u16);
+    }
+
+    if (format.hasTangentSpace)
+    {
+        vertexBufferLayout.attributes.push_back( VertexBufferAttribute{ 3, 4, vertexBufferLayout.stride, GL_TRUE, GL_SHORT } );
+        vertexBufferLayout.stride += 4 * sizeof(i16);
+    }
+
+    return vertexBufferLayout;
+}
+
+struct PackConstants
+{
+    vec3 invPositionScale;
+    vec3 positionBias;
+    f32  bitangentSign;
+};
+
+template <bool HasTexCoords, bool HasTangentSpace, bool QuantizedPosition, bool HalfTexCoords>
+struct PackedVertexLayout
+{
+    static const u32 normalOffset   = QuantizedPosition ? 8 : 12;
+    static const u32 texCoordOffset = normalOffset + 4;
+    static const u32 tangentOffset  = texCoordOffset + (HasTexCoords ? 4 : 0);
+    static const u32 stride         = tangentOffset + (HasTangentSpace ? 8 : 0);
+};
+
+#if INTERLEAVE_SSE2
+
+// Transposes 4 consecutive vec3 (12 floats) into x, y and z registers
+static inline void LoadVec3x4(const vec3* src, __m128& x, __m128& y, __m128& z)
+{
+    const f32* f = (const f32*)src;
+    const __m128 a = _mm_loadu_ps(f + 0); // x0 y0 z0 x1
+    const __m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+    const __m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+
+    x = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Octahedral encoding of 4 directions into 4 packed snorm16x2 (one u32 per lane)
+static inline __m128i OctEncodeSnorm16x4(__m128 x, __m128 y, __m128 z)
+{
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    const __m128 absX = _mm_andnot_ps(signBit, x);
+    const __m128 absY = _mm_andnot_ps(signBit, y);
+    const __m128 absZ = _mm_andnot_ps(signBit, z);
+    const __m128 sum = _mm_max_ps(_mm_add_ps(_mm_add_ps(absX, absY), absZ), _mm_set1_ps(1e-20f));
+    const __m128 invSum = _mm_div_ps(one, sum);
+
+    const __m128 nx = _mm_mul_ps(x, invSum);
+    const __m128 ny = _mm_mul_ps(y, invSum);
+
+    // Lower hemisphere folds over the diagonals
+    const __m128 signX = _mm_or_ps(_mm_and_ps(nx, signBit), one);
+    const __m128 signY = _mm_or_ps(_mm_and_ps(ny, signBit), one);
+    const __m128 foldX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, ny)), signX);
+    const __m128 foldY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, nx)), signY);
+    const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+
+    const __m128 scale = _mm_set1_ps(SNORM16_MAX);
+    const __m128i ox = _mm_cvtps_epi32(_mm_mul_ps(Select(lower, foldX, nx), scale));
+    const __m128i oy = _mm_cvtps_epi32(_mm_mul_ps(Select(lower, foldY, ny), scale));
+
+    const __m128i xy = _mm_packs_epi32(ox, oy); // x0 x1 x2 x3 y0 y1 y2 y3
+    return _mm_unpacklo_epi16(xy, _mm_srli_si128(xy, 8));
+}
+
+// Converts 4 values in [0, 1] to unorm16 (lanes keep 32 bits)
+static inline __m128i ToUnorm16x4(__m128 v)
+{
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(UNORM16_MAX)));
+}
+
+// Packs 32-bit lanes in [0, 65535] into 16 bits (SSE2 has no unsigned 32->16 pack)
+static inline __m128i PackUnorm16(__m128i a, __m128i b)
+{
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+    return _mm_xor_si128(packed, _mm_set1_epi16((i16)0x8000));
+}
+
+template <bool HasTexCoords, bool HasTangentSpace, bool QuantizedPosition, bool HalfTexCoords>
+static void PackVertices4(const vec3* positions, const vec3* normals, const vec3* texCoords,
+                          const vec3* tangents, const vec3* bitangents,
+                          const PackConstants& constants, u8* dst)
+{
+    typedef PackedVertexLayout<HasTexCoords, HasTangentSpace, QuantizedPosition, HalfTexCoords> Layout;
+
+    __m128 nx, ny, nz;
+    LoadVec3x4(normals, nx, ny, nz);
+
+    alignas(16) u32 packedNormals[4];
+    _mm_store_si128((__m128i*)packedNormals, OctEncodeSnorm16x4(nx, ny, nz));
+
+    alignas(16) u16 packedPositions[16];
+    if (QuantizedPosition)
+    {
+        __m128 px, py, pz;
+        LoadVec3x4(positions, px, py, pz);
+        px = _mm_mul_ps(_mm_sub_ps(px, _mm_set1_ps(constants.positionBias.x)), _mm_set1_ps(constants.invPositionScale.x));
+        py = _mm_mul_ps(_mm_sub_ps(py, _mm_set1_ps(constants.positionBias.y)), _mm_set1_ps(constants.invPositionScale.y));
+        pz = _mm_mul_ps(_mm_sub_ps(pz, _mm_set1_ps(constants.positionBias.z)), _mm_set1_ps(constants.invPositionScale.z));
+
+        const __m128i xy = PackUnorm16(ToUnorm16x4(px), ToUnorm16x4(py)); // x0..x3 y0..y3
+        const __m128i z0 = PackUnorm16(ToUnorm16x4(pz), _mm_set1_epi32(32768)); // z0..z3, junk
+        const __m128i xyPairs = _mm_unpacklo_epi16(xy, _mm_srli_si128(xy, 8));
+        const __m128i zPairs  = _mm_unpacklo_epi16(z0, _mm_setzero_si128());
+        _mm_store_si128((__m128i*)packedPositions + 0, _mm_unpacklo_epi32(xyPairs, zPairs));
+        _mm_store_si128((__m128i*)packedPositions + 1, _mm_unpackhi_epi32(xyPairs, zPairs));
+    }
+
+    alignas(16) u32 packedTexCoords[4];
+    if (HasTexCoords)
+    {
+        if (HalfTexCoords)
+        {
+            for (u32 i = 0; i < 4; ++i)
+                packedTexCoords[i] = (u32)FloatToHalf(texCoords[i].x) | ((u32)FloatToHalf(texCoords[i].y) << 16);
+        }
+        else
+        {
+            __m128 u, v, w;
+            LoadVec3x4(texCoords, u, v, w);
+            const __m128i uv = PackUnorm16(ToUnorm16x4(u), ToUnorm16x4(v));
+            _mm_store_si128((__m128i*)packedTexCoords, _mm_unpacklo_epi16(uv, _mm_srli_si128(uv, 8)));
+        }
+    }
+
+    alignas(16) u32 packedTangents[4];
+    alignas(16) u32 packedSigns[4];
+    if (HasTangentSpace)
+    {
+        __m128 tx, ty, tz, bx, by, bz;
+        LoadVec3x4(tangents, tx, ty, tz);
+        LoadVec3x4(bitangents, bx, by, bz);
+        _mm_store_si128((__m128i*)packedTangents, OctEncodeSnorm16x4(tx, ty, tz));
+
+        // Handedness: sign of dot(cross(N, T), B), the bitangent is rebuilt in the shader
+        const __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+        const __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+        const __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+        __m128 handedness = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, bx), _mm_mul_ps(cy, by)), _mm_mul_ps(cz, bz));
+        handedness = _mm_mul_ps(handedness, _mm_set1_ps(constants.bitangentSign));
+        const __m128 negative = _mm_cmplt_ps(handedness, _mm_setzero_ps());
+        const __m128i sign = _mm_cvtps_epi32(Select(negative, _mm_set1_ps(-SNORM16_MAX), _mm_set1_ps(SNORM16_MAX)));
+        _mm_store_si128((__m128i*)packedSigns, _mm_and_si128(sign, _mm_set1_epi32(0xFFFF)));
+    }
+
+    for (u32 i = 0; i < 4; ++i)
+    {
+        u8* vertex = dst + i * Layout::stride;
+
+        if (QuantizedPosition)
+            memcpy(vertex, packedPositions + i * 4, 8);
+        else
+            memcpy(vertex, &positions[i], 12);
+
+        memcpy(vertex + Layout::normalOffset, &packedNormals[i], 4);
+
+        if (HasTexCoords)
+            memcpy(vertex + Layout::texCoordOffset, &packedTexCoords[i], 4);
+
+        if (HasTangentSpace)
+        {
+            memcpy(vertex + Layout::tangentOffset, &packedTangents[i], 4);
+            memcpy(vertex + Layout::tangentOffset + 4, &packedSigns[i], 4);
+        }
+    }
+}
+
+#else
+
+static void OctEncodeSnorm16(vec3 n, i16* dst)
+{
+    n /= glm::max(fabsf(n.x) + fabsf(n.y) + fabsf(n.z), 1e-20f);
+    vec2 e = vec2(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        e.x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    dst[0] = (i16)roundf(e.x * SNORM16_MAX);
+    dst[1] = (i16)roundf(e.y * SNORM16_MAX);
+}
+
+static u16 ToUnorm16(f32 value)
+{
+    return (u16)roundf(glm::clamp(value, 0.0f, 1.0f) * UNORM16_MAX);
+}
+
+#endif
+
+template <bool HasTexCoords, bool HasTangentSpace, bool QuantizedPosition, bool HalfTexCoords>
+static void InterleaveVerticesT(const VertexStreams& streams, const PackConstants& constants, u8* output)
+{
+    typedef PackedVertexLayout<HasTexCoords, HasTangentSpace, QuantizedPosition, HalfTexCoords> Layout;
+
+    const u32 count = streams.vertexCount;
+    u32 i = 0;
+
+#if INTERLEAVE_SSE2
+    // Blocks of 4 vertices are transposed from the vec3 arrays into SoA registers,
+    // encoded together and scattered back into the interleaved output.
+    for (; i + 4 <= count; i += 4)
+    {
+        PackVertices4<HasTexCoords, HasTangentSpace, QuantizedPosition, HalfTexCoords>(
+            streams.positions + i,
+            streams.normals + i,
+            HasTexCoords ? streams.texCoords + i : nullptr,
+            HasTangentSpace ? streams.tangents + i : nullptr,
+            HasTangentSpace ? streams.bitangents + i : nullptr,
+            constants, output + i * Layout::stride);
+    }
+
+    // The remaining vertices go through the same kernel with zero padding, so they
+    // are encoded exactly like the rest.
+    if (i < count)
+    {
+        vec3 positions[4] = {}, normals[4] = {}, texCoords[4] = {}, tangents[4] = {}, bitangents[4] = {};
+        u8 padded[4 * Layout::stride];
+        const u32 remaining = count - i;
+
+        for (u32 j = 0; j < remaining; ++j)
+        {
+            positions[j] = streams.positions[i + j];
+            normals[j] = streams.normals[i + j];
+            if (HasTexCoords)    texCoords[j] = streams.texCoords[i + j];
+            if (HasTangentSpace) tangents[j] = streams.tangents[i + j];
+            if (HasTangentSpace) bitangents[j] = streams.bitangents[i + j];
+        }
+
+        PackVertices4<HasTexCoords, HasTangentSpace, QuantizedPosition, HalfTexCoords>(
+            positions, normals, texCoords, tangents, bitangents, constants, padded);
+        memcpy(output + i * Layout::stride, padded, remaining * Layout::stride);
+    }
+#else
+    for (; i < count; ++i)
+    {
+        u8* vertex = output + i * Layout::stride;
+
+        if (QuantizedPosition)
+        {
+            const vec3 q = (streams.positions[i] - constants.positionBias) * constants.invPositionScale;
+            const u16 packed[4] = { ToUnorm16(q.x), ToUnorm16(q.y), ToUnorm16(q.z), 0 };
+            memcpy(vertex, packed, sizeof(packed));
+        }
+        else
+        {
+            memcpy(vertex, &streams.positions[i], 12);
+        }
+
+        OctEncodeSnorm16(streams.normals[i], (i16*)(vertex + Layout::normalOffset));
+
+        if (HasTexCoords)
+        {
+            const vec3& uv = streams.texCoords[i];
+            u16* packed = (u16*)(vertex + Layout::texCoordOffset);
+            packed[0] = HalfTexCoords ? FloatToHalf(uv.x) : ToUnorm16(uv.x);
+            packed[1] = HalfTexCoords ? FloatToHalf(uv.y) : ToUnorm16(uv.y);
+        }
+
+        if (HasTangentSpace)
+        {
+            i16* packed = (i16*)(vertex + Layout::tangentOffset);
+            OctEncodeSnorm16(streams.tangents[i], packed);
+            const f32 handedness = glm::dot(glm::cross(streams.normals[i], streams.tangents[i]), streams.bitangents[i]) * constants.bitangentSign;
+            packed[2] = handedness < 0.0f ? -32767 : 32767;
+            packed[3] = 0;
+        }
+    }
+#endif
+}
+
+typedef void (*InterleaveVerticesFn)(const VertexStreams&, const PackConstants&, u8*);
+
+#define INTERLEAVE_VARIANT(texCoords, tangentSpace) \
+    InterleaveVerticesT<texCoords, tangentSpace, false, false>, \
+    InterleaveVerticesT<texCoords, tangentSpace, false, true>,  \
+    InterleaveVerticesT<texCoords, tangentSpace, true,  false>, \
+    InterleaveVerticesT<texCoords, tangentSpace, true,  true>
+
+// Indexed by [hasTexCoords][hasTangentSpace][quantizedPosition * 2 + halfTexCoords]
+static const InterleaveVerticesFn InterleaveVariants[2][2][4] =
+{
+    { { INTERLEAVE_VARIANT(false, false) }, { INTERLEAVE_VARIANT(false, true) } },
+    { { INTERLEAVE_VARIANT(true,  false) }, { INTERLEAVE_VARIANT(true,  true) } },
+};
+
+void InterleaveVertices(const VertexStreams& streams, const VertexFormat& format, void* output)
+{
+    ASSERT(format.hasTexCoords == (streams.texCoords != nullptr), "The format doesn't match the vertex streams");
+    ASSERT(format.hasTangentSpace == (streams.tangents != nullptr && streams.bitangents != nullptr), "The format doesn't match the vertex streams");
+
+    PackConstants constants = {};
+    constants.positionBias = format.positionBias;
+    constants.invPositionScale.x = format.positionScale.x > 0.0f ? 1.0f / format.positionScale.x : 0.0f;
+    constants.invPositionScale.y = format.positionScale.y > 0.0f ? 1.0f / format.positionScale.y : 0.0f;
+    constants.invPositionScale.z = format.positionScale.z > 0.0f ? 1.0f / format.positionScale.z : 0.0f;
+    constants.bitangentSign = streams.flipBitangents ? -1.0f : 1.0f;
+
+    const u32 quantizedPosition = format.positionEncoding == PositionEncoding_Unorm16 ? 1 : 0;
+    const u32 halfTexCoords = format.texCoordEncoding == TexCoordEncoding_Half ? 1 : 0;
+
+    InterleaveVerticesFn interleave = InterleaveVariants[format.hasTexCoords][format.hasTangentSpace][quantizedPosition * 2 + halfTexCoords];
+    interleave(streams, constants, (u8*)output);
+}
+
+void BuildSubmeshVertices(const VertexStreams& streams, Submesh& submesh)
+{
+    VertexFormat format = ChooseVertexFormat(streams);
+
+    submesh.vertexBufferLayout = MakeVertexBufferLayout(format);
+    submesh.positionScale = format.positionScale;
+    submesh.positionBias = format.positionBias;
+    submesh.vertices.resize(streams.vertexCount * submesh.vertexBufferLayout.stride);
+
+    InterleaveVertices(streams, format, submesh.vertices.data());
+
+    // The unquantized source, for import steps that have to pack the positions again
+    submesh.positions.assign(streams.positions, streams.positions + streams.vertexCount);
+}
+
+static const VertexBufferAttribute* FindPositionAttribute(const VertexBufferLayout& layout)
+{
+    for (const VertexBufferAttribute& attribute : layout.attributes)
+        if (attribute.location == 0)
+            return &attribute;
+    return nullptr;
+}
+
+VertexBufferLayout MakePositionStreamLayout(const VertexBufferLayout& layout)
+{
+    const VertexBufferAttribute* position = FindPositionAttribute(layout);
+    ASSERT(position != nullptr, "Layout without positions");
+
+    VertexBufferAttribute attribute = *position;
+    attribute.offset = 0;
+
+    VertexBufferLayout positionLayout = {};
+    positionLayout.attributes.push_back(attribute);
+    positionLayout.stride = attribute.componentCount * (attribute.type == GL_FLOAT ? sizeof(f32) : sizeof(u16));
+    return positionLayout;
+}
+
+void ExtractPositionStream(const Submesh& submesh, void* output)
+{
+    const VertexBufferLayout& layout = submesh.vertexBufferLayout;
+    const u32 positionSize = MakePositionStreamLayout(layout).stride;
+    const u32 vertexCount = layout.stride > 0 ? (u32)(submesh.vertices.size() / layout.stride) : 0;
+
+    const u8* src = submesh.vertices.data() + FindPositionAttribute(layout)->offset;
+    u8* dst = (u8*)output;
+    for (u32 i = 0; i < vertexCount; ++i, src += layout.stride, dst += positionSize)
+        memcpy(dst, src, positionSize);
+}
+
+bool AreLayoutsEqual(const VertexBufferLayout& a, const VertexBufferLayout& b)
+{
+    if (a.stride != b.stride || a.attributes.size() != b.attributes.size())
+        return false;
+
+    for (u32 i = 0; i < a.attributes.size(); ++i)
+    {
+        const VertexBufferAttribute& attributeA = a.attributes[i];
+        const VertexBufferAttribute& attributeB = b.attributes[i];
+        if (attributeA.location != attributeB.location ||
+            attributeA.componentCount != attributeB.componentCount ||
+            attributeA.offset != attributeB.offset ||
+            attributeA.normalized != attributeB.normalized ||
+            attributeA.type != attributeB.type)
+            return false;
+    }
+
+    return true;
+}
+
+void RequantizeVertexPositions(Submesh& submesh, const vec3& positionScale, const vec3& positionBias)
+{
+    const VertexBufferLayout& layout = submesh.vertexBufferLayout;
+    const u32 vertexCount = layout.stride > 0 ? (u32)(submesh.vertices.size() / layout.stride) : 0;
+
+    const VertexBufferAttribute* position = FindPositionAttribute(layout);
+    ASSERT(position != nullptr && position->type == GL_UNSIGNED_SHORT, "Submesh without quantized positions");
+    ASSERT(submesh.positions.size() == vertexCount, "Submesh without its source positions");
+
+    const vec3 invPositionScale = vec3(positionScale.x > 0.0f ? 1.0f / positionScale.x : 0.0f,
+                                       positionScale.y > 0.0f ? 1.0f / positionScale.y : 0.0f,
+                                       positionScale.z > 0.0f ? 1.0f / positionScale.z : 0.0f);
+
+    // From the source floats, not the packed values, so every position is rounded once
+    u8* vertex = submesh.vertices.data() + position->offset;
+    for (u32 i = 0; i < vertexCount; ++i, vertex += layout.stride)
+    {
+        const vec3 q = glm::clamp((submesh.positions[i] - positionBias) * invPositionScale, vec3(0.0f), vec3(1.0f));
+        u16 packed[3];
+        packed[0] = (u16)roundf(q.x * UNORM16_MAX);
+        packed[1] = (u16)roundf(q.y * UNORM16_MAX);
+        packed[2] = (u16)roundf(q.z * UNORM16_MAX);
+        memcpy(vertex, packed, sizeof(packed));
+    }
+
+    submesh.positionScale = positionScale;
+    submesh.positionBias = positionBias;
+}
+
+void ReadVertexPositions(const Submesh& submesh, std::vector<vec3>& positions)
+{
+    const VertexBufferLayout& layout = submesh.vertexBufferLayout;
+    const u32 vertexCount = layout.stride > 0 ? (u32)(submesh.vertices.size() / layout.stride) : 0;
+
+    const VertexBufferAttribute* position = FindPositionAttribute(layout);
+    ASSERT(position != nullptr, "Submesh without positions");
+    positions.resize(vertexCount);
+
+    const u8* src = submesh.vertices.data() + position->offset;
+    for (u32 i = 0; i < vertexCount; ++i, src += layout.stride)
+    {
+        if (position->type == GL_FLOAT)
+        {
+            memcpy(&positions[i], src, sizeof(vec3));
+        }
+        else
+        {
+            u16 packed[3];
+            memcpy(packed, src, sizeof(packed));
+            vec3 decoded = vec3(packed[0], packed[1], packed[2]) / UNORM16_MAX;
+            positions[i] = decoded * submesh.positionScale + submesh.positionBias;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+//
+// vertex_interleave.h: Builds the interleaved vertex stream of a submesh out of the
+// separate attribute arrays importers give us (e.g. the aiVector3D arrays of an aiMesh).
+// Vertices are stored packed:
+//   location 0 - position:  unorm16x4 quantized against the submesh AABB, or float32x3
+//   location 1 - normal:    snorm16x2 octahedral encoded
+//   location 2 - texcoords: unorm16x2 when they fit [0,1], half float x2 otherwise
+//   location 3 - tangent:   snorm16x4, xy octahedral encoded, z the bitangent sign
+//
+
+#pragma once
+
+#include "engine.h"
+
+// Positions are only quantized to 16 bits if the step it introduces is below this
+#define MAX_POSITION_QUANTIZATION_STEP 0.001f
+
+struct VertexStreams
+{
+    u32         vertexCount;
+    const vec3* positions;
+    const vec3* normals;
+    const vec3* texCoords;  // Only xy are used, z is skipped (aiMesh stores 3D coords)
+    const vec3* tangents;   // Optional, together with the bitangents
+    const vec3* bitangents;
+    bool        flipBitangents;
+};
+
+enum PositionEncoding
+{
+    PositionEncoding_Float,
+    PositionEncoding_Unorm16,
+};
+
+enum TexCoordEncoding
+{
+    TexCoordEncoding_Unorm16,
+    TexCoordEncoding_Half,
+};
+
+struct VertexFormat
+{
+    bool             hasTexCoords;
+    bool             hasTangentSpace;
+    PositionEncoding positionEncoding;
+    TexCoordEncoding texCoordEncoding;
+    vec3             positionScale; // position = decoded * scale + bias
+    vec3             positionBias;
+};
+
+/**
+ * Whether positions within these bounds quantize to unorm16 with a step small enough.
+ */
+bool CanQuantizePositions(const vec3& minPos, const vec3& maxPos);
+
+/**
+ * Picks the most compact encoding the streams can use without visible loss.
+ */
+VertexFormat ChooseVertexFormat(const VertexStreams& streams);
+
+VertexBufferLayout MakeVertexBufferLayout(const VertexFormat& format);
+
+/**
+ * Writes vertexCount packed vertices into output, which must be at least
+ * vertexCount * layout.stride bytes, with layout = MakeVertexBufferLayout(format).
+ */
+void InterleaveVertices(const VertexStreams& streams, const VertexFormat& format, void* output);
+
+/**
+ * Chooses the format, builds the layout and fills submesh.vertices in one go. The source
+ * positions are kept in submesh.positions for RequantizeVertexPositions, ImportModel
+ * drops them once the submeshes are merged.
+ */
+void BuildSubmeshVertices(const VertexStreams& streams, Submesh& submesh);
+
+/**
+ * Layout of the position stream of a submesh: its position attribute alone, tightly packed
+ * (8 bytes a vertex quantized, 12 as floats), read with the same positionScale and bias.
+ */
+VertexBufferLayout MakePositionStreamLayout(const VertexBufferLayout& layout);
+
+/**
+ * Copies the packed positions out of the interleaved vertices of a submesh into output,
+ * which must be at least vertexCount * MakePositionStreamLayout(layout).stride bytes.
+ */
+void ExtractPositionStream(const Submesh& submesh, void* output);
+
+/**
+ * Whether two layouts have the same stride and attributes, so they share a vertex buffer.
+ */
+bool AreLayoutsEqual(const VertexBufferLayout& a, const VertexBufferLayout& b);
+
+/**
+ * Packs the unorm16 positions of a submesh again from its source positions (see
+ * BuildSubmeshVertices) against another scale and bias, which must cover all of them,
+ * e.g. to share the quantization of a submesh it is merged with.
+ */
+void RequantizeVertexPositions(Submesh& submesh, const vec3& positionScale, const vec3& positionBias);
+
+/**
+ * Decodes the positions of an already packed submesh, as the vertex shader sees them.
+ */
+void ReadVertexPositions(const Submesh& submesh, std::vector<vec3>& positions);
@@ -46,6 +46,10 @@ void main()
 
 layout(location=0) in vec3 aPosition;
 
+// Dequantization of packed positions
+layout(location=0) uniform vec3 uPositionScale;
+layout(location=1) uniform vec3 uPositionBias;
+
 layout(binding = 1, std140) uniform LocalParams
 {
 	mat4 uWorldMatrix;
@@ -53,7 +57,8 @@ layout(binding = 1, std140) uniform LocalParams
 };
 void main()
 {
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition,1.0);
+	vec3 position = aPosition * uPositionScale + uPositionBias;
+	gl_Position = uWorldViewProjectionMatrix * vec4(position,1.0);
 }
 
 #elif defined(FRAGMENT) ///////////////////////////////////////////////
@@ -78,10 +83,13 @@ void main()
 // TODO: Write your vertex shader here
 
 layout(location=0) in vec3 aPosition;
-layout(location=1) in vec3 aNormal;
+layout(location=1) in vec2 aNormal;		// Octahedral encoded
 layout(location=2) in vec2 aTexCoord;
-layout(location=3) in vec3 aTangent;
-layout(location=4) in vec3 aBitangent;
+layout(location=3) in vec4 aTangent;	// xy octahedral encoded, z bitangent sign
+
+// Dequantization of packed positions
+layout(location=0) uniform vec3 uPositionScale;
+layout(location=1) uniform vec3 uPositionBias;
 
 layout(binding = 1, std140) uniform LocalParams
 {
@@ -93,12 +101,23 @@ out vec2 vTexCoord;
 out vec3 vPosition;
 out vec3 vNormal;
 
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
 void main()
 {
+	vec3 position = aPosition * uPositionScale + uPositionBias;
+	vec3 normal = OctDecode(aNormal);
+
 	vTexCoord	= aTexCoord;
-	vPosition	= vec3(uWorldMatrix * vec4(aPosition, 1.0));
-	vNormal		= normalize(vec3(uWorldMatrix * vec4(aNormal, 0.0)));
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition,1.0);
+	vPosition	= vec3(uWorldMatrix * vec4(position, 1.0));
+	vNormal		= normalize(vec3(uWorldMatrix * vec4(normal, 0.0)));
+	gl_Position = uWorldViewProjectionMatrix * vec4(position,1.0);
 }
 
 #elif defined(FRAGMENT) ///////////////////////////////////////////////
@@ -231,6 +250,10 @@ void main()
 layout(location=0) in vec3 aPosition;
 layout(location=1) in vec2 aTexCoord;
 
+// Dequantization of packed positions
+layout(location=0) uniform vec3 uPositionScale;
+layout(location=1) uniform vec3 uPositionBias;
+
 layout(binding = 1, std140) uniform LocalParams
 {
 	mat4 uWorldMatrix;
@@ -239,7 +262,8 @@ layout(binding = 1, std140) uniform LocalParams
 
 void main()
 {
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition,1.0);
+	vec3 position = aPosition * uPositionScale + uPositionBias;
+	gl_Position = uWorldViewProjectionMatrix * vec4(position,1.0);
 }
 
 #elif defined(FRAGMENT) ///////////////////////////////////////////////
@@ -320,10 +344,13 @@ void main()
 // TODO: Write your vertex shader here
 
 layout(location=0) in vec3 aPosition;
-layout(location=1) in vec3 aNormal;
+layout(location=1) in vec2 aNormal;		// Octahedral encoded
 layout(location=2) in vec2 aTexCoord;
-layout(location=3) in vec3 aTangent;
-layout(location=4) in vec3 aBitangent;
+layout(location=3) in vec4 aTangent;	// xy octahedral encoded, z bitangent sign
+
+// Dequantization of packed positions
+layout(location=0) uniform vec3 uPositionScale;
+layout(location=1) uniform vec3 uPositionBias;
 
 layout(binding = 1, std140) uniform LocalParams
 {
@@ -336,16 +363,28 @@ out vec3 vPosition;
 out vec3 vNormal;
 out mat3 vTBN;
 
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
 void main()
 {
+	vec3 position = aPosition * uPositionScale + uPositionBias;
+	vec3 normal = OctDecode(aNormal);
+	vec3 tangent = OctDecode(aTangent.xy);
+	vec3 bitangent = aTangent.z * cross(normal, tangent);
 
 	vTexCoord	= aTexCoord;
-	vPosition	= vec3(uWorldMatrix * vec4(aPosition, 1.0));
-	vNormal		= normalize(vec3(uWorldMatrix * vec4(aNormal, 0.0)));
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition,1.0);
+	vPosition	= vec3(uWorldMatrix * vec4(position, 1.0));
+	vNormal		= normalize(vec3(uWorldMatrix * vec4(normal, 0.0)));
+	gl_Position = uWorldViewProjectionMatrix * vec4(position,1.0);
 
-	vec3 T = normalize(vec3(uWorldMatrix * vec4(aTangent,0.0)));
-	vec3 B = normalize(vec3(uWorldMatrix * vec4(aBitangent,0.0)));
+	vec3 T = normalize(vec3(uWorldMatrix * vec4(tangent,0.0)));
+	vec3 B = normalize(vec3(uWorldMatrix * vec4(bitangent,0.0)));
 	vTBN = mat3(T, B, vNormal);
 }
 
@@ -391,8 +430,10 @@ void main()
 	oColor = albedoColor;
 
 	// Convert normal from tangent space to local space and view space
-	vec3 normal = texture(uWormalMap, vTexCoord).rgb;
-	normal = normal * 2.0 - 1.0;   
+	// Normal maps are BC5, only X and Y are stored
+	vec3 normal;
+	normal.xy = texture(uWormalMap, vTexCoord).rg * 2.0 - 1.0;
+	normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 	normal = normalize(vTBN * normal); 
 
 	nColor = vec4(normal, 1.0);